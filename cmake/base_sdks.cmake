@@ -169,6 +169,8 @@ function(guarantee_vst3sdk)
 
 
     target_include_directories(base-sdk-vst3 PUBLIC ${VST3_SDK_ROOT} ${VST3_SDK_ROOT}/public.sdk ${VST3_SDK_ROOT}/pluginterfaces)
+    # remember where the sdk came from so later guarantees can pick extra sources out of it
+    set_target_properties(base-sdk-vst3 PROPERTIES CLAP_WRAPPER_VST3_SDK_ROOT "${VST3_SDK_ROOT}")
     target_compile_options(base-sdk-vst3 PUBLIC $<IF:$<CONFIG:Debug>,-DDEVELOPMENT=1,-DRELEASE=1>) # work through steinbergs alternate choices for these
     target_link_libraries(base-sdk-vst3 PUBLIC clap-wrapper-sanitizer-options)
     # The VST3SDK uses sprintf, not snprintf, which macOS flags as deprecated
@@ -187,6 +189,32 @@ function(guarantee_vst3sdk)
     endif()
 endfunction(guarantee_vst3sdk)
 
+# The hosting side of the VST3 SDK, used by the benchmarks and tools which load a built
+# VST3 rather than implement one. Only the linux module loader is set up right now.
+function(guarantee_vst3sdk_hosting)
+    if (TARGET base-sdk-vst3-hosting)
+        return()
+    endif()
+
+    guarantee_vst3sdk()
+    get_target_property(VST3_SDK_ROOT base-sdk-vst3 CLAP_WRAPPER_VST3_SDK_ROOT)
+    set(VST3_HOSTING ${VST3_SDK_ROOT}/public.sdk/source/vst/hosting)
+
+    add_library(base-sdk-vst3-hosting STATIC
+            ${VST3_HOSTING}/module.cpp
+            ${VST3_HOSTING}/hostclasses.cpp
+            ${VST3_HOSTING}/pluginterfacesupport.cpp
+            )
+    if (UNIX AND NOT APPLE)
+        target_sources(base-sdk-vst3-hosting PRIVATE ${VST3_HOSTING}/module_linux.cpp)
+        target_link_libraries(base-sdk-vst3-hosting PUBLIC ${CMAKE_DL_LIBS})
+    else()
+        message(WARNING "clap-wrapper: the vst3 hosting classes are only configured on linux")
+    endif()
+    set_target_properties(base-sdk-vst3-hosting PROPERTIES UNITY_BUILD FALSE)
+    target_link_libraries(base-sdk-vst3-hosting PUBLIC base-sdk-vst3)
+endfunction(guarantee_vst3sdk_hosting)
+
 function(guarantee_auv2sdk)
     if (TARGET base-sdk-auv2)
         return()
@@ -40,6 +40,7 @@ function(make_clapfirst_plugins)
             STANDALONE_WINDOWS_ICON
 
             WINDOWS_FOLDER_VST3 # True for a filder, false for single file (default)
+            VST3_DEFER_CLAP_LOADING # True to initialize the CLAP only when the first VST3 instance is created
 
             ASSET_OUTPUT_DIRECTORY
 
@@ -158,6 +159,8 @@ function(make_clapfirst_plugins)
                 BUNDLE_VERSION "${C1ST_BUNDLE_VERSION}"
                 ASSET_OUTPUT_DIRECTORY "${vod}"
                 WINDOWS_FOLDER_VST3 ${C1ST_WINDOWS_FOLDER_VST3}
+                CLAP_TARGET_FOR_CONFIG "${CLAP_TARGET}"
+                DEFER_CLAP_LOADING "${C1ST_VST3_DEFER_CLAP_LOADING}"
         )
 
         add_dependencies(${ALL_TARGET} ${VST3_TARGET})
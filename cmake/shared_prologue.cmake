@@ -170,6 +170,7 @@ function(guarantee_clap_wrapper_shared)
             src/detail/shared/sha1.cpp
             src/detail/clap/fsutil.h
             src/detail/clap/fsutil.cpp
+            src/detail/clap/searchindex.cpp
             src/detail/clap/automation.h
             )
     target_link_libraries(clap-wrapper-shared-detail PUBLIC clap clap-wrapper-extensions clap-wrapper-compile-options-public)
@@ -27,6 +27,8 @@ function(private_add_vst3_wrapper_sources)
             ${sd}/src/detail/vst3/process.cpp
             ${sd}/src/detail/vst3/categories.h
             ${sd}/src/detail/vst3/categories.cpp
+            ${sd}/src/detail/vst3/classinfo.h
+            ${sd}/src/detail/vst3/classinfo.cpp
             ${sd}/src/detail/vst3/aravst3.h
             )
 
@@ -53,6 +55,14 @@ function(target_add_vst3_wrapper)
             ASSET_OUTPUT_DIRECTORY
 
             MACOS_EMBEDDED_CLAP_LOCATION
+
+            # If set, the named CLAP target is loaded at build time to generate the
+            # bundles moduleinfo.json and the table of class ids the factory uses
+            CLAP_TARGET_FOR_CONFIG
+
+            # If true, the factory answers class queries from the table generated with
+            # CLAP_TARGET_FOR_CONFIG and only loads the CLAP when the first instance is created
+            DEFER_CLAP_LOADING
             )
     cmake_parse_arguments(V3 "" "${oneValueArgs}" "" ${ARGN} )
 
@@ -222,6 +232,71 @@ function(target_add_vst3_wrapper)
         endif()
     endif()
 
+    if (V3_DEFER_CLAP_LOADING AND ("${V3_CLAP_TARGET_FOR_CONFIG}" STREQUAL "" OR CMAKE_CROSSCOMPILING))
+        message(WARNING "clap-wrapper: DEFER_CLAP_LOADING needs the class table from CLAP_TARGET_FOR_CONFIG, ${V3_TARGET} loads the CLAP eagerly")
+    endif()
+
+    if (NOT "${V3_CLAP_TARGET_FOR_CONFIG}" STREQUAL "")
+        if (CMAKE_CROSSCOMPILING)
+            message(STATUS "clap-wrapper: cross compiling, so no vst3 moduleinfo.json for ${V3_TARGET}")
+        else()
+            # We need a build helper which loads the clap and ejects the moduleinfo.json and class table
+            set(clpt ${V3_CLAP_TARGET_FOR_CONFIG})
+            set(bhtg ${V3_TARGET}-build-helper)
+            set(bhsc "${CLAP_WRAPPER_CMAKE_CURRENT_SOURCE_DIR}/src/detail/vst3")
+            set(bhtgoutdir "${CMAKE_CURRENT_BINARY_DIR}/${V3_TARGET}-build-helper-output")
+            message(STATUS "clap-wrapper: building vst3 moduleinfo based on target ${clpt}")
+
+            add_executable(${bhtg}
+                    ${bhsc}/build-helper/build-helper.cpp
+                    ${bhsc}/classinfo.cpp
+                    ${bhsc}/categories.cpp
+                    )
+            target_link_libraries(${bhtg} PRIVATE
+                    clap-wrapper-compile-options
+                    clap-wrapper-shared-detail
+                    base-sdk-vst3
+                    )
+            if (APPLE)
+                target_link_libraries(${bhtg} PRIVATE
+                        macos_filesystem_support
+                        "-framework Foundation"
+                        "-framework CoreFoundation"
+                        )
+            endif()
+            file(MAKE_DIRECTORY "${bhtgoutdir}")
+
+            # regenerated whenever the clap or the helper changes, not just when the helper relinks
+            add_custom_command(
+                    OUTPUT ${bhtgoutdir}/moduleinfo.json ${bhtgoutdir}/generated_vst3_classinfo.hxx
+                    WORKING_DIRECTORY ${bhtgoutdir}
+                    COMMAND $<TARGET_FILE:${bhtg}> --fromclap
+                    "$<TARGET_FILE:${clpt}>" "${V3_OUTPUT_NAME}" "${V3_BUNDLE_VERSION}"
+                    "${V3_SINGLE_PLUGIN_TUID}"
+                    DEPENDS ${bhtg} ${clpt} $<TARGET_FILE:${clpt}>
+                    COMMENT "Generating the vst3 moduleinfo and class table of ${V3_TARGET} from ${clpt}"
+            )
+            add_custom_target(${bhtg}-output
+                    DEPENDS ${bhtgoutdir}/moduleinfo.json ${bhtgoutdir}/generated_vst3_classinfo.hxx)
+
+            add_dependencies(${V3_TARGET}-clap-wrapper-vst3-lib ${bhtg}-output)
+            target_include_directories(${V3_TARGET}-clap-wrapper-vst3-lib PRIVATE "${bhtgoutdir}")
+            target_compile_definitions(${V3_TARGET}-clap-wrapper-vst3-lib PRIVATE CLAP_WRAPPER_VST3_GENERATED_CLASSINFO=1)
+            if (V3_DEFER_CLAP_LOADING)
+                message(STATUS "clap-wrapper: ${V3_TARGET} defers loading the CLAP to the first instance")
+                target_compile_definitions(${V3_TARGET}-clap-wrapper-vst3-lib PRIVATE CLAP_WRAPPER_VST3_DEFER_LOADING=1)
+            endif()
+
+            # the single file windows vst3 has no bundle to put the moduleinfo into
+            if (APPLE OR UNIX OR ${V3_WINDOWS_FOLDER_VST3})
+                add_custom_command(TARGET ${V3_TARGET} POST_BUILD
+                        COMMAND ${CMAKE_COMMAND} -E make_directory "$<TARGET_FILE_DIR:${V3_TARGET}>/../Resources"
+                        COMMAND ${CMAKE_COMMAND} -E copy "${bhtgoutdir}/moduleinfo.json" "$<TARGET_FILE_DIR:${V3_TARGET}>/../Resources/moduleinfo.json"
+                        )
+            endif()
+        endif()
+    endif()
+
     if (${CLAP_WRAPPER_COPY_AFTER_BUILD})
         target_copy_after_build(TARGET ${V3_TARGET} FLAVOR vst3)
     endif()
@@ -216,6 +216,7 @@ void Plugin::connectClap(const clap_plugin_t* clap)
 
   // if successful, query the extensions the wrapper might want to use
   getExtension(_plugin, _ext._state, CLAP_EXT_STATE);
+  getExtension(_plugin, _ext._statecontext, CLAP_EXT_STATE_CONTEXT);
   getExtension(_plugin, _ext._params, CLAP_EXT_PARAMS);
   getExtension(_plugin, _ext._audioports, CLAP_EXT_AUDIO_PORTS);
   getExtension(_plugin, _ext._noteports, CLAP_EXT_NOTE_PORTS);
@@ -329,6 +330,24 @@ bool Plugin::save(const clap_ostream_t* stream) const
   return false;
 }
 
+bool Plugin::load(const clap_istream_t* stream, uint32_t context_type) const
+{
+  if (context_type != 0 && _ext._statecontext)
+  {
+    return _ext._statecontext->load(_plugin, stream, context_type);
+  }
+  return load(stream);
+}
+
+bool Plugin::save(const clap_ostream_t* stream, uint32_t context_type) const
+{
+  if (context_type != 0 && _ext._statecontext)
+  {
+    return _ext._statecontext->save(_plugin, stream, context_type);
+  }
+  return save(stream);
+}
+
 bool Plugin::activate() const
 {
   return _plugin->activate(_plugin, _audioSetup.sampleRate, _audioSetup.minFrames,
@@ -555,8 +574,9 @@ void Plugin::clapRequestRestart(const clap_host* host)
 // [thread-safe]
 void Plugin::clapRequestProcess(const clap_host* host)
 {
-  // right now, I don't know how to communicate this to the host
-  // in VST3 you can't force processing...
+  // in VST3 you can't force processing, so only some hosts can do something with it
+  auto self = static_cast<Plugin*>(host->host_data);
+  self->_parentHost->request_process();
 }
 
 // Registers a periodic timer.
@@ -41,6 +41,11 @@ class IHost
   virtual void mark_dirty() = 0;
   virtual void restartPlugin() = 0;
   virtual void request_callback() = 0;
+  // the plugin wants to be processed, e.g. to wake up from sleep. Wrappers which always
+  // process can ignore it.
+  virtual void request_process()
+  {
+  }
 
   virtual void setupWrapperSpecifics(
       const clap_plugin_t* plugin) = 0;  // called when a wrapper could scan for wrapper specific plugins
@@ -104,6 +109,7 @@ struct AudioSetup
 struct ClapPluginExtensions
 {
   const clap_plugin_state_t* _state = nullptr;
+  const clap_plugin_state_context_t* _statecontext = nullptr;
   const clap_plugin_params_t* _params = nullptr;
   const clap_plugin_audio_ports_t* _audioports = nullptr;
   const clap_plugin_gui_t* _gui = nullptr;
@@ -176,6 +182,10 @@ class Plugin
 
   bool load(const clap_istream_t* stream) const;
   bool save(const clap_ostream_t* stream) const;
+  // with a clap_plugin_state_context_type, falls back to the plain state if the CLAP
+  // does not support the state context extension. 0 always uses the plain state.
+  bool load(const clap_istream_t* stream, uint32_t context_type) const;
+  bool save(const clap_ostream_t* stream, uint32_t context_type) const;
   bool activate() const;
   void deactivate() const;
   bool start_processing();
@@ -270,6 +280,12 @@ class StateMemento
   {
     _mem.clear();
   }
+  // clears and hands the memory back, clear keeps it for the next state
+  void release()
+  {
+    std::vector<uint8_t>().swap(_mem);
+    _readoffset = 0;
+  }
   void rewind()
   {
     _readoffset = 0;
@@ -64,7 +64,7 @@ std::vector<std::wstring> split_clap_path(const std::wstring &in)
 }
 #endif
 
-std::vector<fs::path> getValidCLAPSearchPaths()
+std::vector<fs::path> getCLAPSearchRoots()
 {
   std::vector<fs::path> res;
 
@@ -109,7 +109,7 @@ std::vector<fs::path> getValidCLAPSearchPaths()
   }
   auto sep = ':';
 
-  if (cp.empty())
+  if (!cp.empty())
   {
     size_t pos;
     while ((pos = cp.find(sep)) != std::string::npos)
@@ -122,6 +122,13 @@ std::vector<fs::path> getValidCLAPSearchPaths()
   }
 #endif
 
+  return res;
+}
+
+std::vector<fs::path> getValidCLAPSearchPaths()
+{
+  auto res{getCLAPSearchRoots()};
+
   auto paths{res};
   for (const auto &path : paths)
   {
@@ -11,6 +11,7 @@
 */
 
 #include <vector>
+#include <string>
 #include <functional>
 #include <clap/clap.h>
 #if WIN
@@ -29,7 +30,14 @@
 namespace Clap
 {
 
+// the standard CLAP locations plus the entries of CLAP_PATH, not descended into
+std::vector<fs::path> getCLAPSearchRoots();
+// the search roots and every directory below them. this walks the whole tree, so prefer
+// findCLAPInSearchPaths when looking for a specific .clap
 std::vector<fs::path> getValidCLAPSearchPaths();
+// locates a .clap by its file name below the search roots, backed by a persistent index in the
+// user cache directory (see searchindex.cpp). returns an empty path if there is no such .clap
+fs::path findCLAPInSearchPaths(const std::string& clapfilename);
 class Plugin;
 class IHost;
 
@@ -0,0 +1,295 @@
+/*
+
+    Copyright (c) 2022 Timo Kaluza (defiantnerd)
+                       Paul Walker
+
+    This file is part of the clap-wrappers project which is released under MIT License.
+    See file LICENSE or go to https://github.com/free-audio/clap-wrapper for full license details.
+
+    A persistent index of the .clap files below the CLAP search roots.
+
+    Walking ~/.clap and friends recursively is expensive when users symlink large sample
+    libraries into them, and every wrapper factory did it on every scan. Instead the walk
+    is breadth-first, stops in the directory where the requested .clap shows up and is
+    written to the user cache directory together with
+
+      - the search roots it was made for (so a changed CLAP_PATH invalidates it)
+      - every directory it visited, with its modification time
+      - the directories still waiting to be visited, so a later lookup can resume the walk
+      - every .clap it saw, first one in breadth-first order wins
+
+    Adding or removing an entry changes the mtime of its directory, so as long as none of
+    the visited directories changed, a hit in the index is exactly what a fresh walk would
+    have found first, and a miss in a completed walk is a real miss. Only if one of them
+    changed the index is thrown away and the walk starts over.
+
+*/
+
+#include "fsutil.h"
+#include "detail/os/log.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <set>
+#include <unordered_map>
+
+#if WIN
+#include <windows.h>
+#include <shlobj.h>
+#endif
+
+#if !WIN
+#include <unistd.h>
+#endif
+
+namespace Clap
+{
+#if WIN
+fs::path get_known_folder(const KNOWNFOLDERID &id);
+#endif
+
+namespace
+{
+const char *indexHeader = "clap-wrapper-search-index 1";
+
+struct SearchIndex
+{
+  std::vector<fs::path> roots;
+  std::vector<std::pair<fs::path, int64_t>> visited;
+  std::deque<fs::path> pending;
+  std::unordered_map<std::string, fs::path> claps;
+  bool complete{false};
+};
+
+fs::path getIndexFile()
+{
+  fs::path res;
+#if WIN
+  res = get_known_folder(FOLDERID_LocalAppData);
+  if (!res.empty()) res = res / "clap-wrapper" / "Cache";
+#else
+  auto home = getenv("HOME");
+#if MAC
+  if (home) res = fs::path(home) / "Library" / "Caches" / "clap-wrapper";
+#else
+  auto xdg = getenv("XDG_CACHE_HOME");
+  if (xdg && xdg[0] == '/')
+    res = fs::path(xdg) / "clap-wrapper";
+  else if (home)
+    res = fs::path(home) / ".cache" / "clap-wrapper";
+#endif
+#endif
+  if (res.empty()) return res;
+  return res / "clap-search-index.txt";
+}
+
+// the index is written as utf-8, which is the native narrow encoding everywhere but windows
+fs::path fromUTF8(const std::string &s)
+{
+#if WIN
+  auto len = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), nullptr, 0);
+  std::wstring w(len, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), &w[0], len);
+  return fs::path(w);
+#else
+  return fs::path(s);
+#endif
+}
+
+int64_t modificationTime(const fs::path &dir)
+{
+  std::error_code ec;
+  auto t = fs::last_write_time(dir, ec);
+  if (ec) return -1;
+  return static_cast<int64_t>(t.time_since_epoch().count());
+}
+
+bool isClap(const fs::path &p)
+{
+  return p.extension() == ".clap";
+}
+
+bool readIndex(const fs::path &file, SearchIndex &index)
+{
+  std::ifstream in(file, std::ios::binary);
+  if (!in) return false;
+
+  std::string line;
+  if (!std::getline(in, line) || line != indexHeader) return false;
+
+  while (std::getline(in, line))
+  {
+    if (line.size() < 2 || line[1] != '\t') return false;
+    auto rest = line.substr(2);
+    switch (line[0])
+    {
+      case 'R':
+        index.roots.emplace_back(fromUTF8(rest));
+        break;
+      case 'Q':
+        index.pending.emplace_back(fromUTF8(rest));
+        break;
+      case 'D':
+      {
+        auto tab = rest.find('\t');
+        if (tab == std::string::npos) return false;
+        index.visited.emplace_back(fromUTF8(rest.substr(tab + 1)),
+                                   std::strtoll(rest.substr(0, tab).c_str(), nullptr, 10));
+        break;
+      }
+      case 'P':
+      {
+        auto tab = rest.find('\t');
+        if (tab == std::string::npos) return false;
+        index.claps.emplace(rest.substr(0, tab), fromUTF8(rest.substr(tab + 1)));
+        break;
+      }
+      case 'C':
+        index.complete = true;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+void writeIndex(const fs::path &file, const SearchIndex &index)
+{
+  std::error_code ec;
+  fs::create_directories(file.parent_path(), ec);
+  if (ec) return;
+
+  // write next to the target and rename, so concurrent scanners never see half an index.
+  // Hosts scan several wrapped plugins of one process on parallel threads, so the name is
+  // unique to the write, not just to the process.
+  static std::atomic<uint32_t> writes{0};
+  auto tmp = file;
+#if WIN
+  tmp += "." + std::to_string(GetCurrentProcessId());
+#else
+  tmp += "." + std::to_string(getpid());
+#endif
+  tmp += "." + std::to_string(writes.fetch_add(1)) + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return;
+    out << indexHeader << "\n";
+    for (const auto &r : index.roots) out << "R\t" << r.u8string() << "\n";
+    for (const auto &d : index.visited) out << "D\t" << d.second << "\t" << d.first.u8string() << "\n";
+    for (const auto &q : index.pending) out << "Q\t" << q.u8string() << "\n";
+    for (const auto &c : index.claps) out << "P\t" << c.first << "\t" << c.second.u8string() << "\n";
+    if (index.complete) out << "C\t\n";
+    if (!out.good())
+    {
+      out.close();
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  fs::rename(tmp, file, ec);
+  if (ec) fs::remove(tmp, ec);
+}
+
+bool isUpToDate(const SearchIndex &index, const std::vector<fs::path> &roots)
+{
+  if (index.roots != roots) return false;
+  for (const auto &d : index.visited)
+  {
+    if (modificationTime(d.first) != d.second) return false;
+  }
+  return true;
+}
+
+// continues the breadth-first walk of the index until the directory containing
+// `clapfilename` has been fully read or nothing is left to visit
+void walk(SearchIndex &index, const std::string &clapfilename)
+{
+  std::set<fs::path> seen;
+  for (const auto &d : index.visited)
+  {
+    std::error_code ec;
+    auto c = fs::canonical(d.first, ec);
+    seen.insert(ec ? d.first : c);
+  }
+
+  while (!index.pending.empty())
+  {
+    auto dir = index.pending.front();
+    index.pending.pop_front();
+
+    // symlinks can point back up the tree, so only ever enter a directory once
+    std::error_code ec;
+    auto canonical = fs::canonical(dir, ec);
+    if (ec)
+    {
+      // remember missing roots too, creating them later has to invalidate the index
+      index.visited.emplace_back(dir, modificationTime(dir));
+      continue;
+    }
+    if (!seen.insert(canonical).second) continue;
+
+    index.visited.emplace_back(dir, modificationTime(dir));
+    LOGDETAIL("scanning for clap files: {}", dir.u8string());
+
+    bool found = false;
+    auto it = fs::directory_iterator(dir, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec))
+    {
+      const auto &p = it->path();
+      std::error_code dec;
+      bool isDir = fs::is_directory(p, dec);  // follows symlinks
+      if (isClap(p))
+      {
+        auto name = p.filename().u8string();
+        index.claps.emplace(name, p);  // first in breadth-first order wins
+        if (name == clapfilename) found = true;
+      }
+      else if (isDir && !dec)
+      {
+        index.pending.push_back(p);
+      }
+    }
+
+    if (found) return;
+  }
+  index.complete = true;
+}
+
+}  // namespace
+
+fs::path findCLAPInSearchPaths(const std::string &clapfilename)
+{
+  auto roots = getCLAPSearchRoots();
+  auto indexFile = getIndexFile();
+
+  SearchIndex index;
+  if (!indexFile.empty() && readIndex(indexFile, index) && isUpToDate(index, roots))
+  {
+    auto c = index.claps.find(clapfilename);
+    if (c != index.claps.end())
+    {
+      LOGDETAIL("found {} in the search index", clapfilename);
+      return c->second;
+    }
+    if (index.complete) return {};
+  }
+  else
+  {
+    LOGDETAIL("search index is missing or stale, walking the clap search paths");
+    index = SearchIndex();
+    index.roots = roots;
+    index.pending.assign(roots.begin(), roots.end());
+  }
+
+  walk(index, clapfilename);
+  if (!indexFile.empty()) writeIndex(indexFile, index);
+
+  auto c = index.claps.find(clapfilename);
+  if (c != index.claps.end()) return c->second;
+  return {};
+}
+
+}  // namespace Clap
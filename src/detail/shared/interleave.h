@@ -0,0 +1,293 @@
+#pragma once
+
+/*
+ * Interleave and deinterleave kernels for float audio.
+ *
+ * An interleaved buffer holds `channels` samples per frame. deinterleave() splits it into
+ * one buffer per channel, interleave() does the opposite. Stereo and four and eight
+ * channel buffers have SIMD versions (SSE2 on x86, plus AVX for stereo if the compiler
+ * targets it, and NEON on ARM), everything else uses the scalar loops. The instruction
+ * set is chosen at compile time. No buffer has to be aligned.
+ *
+ * The *Scalar versions are always available and are the reference the SIMD ones match.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CLAP_WRAPPER_INTERLEAVE_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLAP_WRAPPER_INTERLEAVE_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CLAP_WRAPPER_INTERLEAVE_NEON 1
+#endif
+
+namespace ClapWrapper::detail::shared
+{
+inline void deinterleaveScalar(const float *src, float *const *dst, uint32_t channels, uint32_t frames)
+{
+  for (auto c = 0U; c < channels; ++c)
+  {
+    auto d = dst[c];
+    for (auto i = 0U; i < frames; ++i) d[i] = src[i * channels + c];
+  }
+}
+
+inline void interleaveScalar(const float *const *src, float *dst, uint32_t channels, uint32_t frames)
+{
+  for (auto c = 0U; c < channels; ++c)
+  {
+    auto s = src[c];
+    for (auto i = 0U; i < frames; ++i) dst[i * channels + c] = s[i];
+  }
+}
+
+namespace interleave_detail
+{
+// each kernel handles the frames it has full vectors for and returns how many that were
+#if CLAP_WRAPPER_INTERLEAVE_SSE2
+inline uint32_t deinterleave2(const float *src, float *l, float *r, uint32_t frames)
+{
+  uint32_t i = 0;
+#if CLAP_WRAPPER_INTERLEAVE_AVX
+  for (; i + 8 <= frames; i += 8)
+  {
+    auto a = _mm256_loadu_ps(src + 2 * i);
+    auto b = _mm256_loadu_ps(src + 2 * i + 8);
+    auto lo = _mm256_permute2f128_ps(a, b, 0x20);
+    auto hi = _mm256_permute2f128_ps(a, b, 0x31);
+    _mm256_storeu_ps(l + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm256_storeu_ps(r + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#endif
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto a = _mm_loadu_ps(src + 2 * i);
+    auto b = _mm_loadu_ps(src + 2 * i + 4);
+    _mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  return i;
+}
+
+inline uint32_t interleave2(const float *l, const float *r, float *dst, uint32_t frames)
+{
+  uint32_t i = 0;
+#if CLAP_WRAPPER_INTERLEAVE_AVX
+  for (; i + 8 <= frames; i += 8)
+  {
+    auto a = _mm256_loadu_ps(l + i);
+    auto b = _mm256_loadu_ps(r + i);
+    auto lo = _mm256_unpacklo_ps(a, b);
+    auto hi = _mm256_unpackhi_ps(a, b);
+    _mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+#endif
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto a = _mm_loadu_ps(l + i);
+    auto b = _mm_loadu_ps(r + i);
+    _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(a, b));
+    _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(a, b));
+  }
+  return i;
+}
+
+// a 4x4 transpose turns four frames of four channels into four samples of each channel
+inline uint32_t deinterleave4(const float *src, float *const *dst, uint32_t stride, uint32_t offset,
+                              uint32_t frames)
+{
+  uint32_t i = 0;
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto p = src + i * stride + offset;
+    auto r0 = _mm_loadu_ps(p);
+    auto r1 = _mm_loadu_ps(p + stride);
+    auto r2 = _mm_loadu_ps(p + 2 * stride);
+    auto r3 = _mm_loadu_ps(p + 3 * stride);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dst[0] + i, r0);
+    _mm_storeu_ps(dst[1] + i, r1);
+    _mm_storeu_ps(dst[2] + i, r2);
+    _mm_storeu_ps(dst[3] + i, r3);
+  }
+  return i;
+}
+
+inline uint32_t interleave4(const float *const *src, float *dst, uint32_t stride, uint32_t offset,
+                            uint32_t frames)
+{
+  uint32_t i = 0;
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto r0 = _mm_loadu_ps(src[0] + i);
+    auto r1 = _mm_loadu_ps(src[1] + i);
+    auto r2 = _mm_loadu_ps(src[2] + i);
+    auto r3 = _mm_loadu_ps(src[3] + i);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    auto p = dst + i * stride + offset;
+    _mm_storeu_ps(p, r0);
+    _mm_storeu_ps(p + stride, r1);
+    _mm_storeu_ps(p + 2 * stride, r2);
+    _mm_storeu_ps(p + 3 * stride, r3);
+  }
+  return i;
+}
+#elif CLAP_WRAPPER_INTERLEAVE_NEON
+inline uint32_t deinterleave2(const float *src, float *l, float *r, uint32_t frames)
+{
+  uint32_t i = 0;
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto v = vld2q_f32(src + 2 * i);
+    vst1q_f32(l + i, v.val[0]);
+    vst1q_f32(r + i, v.val[1]);
+  }
+  return i;
+}
+
+inline uint32_t interleave2(const float *l, const float *r, float *dst, uint32_t frames)
+{
+  uint32_t i = 0;
+  for (; i + 4 <= frames; i += 4)
+  {
+    float32x4x2_t v;
+    v.val[0] = vld1q_f32(l + i);
+    v.val[1] = vld1q_f32(r + i);
+    vst2q_f32(dst + 2 * i, v);
+  }
+  return i;
+}
+
+inline uint32_t deinterleave4(const float *src, float *const *dst, uint32_t stride, uint32_t offset,
+                              uint32_t frames)
+{
+  uint32_t i = 0;
+  if (stride != 4) return 0;  // vld4 only reads packed frames
+  for (; i + 4 <= frames; i += 4)
+  {
+    auto v = vld4q_f32(src + 4 * i + offset);
+    vst1q_f32(dst[0] + i, v.val[0]);
+    vst1q_f32(dst[1] + i, v.val[1]);
+    vst1q_f32(dst[2] + i, v.val[2]);
+    vst1q_f32(dst[3] + i, v.val[3]);
+  }
+  return i;
+}
+
+inline uint32_t interleave4(const float *const *src, float *dst, uint32_t stride, uint32_t offset,
+                            uint32_t frames)
+{
+  uint32_t i = 0;
+  if (stride != 4) return 0;
+  for (; i + 4 <= frames; i += 4)
+  {
+    float32x4x4_t v;
+    v.val[0] = vld1q_f32(src[0] + i);
+    v.val[1] = vld1q_f32(src[1] + i);
+    v.val[2] = vld1q_f32(src[2] + i);
+    v.val[3] = vld1q_f32(src[3] + i);
+    vst4q_f32(dst + 4 * i + offset, v);
+  }
+  return i;
+}
+#else
+inline uint32_t deinterleave2(const float *, float *, float *, uint32_t)
+{
+  return 0;
+}
+inline uint32_t interleave2(const float *, const float *, float *, uint32_t)
+{
+  return 0;
+}
+inline uint32_t deinterleave4(const float *, float *const *, uint32_t, uint32_t, uint32_t)
+{
+  return 0;
+}
+inline uint32_t interleave4(const float *const *, float *, uint32_t, uint32_t, uint32_t)
+{
+  return 0;
+}
+#endif
+}  // namespace interleave_detail
+
+// dst[c] receives channel c of the `channels` interleaved in src
+inline void deinterleave(const float *src, float *const *dst, uint32_t channels, uint32_t frames)
+{
+  uint32_t done = 0;
+  switch (channels)
+  {
+    case 1:
+      memcpy(dst[0], src, frames * sizeof(float));
+      return;
+    case 2:
+      done = interleave_detail::deinterleave2(src, dst[0], dst[1], frames);
+      break;
+    case 4:
+      done = interleave_detail::deinterleave4(src, dst, 4, 0, frames);
+      break;
+    case 8:
+    {
+      // both halves of a frame are four channels apart
+      auto lo = interleave_detail::deinterleave4(src, dst, 8, 0, frames);
+      done = interleave_detail::deinterleave4(src, dst + 4, 8, 4, lo);
+      break;
+    }
+    default:
+      break;
+  }
+  if (done == frames) return;
+
+  float *rest[256];
+  if (channels > 256)
+  {
+    deinterleaveScalar(src, dst, channels, frames);
+    return;
+  }
+  for (auto c = 0U; c < channels; ++c) rest[c] = dst[c] + done;
+  deinterleaveScalar(src + done * channels, rest, channels, frames - done);
+}
+
+// the channels of src interleaved into dst
+inline void interleave(const float *const *src, float *dst, uint32_t channels, uint32_t frames)
+{
+  uint32_t done = 0;
+  switch (channels)
+  {
+    case 1:
+      memcpy(dst, src[0], frames * sizeof(float));
+      return;
+    case 2:
+      done = interleave_detail::interleave2(src[0], src[1], dst, frames);
+      break;
+    case 4:
+      done = interleave_detail::interleave4(src, dst, 4, 0, frames);
+      break;
+    case 8:
+    {
+      auto lo = interleave_detail::interleave4(src, dst, 8, 0, frames);
+      done = interleave_detail::interleave4(src + 4, dst, 8, 4, lo);
+      break;
+    }
+    default:
+      break;
+  }
+  if (done == frames) return;
+
+  const float *rest[256];
+  if (channels > 256)
+  {
+    interleaveScalar(src, dst, channels, frames);
+    return;
+  }
+  for (auto c = 0U; c < channels; ++c) rest[c] = src[c] + done;
+  interleaveScalar(rest, dst + done * channels, channels, frames - done);
+}
+}  // namespace ClapWrapper::detail::shared
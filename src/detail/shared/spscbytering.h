@@ -0,0 +1,122 @@
+#pragma once
+
+/*
+ * A single producer, single consumer ring of variable length messages with a time stamp
+ * each, like MIDI including SysEx. Messages are never split: one which does not fit is
+ * dropped whole and counted. Neither side allocates or blocks.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace ClapWrapper::detail::shared
+{
+template <uint32_t Size>
+class spscbytering
+{
+ public:
+  static constexpr uint32_t headerSize = 16;
+  static constexpr uint32_t maxMessageSize = Size / 2 - headerSize;
+
+  // producer side
+  bool push(int64_t time, const uint8_t* data, uint32_t size)
+  {
+    if (size > maxMessageSize)
+    {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    auto head = _head.load(std::memory_order_relaxed);
+    auto tail = _tail.load(std::memory_order_acquire);
+    auto pos = head & _wrapMask;
+    auto record = headerSize + padded(size);
+    auto contiguous = Size - pos;
+    // a record never wraps, the rest of the ring is skipped instead
+    auto skip = (record > contiguous) ? contiguous : 0;
+
+    if (Size - (head - tail) < skip + record)
+    {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    if (skip)
+    {
+      if (skip >= headerSize) writeHeader(pos, 0, skipMarker);
+      pos = 0;
+    }
+    writeHeader(pos, time, size);
+    memcpy(_data + pos + headerSize, data, size);
+    _head.store(head + skip + record, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side: the oldest message stays valid until pop()
+  bool peek(int64_t& time, const uint8_t*& data, uint32_t& size)
+  {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    auto head = _head.load(std::memory_order_acquire);
+    while (tail != head)
+    {
+      auto pos = tail & _wrapMask;
+      auto contiguous = Size - pos;
+      uint32_t s = skipMarker;
+      if (contiguous >= headerSize)
+      {
+        memcpy(&time, _data + pos, sizeof(time));
+        memcpy(&s, _data + pos + sizeof(time), sizeof(s));
+      }
+      if (s == skipMarker)
+      {
+        tail += contiguous;
+        _tail.store(tail, std::memory_order_release);
+        continue;
+      }
+      data = _data + pos + headerSize;
+      size = s;
+      return true;
+    }
+    return false;
+  }
+
+  void pop()
+  {
+    int64_t t;
+    const uint8_t* d;
+    uint32_t s;
+    if (!peek(t, d, s)) return;
+    _tail.store(_tail.load(std::memory_order_relaxed) + headerSize + padded(s),
+                std::memory_order_release);
+  }
+
+  // messages which did not fit since the last call
+  uint32_t takeDropped()
+  {
+    return _dropped.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr uint32_t skipMarker = UINT32_MAX;
+
+  static uint32_t padded(uint32_t size)
+  {
+    return (size + 7) & ~7u;
+  }
+  void writeHeader(uint32_t pos, int64_t time, uint32_t size)
+  {
+    memcpy(_data + pos, &time, sizeof(time));
+    memcpy(_data + pos + sizeof(time), &size, sizeof(size));
+  }
+
+  alignas(8) uint8_t _data[Size] = {};
+  std::atomic_uint32_t _head = 0u;
+  std::atomic_uint32_t _tail = 0u;
+  std::atomic_uint32_t _dropped = 0u;
+
+  static constexpr uint32_t _wrapMask = Size - 1;
+  static_assert((Size & _wrapMask) == 0, "Size needs to be a power of 2");
+  static_assert(Size >= 4 * headerSize, "Size is too small");
+};
+}  // namespace ClapWrapper::detail::shared
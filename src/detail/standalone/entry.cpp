@@ -1,4 +1,15 @@
 #include <memory>
+#include <thread>
+
+#if LIN || MAC
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#endif
+#if WIN
+#include <windows.h>
+#endif
 
 #include "standalone_details.h"
 #include "standalone_host.h"
@@ -7,10 +18,34 @@
 namespace freeaudio::clap_wrapper::standalone
 {
 
+// the host holds the plugin instance, which a sample rate change can replace
 static std::unique_ptr<StandaloneHost> standaloneHost;
-std::shared_ptr<Clap::Plugin> plugin;
 const clap_plugin_entry *entry{nullptr};
 
+namespace
+{
+#if LIN || MAC
+// a signal handler may not touch the lifecycle mutex, so it wakes a thread which can
+int shutdownPipe[2]{-1, -1};
+
+void shutdownSignalHandler(int)
+{
+  char c{0};
+  auto res = write(shutdownPipe[1], &c, 1);
+  (void)res;
+}
+#endif
+#if WIN
+BOOL WINAPI shutdownCtrlHandler(DWORD type)
+{
+  if (type != CTRL_C_EVENT && type != CTRL_BREAK_EVENT) return FALSE;
+  // this runs on a thread of its own, which may wait like any other
+  standaloneHost->requestShutdown();
+  return TRUE;
+}
+#endif
+}  // namespace
+
 std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *ee, const std::string &clapId,
                                                uint32_t clapIndex, int argc, char **argv)
 {
@@ -33,7 +68,9 @@ std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *ee, cons
   {
     standaloneHost = std::make_unique<StandaloneHost>();
   }
+  standaloneHost->pluginFactory = fac;
 
+  std::shared_ptr<Clap::Plugin> plugin;
   if (clapId.empty())
   {
     LOGINFO("Loading CLAP by index {}", clapIndex);
@@ -63,7 +100,7 @@ std::shared_ptr<Clap::Plugin> mainCreatePlugin(const clap_plugin_entry *ee, cons
     try
     {
       fs::create_directories(loadPath);
-      standaloneHost->saveStandaloneAndPluginSettings(loadPath, "defaults.clapwrapper");
+      standaloneHost->savePluginDefaultsIfChanged(loadPath, "defaults.clapwrapper");
     }
     catch (const fs::filesystem_error &e)
     {
@@ -94,7 +131,7 @@ void mainStartAudio()
 
 std::shared_ptr<Clap::Plugin> getMainPlugin()
 {
-  return plugin;
+  return standaloneHost ? standaloneHost->clapPlugin : nullptr;
 }
 
 StandaloneHost *getStandaloneHost()
@@ -108,11 +145,54 @@ StandaloneHost *getStandaloneHost()
 
 int mainWait()
 {
-  while (standaloneHost->running)
+  // Ctrl-C, or a SIGTERM from the service manager, ends the wait so that mainFinish saves the
+  // settings
+#if LIN || MAC
+  std::thread watcher;
+  if (pipe(shutdownPipe) == 0)
+  {
+    watcher = std::thread(
+        []()
+        {
+          char c;
+          while (read(shutdownPipe[0], &c, 1) < 0 && errno == EINTR)
+          {
+          }
+          standaloneHost->requestShutdown();
+        });
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = shutdownSignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+  }
+  else
+  {
+    LOGINFO("[WARNING] Unable to watch for SIGINT and SIGTERM : {}", strerror(errno));
+  }
+#endif
+#if WIN
+  SetConsoleCtrlHandler(shutdownCtrlHandler, TRUE);
+#endif
+
+  standaloneHost->waitForShutdown();
+
+#if LIN || MAC
+  if (watcher.joinable())
   {
-    using namespace std::chrono_literals;
-    std::this_thread::sleep_for(1s);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    // the watcher is usually done already, closing the write end ends its read if not
+    close(shutdownPipe[1]);
+    watcher.join();
+    close(shutdownPipe[0]);
+    shutdownPipe[0] = shutdownPipe[1] = -1;
   }
+#endif
+#if WIN
+  SetConsoleCtrlHandler(shutdownCtrlHandler, FALSE);
+#endif
   return 0;
 }
 
@@ -120,10 +200,12 @@ int mainFinish()
 {
   LOGINFO("Shutting down");
 
+  auto plugin = getMainPlugin();
   if (standaloneHost && plugin)
   {
     standaloneHost->stopAudioThread();
     standaloneHost->stopMIDIThread();
+    standaloneHost->writeTelemetryJson();
 
     auto pt = getStandaloneSettingsPath();
     if (pt.has_value())
@@ -10,7 +10,9 @@
 #include "detail/standalone/standalone_host.h"
 #include "detail/standalone/entry.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 
 namespace freeaudio::clap_wrapper::standalone::linux_standalone
 {
@@ -29,6 +31,13 @@ static void activate(GtkApplication *app, gpointer user_data)
   g->setupPlugin(app);
 }
 
+static gboolean updateTitle(gpointer user_data)
+{
+  auto g = (GtkGui *)user_data;
+  g->showDspLoad();
+  return TRUE;
+}
+
 static gboolean onResize(GtkWidget *wid, GdkEventConfigure *event, gpointer user_data)
 {
   auto g = (GtkGui *)user_data;
@@ -102,6 +111,8 @@ void GtkGui::setupPlugin(_GtkApplication *app)
     gtk_box_pack_start(GTK_BOX(vbox), frame, TRUE, TRUE, 0);
 
     g_signal_connect(window, "configure-event", G_CALLBACK(onResize), this);
+    mainWindow = window;
+    g_timeout_add(500, updateTitle, this);
 
     gtk_widget_show_all(window);
 
@@ -114,6 +125,21 @@ void GtkGui::setupPlugin(_GtkApplication *app)
   }
 }
 
+void GtkGui::showDspLoad()
+{
+  auto sah = freeaudio::clap_wrapper::standalone::getStandaloneHost();
+  if (!mainWindow || !sah) return;
+
+  // in the title, as the window is sized to the plugin editor
+  auto t = sah->audioTelemetry.snapshot();
+  auto peak = sah->audioTelemetry.takePeakLoad();
+  auto xruns = t.inputOverflows + t.outputUnderflows + t.reportedXruns;
+  char title[512];
+  snprintf(title, sizeof(title), "%s - DSP %.0f%% (peak %.0f%%) - %llu xruns",
+           plugin->_plugin->desc->name, t.recentLoad * 100, peak * 100, (unsigned long long)xruns);
+  gtk_window_set_title(GTK_WINDOW(mainWindow), title);
+}
+
 void GtkGui::initialize(freeaudio::clap_wrapper::standalone::StandaloneHost *sah)
 {
   sah->gtkGui = this;
@@ -235,6 +261,19 @@ bool GtkGui::parseCommandLine(int argc, char **argv)
 
   bool list_devices{false};
   int sampleRate{s};
+  int bufferSize{0};
+  gboolean midiJitterStats{false};
+  gboolean nullAudio{false};
+  int nullAudioJitter{0};
+  gchar *nullAudioLog{nullptr};
+  double tempo{0};
+  gchar *timeSignature{nullptr}, *loop{nullptr};
+  gboolean play{false}, midiClockSync{false};
+  gchar *telemetryJson{nullptr};
+  int telemetryInterval{-1};
+  gboolean rtLockMemory{false}, rtPrefault{false};
+  gchar *rtCpus{nullptr};
+  int rtPriority{0};
   unsigned int inId{i}, outId{o};
 
 #ifdef __GNUC__
@@ -246,8 +285,36 @@ bool GtkGui::parseCommandLine(int argc, char **argv)
       {"list-devices", 'l', 0, G_OPTION_ARG_NONE, &list_devices, "List Input Output and MIDI Devices",
        nullptr},
       {"sample-rate", 's', 0, G_OPTION_ARG_INT, &sampleRate, "Sample Rate", nullptr},
+      {"buffer-size", 'b', 0, G_OPTION_ARG_INT, &bufferSize,
+       "Buffer Size in samples (the device may round it)", nullptr},
       {"input-device", 'i', 0, G_OPTION_ARG_INT, &inId, "Input Device (0 for no input)", nullptr},
       {"output-device", 'o', 0, G_OPTION_ARG_INT, &outId, "Output Device (0 for no input)", nullptr},
+      {"midi-jitter-stats", 0, 0, G_OPTION_ARG_NONE, &midiJitterStats,
+       "Report MIDI timing statistics on exit", nullptr},
+      {"null-audio", 0, 0, G_OPTION_ARG_NONE, &nullAudio,
+       "Run on a simulated audio device at the exact period", nullptr},
+      {"null-audio-jitter", 0, 0, G_OPTION_ARG_INT, &nullAudioJitter,
+       "Delay each null audio callback by up to this many microseconds", nullptr},
+      {"null-audio-log", 0, 0, G_OPTION_ARG_FILENAME, &nullAudioLog,
+       "Write the deadline margin of every null audio callback to this file", nullptr},
+      {"tempo", 0, 0, G_OPTION_ARG_DOUBLE, &tempo, "Transport tempo in beats per minute", nullptr},
+      {"time-signature", 0, 0, G_OPTION_ARG_STRING, &timeSignature, "Transport time signature",
+       "4/4"},
+      {"play", 0, 0, G_OPTION_ARG_NONE, &play, "Start with the transport playing", nullptr},
+      {"loop", 0, 0, G_OPTION_ARG_STRING, &loop, "Loop the transport between two beats", "START:END"},
+      {"midi-clock-sync", 0, 0, G_OPTION_ARG_NONE, &midiClockSync,
+       "Follow the tempo, start, stop and song position of incoming MIDI clock", nullptr},
+      {"telemetry-json", 0, 0, G_OPTION_ARG_FILENAME, &telemetryJson,
+       "Write the DSP load and xrun statistics of every audio stream to this file on exit", nullptr},
+      {"telemetry-interval", 0, 0, G_OPTION_ARG_INT, &telemetryInterval,
+       "Log the DSP load every this many seconds, 0 for never", nullptr},
+      {"rt-lock-memory", 0, 0, G_OPTION_ARG_NONE, &rtLockMemory,
+       "Lock the process memory so audio never waits on a page fault", nullptr},
+      {"rt-prefault", 0, 0, G_OPTION_ARG_NONE, &rtPrefault,
+       "Touch the audio buffers and run the plugin silently before audio starts", nullptr},
+      {"rt-cpus", 0, 0, G_OPTION_ARG_STRING, &rtCpus, "Pin the audio thread to these CPUs", "2,3"},
+      {"rt-priority", 0, 0, G_OPTION_ARG_INT, &rtPriority,
+       "SCHED_FIFO priority of the audio thread, from 1 to 99", nullptr},
       {NULL}};
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
@@ -284,11 +351,67 @@ bool GtkGui::parseCommandLine(int argc, char **argv)
       std::cout << "  - " << d.name << " (id=" << d.ID << " channels=" << d.outputChannels << ")"
                 << std::endl;
     }
+
+    std::cout << "\nMIDI Input:\n";
+    for (auto &name : sah->midiInputPorts())
+    {
+      std::cout << "  - " << name << std::endl;
+    }
     return false;
   }
 
-  LOGINFO("Post Argument Parse: inId={} outId={} sampleRate={}", inId, outId, sampleRate);
+  LOGINFO("Post Argument Parse: inId={} outId={} sampleRate={} bufferSize={}", inId, outId, sampleRate,
+          bufferSize);
   sah->setStartupAudio(inId, outId, sampleRate);
+  if (bufferSize > 0) sah->requestedBufferSize = (uint32_t)bufferSize;
+  if (midiJitterStats) sah->midiJitterStats.enabled = true;
+  if (nullAudio) sah->useNullAudio = true;
+  if (nullAudioJitter > 0) sah->nullAudioConfig.jitterUs = (uint32_t)nullAudioJitter;
+  if (nullAudioLog)
+  {
+    sah->nullAudioConfig.marginLogPath = nullAudioLog;
+    g_free(nullAudioLog);
+  }
+  if (tempo > 0) sah->transport.setTempo(tempo);
+  if (timeSignature)
+  {
+    unsigned int num{0}, denom{0};
+    if (sscanf(timeSignature, "%u/%u", &num, &denom) == 2)
+      sah->transport.setTimeSignature((uint16_t)num, (uint16_t)denom);
+    else
+      LOGINFO("[WARNING] Ignoring time signature '{}', expected something like 3/4", timeSignature);
+    g_free(timeSignature);
+  }
+  if (loop)
+  {
+    double start{0}, end{0};
+    if (sscanf(loop, "%lf:%lf", &start, &end) == 2 && end > start)
+      sah->transport.setLoop(true, start, end);
+    else
+      LOGINFO("[WARNING] Ignoring loop '{}', expected start and end beats like 0:16", loop);
+    g_free(loop);
+  }
+  if (play) sah->transport.setPlaying(true);
+  if (midiClockSync) sah->transport.setSyncToMidiClock(true);
+  if (telemetryJson)
+  {
+    sah->telemetryJsonPath = telemetryJson;
+    g_free(telemetryJson);
+  }
+  if (telemetryInterval >= 0) sah->telemetryLogSeconds = (uint32_t)telemetryInterval;
+  // only what is given replaces what the environment asked for
+  auto &rt = sah->realtimeOptions;
+  if (rtLockMemory) rt.lockMemory = true;
+  if (rtPrefault) rt.prefault = true;
+  if (rtPriority > 0) rt.priority = std::clamp(rtPriority, 0, 99);
+  if (rtCpus)
+  {
+    if (!parseCpuList(rtCpus, rt.cpus))
+      LOGINFO("[WARNING] Ignoring CPU list '{}', expected something like 2,3 or 2-5", rtCpus);
+    g_free(rtCpus);
+  }
+  // anything but the defaults was asked for explicitly and wins over the saved settings
+  sah->startupAudioFromCommandLine = inId != i || outId != o || sampleRate != s || bufferSize > 0;
 
   return true;
 }
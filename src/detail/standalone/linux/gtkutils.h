@@ -24,6 +24,10 @@ struct GtkGui
   void setupPlugin(_GtkApplication *app);
   bool resizePlugin(_GtkWidget *wid, uint32_t w, uint32_t h);
 
+  // the DSP load and xruns of the audio telemetry, in the window title
+  _GtkWidget *mainWindow{nullptr};
+  void showDspLoad();
+
   clap_id currTimer{8675309};
   std::mutex cbMutex{};
 
@@ -37,6 +37,41 @@
   }
 }
 
+- (void)createPluginGui
+{
+  auto plugin = freeaudio::clap_wrapper::standalone::getMainPlugin();
+  if (plugin->_ext._gui)
+  {
+    auto ui = plugin->_ext._gui;
+    auto p = plugin->_plugin;
+    if (!ui->is_api_supported(p, CLAP_WINDOW_API_COCOA, false))
+      LOGINFO("[WARNING] GUI API not supported");
+
+    ui->create(p, CLAP_WINDOW_API_COCOA, false);
+    ui->set_scale(p, 1);
+
+    uint32_t w, h;
+    ui->get_size(p, &w, &h);
+    if (ui->can_resize(p))
+    {
+      ui->adjust_size(p, &w, &h);
+    }
+
+    NSView *view = [[self window] contentView];
+
+    NSSize sz;
+    sz.width = w;
+    sz.height = h;
+    [[self window] setContentSize:sz];
+
+    clap_window win;
+    win.api = CLAP_WINDOW_API_COCOA;
+    win.cocoa = view;
+    ui->set_parent(p, &win);
+    ui->show(p);
+  }
+}
+
 - (void)doSetup
 {
   // Insert code here to initialize your application
@@ -51,19 +86,13 @@
   std::string clapName{HOSTED_CLAP_NAME};
   LOGINFO("Loading '{}'", clapName);
 
-  auto pts = Clap::getValidCLAPSearchPaths();
-
   auto lib = Clap::Library();
 
-  for (const auto &searchPaths : pts)
+  auto clapPath = Clap::findCLAPInSearchPaths(clapName + ".clap");
+  if (fs::is_directory(clapPath))
   {
-    auto clapPath = searchPaths / (clapName + ".clap");
-
-    if (fs::is_directory(clapPath) && !entry)
-    {
-      lib.load(clapPath);
-      entry = lib._pluginEntry;
-    }
+    lib.load(clapPath);
+    entry = lib._pluginEntry;
   }
 #endif
 
@@ -102,6 +131,10 @@
 
   auto plugin =
       freeaudio::clap_wrapper::standalone::mainCreatePlugin(entry, pid, pindex, 1, (char **)argv);
+  if (!plugin)
+  {
+    return;
+  }
 
   [[self window] orderFrontRegardless];
   [[self window] setDelegate:self];
@@ -116,36 +149,19 @@
     return false;
   };
 
-  if (plugin->_ext._gui)
-  {
-    auto ui = plugin->_ext._gui;
-    auto p = plugin->_plugin;
-    if (!ui->is_api_supported(p, CLAP_WINDOW_API_COCOA, false))
-      LOGINFO("[WARNING] GUI API not supported");
-
-    ui->create(p, CLAP_WINDOW_API_COCOA, false);
-    ui->set_scale(p, 1);
+  [self createPluginGui];
 
-    uint32_t w, h;
-    ui->get_size(p, &w, &h);
-    if (ui->can_resize(p))
+  // a sample rate change hands the audio to a second instance, whose editor replaces this one
+  freeaudio::clap_wrapper::standalone::getStandaloneHost()->onPluginReplaced =
+      [self](const auto &previous, const auto &current)
+  {
+    if (previous->_ext._gui)
     {
-      ui->adjust_size(p, &w, &h);
+      previous->_ext._gui->hide(previous->_plugin);
+      previous->_ext._gui->destroy(previous->_plugin);
     }
-
-    NSView *view = [[self window] contentView];
-
-    NSSize sz;
-    sz.width = w;
-    sz.height = h;
-    [[self window] setContentSize:sz];
-
-    clap_window win;
-    win.api = CLAP_WINDOW_API_COCOA;
-    win.cocoa = view;
-    ui->set_parent(p, &win);
-    ui->show(p);
-  }
+    [self createPluginGui];
+  };
 
   freeaudio::clap_wrapper::standalone::getStandaloneHost()->displayAudioError = [](auto &s)
   {
@@ -183,6 +199,7 @@
   LOGDETAIL("Application terminating");
   freeaudio::clap_wrapper::standalone::getStandaloneHost()->displayAudioError = nullptr;
   freeaudio::clap_wrapper::standalone::getStandaloneHost()->onRequestResize = nullptr;
+  freeaudio::clap_wrapper::standalone::getStandaloneHost()->onPluginReplaced = nullptr;
 
   auto plugin = freeaudio::clap_wrapper::standalone::getMainPlugin();
 
@@ -204,6 +221,9 @@
   {
     NSRect windowRect = NSMakeRect(0, 0, 400, 360);
 
+    // devices may have come or gone since the catalogue was probed
+    freeaudio::clap_wrapper::standalone::getStandaloneHost()->invalidateDevices();
+
     auto *window = [[AudioSettingsWindow alloc]
         initWithContentRect:windowRect
                   styleMask:NSWindowStyleMaskTitled | NSWindowStyleMaskClosable |
@@ -465,7 +485,9 @@
     const auto sr = [[[sampleRateSelection selectedItem] title] integerValue];
 
     auto standaloneHost = freeaudio::clap_wrapper::standalone::getStandaloneHost();
-    standaloneHost->startAudioThreadOn(inId, 2, useIn, outId, 2, useOut, (int32_t)sr);
+    // all channels of the devices, the audio routing picks the ones the plugin uses
+    uint32_t channels = standaloneHost->utilityBufferMaxChannels;
+    standaloneHost->startAudioThreadOn(inId, channels, useIn, outId, channels, useOut, (int32_t)sr);
 
     [self close];
   }
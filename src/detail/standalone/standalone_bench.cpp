@@ -0,0 +1,303 @@
+#include "standalone_bench.h"
+#include "standalone_details.h"
+#include "standalone_host.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace
+{
+struct BenchConfig
+{
+  std::vector<int32_t> sampleRates{44100, 48000, 96000};
+  std::vector<uint32_t> blockSizes{16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192};
+  double seconds{5.0};
+  bool midi{true};
+  std::string output;
+};
+
+struct BenchResult
+{
+  int32_t sampleRate{0};
+  uint32_t blockSize{0};
+  uint64_t blocks{0};
+  double nsPerSample{0}, realtimeFactor{0};
+  int64_t p50{0}, p90{0}, p99{0}, p999{0}, worst{0};
+  double worstLoad{0};
+};
+
+template <typename T>
+bool parseList(const std::string &s, std::vector<T> &res)
+{
+  res.clear();
+  std::istringstream iss(s);
+  std::string item;
+  while (std::getline(iss, item, ','))
+  {
+    char *end{nullptr};
+    auto v = std::strtol(item.c_str(), &end, 10);
+    if (item.empty() || *end || v <= 0) return false;
+    res.push_back((T)v);
+  }
+  return !res.empty();
+}
+
+bool parseBench(int argc, char **argv, BenchConfig &cfg, std::string &error)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if (arg == "--bench") continue;
+    if (arg == "--no-midi")
+    {
+      cfg.midi = false;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      error = "Unknown bench option, or one without a value: '" + arg + "'";
+      return false;
+    }
+    std::string value{argv[++i]};
+    bool ok = true;
+    if (arg == "--sample-rates")
+      ok = parseList(value, cfg.sampleRates);
+    else if (arg == "--block-sizes")
+      ok = parseList(value, cfg.blockSizes) &&
+           std::all_of(cfg.blockSizes.begin(), cfg.blockSizes.end(),
+                       [](auto b) { return b < (uint32_t)StandaloneHost::utilityBufferSize; });
+    else if (arg == "--seconds")
+      ok = (cfg.seconds = std::strtod(value.c_str(), nullptr)) > 0;
+    else if (arg == "--output")
+      cfg.output = value;
+    else
+      ok = false;
+    if (!ok)
+    {
+      error = "Unknown bench option, or a value out of range: '" + arg + " " + value + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string jsonString(const std::string &s)
+{
+  std::string res{"\""};
+  for (auto ch : s)
+  {
+    if (ch == '"' || ch == '\\')
+    {
+      res += '\\';
+      res += ch;
+    }
+    else if ((unsigned char)ch < 0x20)
+    {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)ch);
+      res += buf;
+    }
+    else
+      res += ch;
+  }
+  return res + "\"";
+}
+
+BenchResult runConfig(StandaloneHost &host, const BenchConfig &cfg, int32_t sampleRate,
+                      uint32_t blockSize)
+{
+  BenchResult res;
+  res.sampleRate = sampleRate;
+  res.blockSize = blockSize;
+
+  auto ins = host.totalInputChannels, outs = host.totalOutputChannels;
+  host.currentSampleRate = sampleRate;
+  host.currentBufferSize = blockSize;
+  host.setupAudioRouting(ins, outs, true);
+  // a sleeping plugin would be timed writing silence
+  host.sleepAllowed = false;
+  host.activatePlugin(sampleRate, (int32_t)blockSize, (int32_t)blockSize);
+
+  // a quiet sine with a little deterministic noise, the same on every input
+  std::vector<float> input((size_t)ins * blockSize), output((size_t)outs * blockSize);
+  uint32_t noise = 22222;
+  for (auto c = 0U; c < ins; ++c)
+  {
+    for (auto i = 0U; i < blockSize; ++i)
+    {
+      noise = noise * 1664525 + 1013904223;
+      input[(size_t)c * blockSize + i] = 0.25f * std::sin(6.2831853f * 220.f * i / (float)sampleRate) +
+                                         0.01f * ((float)(noise >> 8) / 16777216.f - 0.5f);
+    }
+  }
+
+  // notes come through a MIDI input of their own, as a device would send them
+  auto midiIn = std::make_unique<StandaloneHost::MidiInput>();
+  midiIn->host = &host;
+  if (cfg.midi) host.activeMidiInputs[0].store(midiIn.get());
+
+  auto warmup = (uint64_t)std::max(8.0, 0.5 * sampleRate / blockSize);
+  res.blocks = (uint64_t)std::max(64.0, std::ceil(cfg.seconds * sampleRate / blockSize));
+  std::vector<int64_t> times(res.blocks);
+
+  std::thread audio(
+      [&]()
+      {
+        // a chord changing every eighth of a second, whatever the block size
+        auto noteFrames = (uint64_t)sampleRate / 8;
+        uint64_t frame = 0, nextNote = 0;
+        uint8_t key = 48;
+        for (uint64_t b = 0; b < warmup + res.blocks; ++b)
+        {
+          if (cfg.midi)
+          {
+            for (; nextNote < frame + blockSize; nextNote += noteFrames)
+            {
+              uint8_t off[3]{0x80, key, 0}, on[3]{0x90, (uint8_t)(48 + (key - 47) % 24), 100};
+              auto now = midiClockNow();
+              midiIn->queue.push(now, off, 3);
+              midiIn->queue.push(now, on, 3);
+              key = on[1];
+            }
+          }
+
+          auto start = std::chrono::steady_clock::now();
+          host.clapProcess(output.data(), input.data(), blockSize);
+          auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+          if (b >= warmup) times[b - warmup] = ns;
+          frame += blockSize;
+        }
+      });
+  audio.join();
+
+  host.activeMidiInputs[0].store(nullptr);
+  host.clapPlugin->stop_processing();
+  host.clapPlugin->deactivate();
+  host.isActive = false;
+
+  double total = 0;
+  for (auto t : times) total += (double)t;
+  auto samples = (double)res.blocks * blockSize;
+  res.nsPerSample = total / samples;
+  res.realtimeFactor = total > 0 ? samples / sampleRate * 1e9 / total : 0;
+
+  std::sort(times.begin(), times.end());
+  auto pct = [&](double p) { return times[std::min(times.size() - 1, (size_t)(p * times.size()))]; };
+  res.p50 = pct(0.5);
+  res.p90 = pct(0.9);
+  res.p99 = pct(0.99);
+  res.p999 = pct(0.999);
+  res.worst = times.back();
+  res.worstLoad = (double)res.worst / (blockSize * 1e9 / sampleRate);
+  return res;
+}
+}  // namespace
+
+bool isBenchCommandLine(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--bench") return true;
+  }
+  return false;
+}
+
+int mainBench(const clap_plugin_entry *entry, const std::string &clapId, uint32_t clapIndex, int argc,
+              char **argv)
+{
+  BenchConfig cfg;
+  std::string error;
+  if (!parseBench(argc, argv, cfg, error))
+  {
+    std::cerr << error << std::endl;
+    return 2;
+  }
+
+  entry->init(argv[0]);
+  auto factory = (const clap_plugin_factory *)entry->get_factory(CLAP_PLUGIN_FACTORY_ID);
+  if (!factory)
+  {
+    std::cerr << "The CLAP has no plugin factory" << std::endl;
+    entry->deinit();
+    return 3;
+  }
+
+  // a host of its own, so no saved settings or state change what is measured
+  auto host = std::make_unique<StandaloneHost>();
+  {
+    auto plugin = clapId.empty() ? Clap::Plugin::createInstance(factory, clapIndex, host.get())
+                                 : Clap::Plugin::createInstance(factory, clapId, host.get());
+    if (!plugin)
+    {
+      std::cerr << "Unable to create the plugin" << std::endl;
+      entry->deinit();
+      return 3;
+    }
+    host->setPlugin(plugin);
+    plugin->initialize();
+  }
+
+  auto desc = host->clapPlugin->_plugin->desc;
+  std::ostringstream json;
+  json << "{\n  \"plugin\": {\"id\": " << jsonString(desc->id)
+       << ", \"name\": " << jsonString(desc->name)
+       << ", \"version\": " << jsonString(desc->version ? desc->version : "") << "},\n"
+       << "  \"inputChannels\": " << host->totalInputChannels
+       << ", \"outputChannels\": " << host->totalOutputChannels
+       << ", \"midi\": " << (cfg.midi ? "true" : "false") << ", \"seconds\": " << cfg.seconds
+       << ",\n  \"results\": [";
+
+  bool first = true;
+  for (auto sr : cfg.sampleRates)
+  {
+    for (auto bs : cfg.blockSizes)
+    {
+      auto r = runConfig(*host, cfg, sr, bs);
+      LOGDETAIL("Bench {}Hz {} frames: {:.2f}ns/sample, {:.1f}x realtime, worst block at {:.1f}%",
+                sr, bs, r.nsPerSample, r.realtimeFactor, r.worstLoad * 100);
+
+      char buf[512];
+      snprintf(buf, sizeof(buf),
+               "%s\n    {\"sampleRate\": %d, \"blockSize\": %u, \"blocks\": %llu, "
+               "\"nsPerSample\": %.3f, \"realtimeFactor\": %.3f, "
+               "\"blockNs\": {\"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"p999\": %lld, "
+               "\"worst\": %lld}, \"worstLoad\": %.4f}",
+               first ? "" : ",", r.sampleRate, r.blockSize, (unsigned long long)r.blocks, r.nsPerSample,
+               r.realtimeFactor, (long long)r.p50, (long long)r.p90, (long long)r.p99, (long long)r.p999,
+               (long long)r.worst, r.worstLoad);
+      json << buf;
+      first = false;
+    }
+  }
+  json << "\n  ]\n}\n";
+
+  host->clapPlugin = nullptr;
+  host.reset();
+  entry->deinit();
+
+  if (cfg.output.empty())
+  {
+    std::cout << json.str();
+    return 0;
+  }
+  std::ofstream out(cfg.output);
+  out << json.str();
+  if (!out)
+  {
+    std::cerr << "Can't write '" << cfg.output << "'" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,27 @@
+#pragma once
+
+/*
+ * Benchmarking the plugin as the standalone runs it.
+ *
+ *   <standalone> --bench [--sample-rates 44100,48000,96000] [--block-sizes 16,32,...,8192]
+ *                [--seconds 5] [--no-midi] [--output results.json]
+ *
+ * For every sample rate and block size the plugin is activated through
+ * StandaloneHost::activatePlugin and StandaloneHost::clapProcess is called in a tight loop,
+ * with a synthetic signal on every input and, unless --no-midi, a stream of notes fed
+ * through the same per-port MIDI queue a device would use. Each block is timed. The JSON
+ * result has, per configuration, ns per sample, the realtime factor, block time
+ * percentiles and the worst block as a share of its period.
+ */
+
+#include <string>
+
+#include <clap/clap.h>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+bool isBenchCommandLine(int argc, char **argv);
+
+int mainBench(const clap_plugin_entry *entry, const std::string &clapId, uint32_t clapIndex, int argc,
+              char **argv);
+}  // namespace freeaudio::clap_wrapper::standalone
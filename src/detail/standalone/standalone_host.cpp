@@ -1,7 +1,10 @@
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 #include "standalone_host.h"
-#include <fstream>
+#include "detail/shared/interleave.h"
 
 #if LIN
 #if CLAP_WRAPPER_HAS_GTK3
@@ -37,6 +40,17 @@ std::optional<fs::path> getStandaloneSettingsPath()
 
   return std::nullopt;
 }
+#elif LIN
+std::optional<fs::path> getStandaloneSettingsPath()
+{
+  auto xdg = getenv("XDG_CONFIG_HOME");
+  if (xdg && xdg[0] == '/') return fs::path(xdg) / "clap-wrapper-standalone";
+
+  auto home = getenv("HOME");
+  if (home) return fs::path(home) / ".config" / "clap-wrapper-standalone";
+
+  return std::nullopt;
+}
 #elif !MAC
 std::optional<fs::path> getStandaloneSettingsPath()
 {
@@ -47,6 +61,7 @@ std::optional<fs::path> getStandaloneSettingsPath()
 
 StandaloneHost::~StandaloneHost()
 {
+  stopMIDIOutput();
 }
 
 void StandaloneHost::setupAudioBusses(const clap_plugin_t *plugin,
@@ -73,7 +88,7 @@ void StandaloneHost::setupAudioBusses(const clap_plugin_t *plugin,
     if (info.flags & CLAP_AUDIO_PORT_IS_MAIN) mainOutput = i;
   }
 
-  assert(totalOutputChannels + totalInputChannels < utilityBufferMaxChannels);
+  assert(totalOutputChannels + totalInputChannels <= utilityBufferPluginChannels);
 }
 
 void StandaloneHost::setupMIDIBusses(const clap_plugin_t *plugin,
@@ -97,123 +112,354 @@ void StandaloneHost::setupMIDIBusses(const clap_plugin_t *plugin,
   if (numMIDIOutPorts > 0)
   {
     createsMidiOutput = true;
-    LOGINFO("[WARNING] Midi Output not supported yet");
   }
 }
 
+void StandaloneHost::setupAudioRouting(uint32_t deviceIns, uint32_t deviceOuts, bool nonInterleaved)
+{
+  auto &r = audioRouting;
+  r.build(inputChannelByBus, outputChannelByBus, mainInput, mainOutput, inputRoutes, outputRoutes,
+          deviceIns, deviceOuts, nonInterleaved);
+
+  if (r.pluginInputChannels + r.pluginOutputChannels > utilityBufferPluginChannels)
+  {
+    LOGINFO("[ERROR] The plugin has {} audio channels, the standalone supports {}",
+            r.pluginInputChannels + r.pluginOutputChannels, utilityBufferPluginChannels);
+  }
+  auto scratch = [this](uint32_t slot)
+  { return &(utilityBuffer[std::min<uint32_t>(slot, utilityBufferPluginChannels - 1)][0]); };
+  auto zero = &(utilityBuffer[utilityBufferZeroChannel][0]);
+  auto discard = &(utilityBuffer[utilityBufferDiscardChannel][0]);
+  memset(zero, 0, sizeof(utilityBuffer[0]));
+
+  // all the pointers the callback hands to the plugin live here, it only fills them
+  inputChannelPtrs.assign(r.pluginInputChannels, zero);
+  outputChannelPtrs.assign(r.pluginOutputChannels, nullptr);
+  audioInputBuffers.assign(inputChannelByBus.size(), clap_audio_buffer{});
+  for (auto b = 0U; b < inputChannelByBus.size(); ++b)
+  {
+    audioInputBuffers[b].channel_count = inputChannelByBus[b];
+    audioInputBuffers[b].data32 = inputChannelPtrs.data() + r.inputBusOffset[b];
+  }
+  audioOutputBuffers.assign(outputChannelByBus.size(), clap_audio_buffer{});
+  for (auto b = 0U; b < outputChannelByBus.size(); ++b)
+  {
+    audioOutputBuffers[b].channel_count = outputChannelByBus[b];
+    audioOutputBuffers[b].data32 = outputChannelPtrs.data() + r.outputBusOffset[b];
+  }
+
+  // plugins only read their inputs, so all inputs fed by a device channel share one buffer
+  hasSilentInputs = false;
+  deviceInputPtrs.assign(r.deviceInputChannels, discard);
+  usedDeviceInputs.clear();
+  for (auto k = 0U; k < r.pluginInputChannels; ++k)
+  {
+    auto src = r.inputSource[k];
+    if (src < 0)
+    {
+      hasSilentInputs = true;
+      continue;
+    }
+    if (deviceInputPtrs[src] == discard)
+    {
+      deviceInputPtrs[src] = scratch(k);
+      usedDeviceInputs.push_back((uint32_t)src);
+    }
+    inputChannelPtrs[k] = deviceInputPtrs[src];
+  }
+
+  deviceOutputPtrs.assign(r.deviceOutputChannels, zero);
+  for (auto k = 0U; k < r.pluginOutputChannels; ++k)
+  {
+    outputChannelPtrs[k] = scratch(r.pluginInputChannels + k);
+    if (r.outputTarget[k] >= 0) deviceOutputPtrs[r.outputTarget[k]] = outputChannelPtrs[k];
+  }
+  for (const auto &[k, d] : r.outputCopies) deviceOutputPtrs[d] = outputChannelPtrs[k];
+}
+
 void StandaloneHost::clapProcess(void *pOutput, const void *pInput, uint32_t frameCount)
 {
   if (!running)
   {
-    finishedRunning = true;
+    // the stream keeps calling back until it is stopped, which should not play stale buffers
+    silenceDevice((float *)pOutput, frameCount, 0, frameCount);
+    if (!finishedRunning.exchange(true)) notifyLifecycle();
     return;
   }
 
-  auto f = (float *)pOutput;
+  auto out = (float *)pOutput;
+  auto in = (const float *)pInput;
+
+  warmingUp = warmupBlocksLeft > 0;
+  if (warmingUp) --warmupBlocksLeft;
+
+  clearInputEvents();
+  if (!warmingUp)
+  {
+    midiBlockClock.startBlock(midiClockNow(), frameCount, currentSampleRate);
+    drainMIDIInputs();
+  }
+
+  // RtAudio mostly calls back with the block size it granted, which is what the plugin was
+  // activated with, but PulseAudio and some JACK setups send larger periods now and then. Those
+  // are processed in blocks the plugin was activated for.
+  auto subBlock = activeMaxBlock > 0 ? activeMaxBlock : frameCount;
+  if (frameCount > subBlock)
+  {
+    oversizedBlocks.fetch_add(1, std::memory_order_relaxed);
+    if (frameCount > largestOversizedBlock.load(std::memory_order_relaxed))
+      largestOversizedBlock.store(frameCount, std::memory_order_relaxed);
+  }
+  for (uint32_t offset = 0; offset < frameCount; offset += subBlock)
+  {
+    processSubBlock(out, in, frameCount, offset, std::min(subBlock, frameCount - offset));
+  }
+  subBlockOffset = 0;
+
+  // the silent blocks of the warm-up must not use up the fade in
+  if (warmingUp)
+  {
+    silenceDevice(out, frameCount, 0, frameCount);
+    return;
+  }
+  if (fadeGain < 1.f || fadeOutRequested.load(std::memory_order_relaxed)) applyFade(out, frameCount);
+}
+
+void StandaloneHost::processSubBlock(float *out, const float *in, uint32_t frameCount,
+                                     uint32_t offset, uint32_t frames)
+{
+  const auto &r = audioRouting;
 
   clap_process process;
-  process.transport = nullptr;  // this is a freefloating host
   process.in_events = &inputEvents;
   process.out_events = &outputEvents;
-  process.frames_count = frameCount;
-  process.audio_inputs_count = numAudioInputs;
-  process.audio_outputs_count = numAudioOutputs;
-
-  assert(frameCount < utilityBufferSize);
-  if (frameCount >= utilityBufferSize)
+  process.frames_count = frames;
+  process.audio_inputs_count = (uint32_t)audioInputBuffers.size();
+  process.audio_outputs_count = (uint32_t)audioOutputBuffers.size();
+  process.audio_inputs = audioInputBuffers.data();
+  process.audio_outputs = audioOutputBuffers.data();
+
+  // a plugin writing into its inputs would leave garbage where unconnected busses expect silence
+  if (hasSilentInputs)
   {
-    LOGINFO("frameCount {} is beyond utility buffer size {}", frameCount, utilityBufferSize);
-    std::terminate();
+    memset(utilityBuffer[utilityBufferZeroChannel], 0, frames * sizeof(float));
   }
 
-  process.audio_outputs_count = 1;
+  if (r.nonInterleaved)
+  {
+    // the device blocks move with the block size, so the pointers are set for every block
+    for (auto k = 0U; k < r.pluginInputChannels; ++k)
+    {
+      auto src = r.inputSource[k];
+      if (src >= 0 && in)
+        inputChannelPtrs[k] = const_cast<float *>(in + (size_t)src * frameCount + offset);
+    }
+    for (auto k = 0U; k < r.pluginOutputChannels; ++k)
+    {
+      auto dst = r.outputTarget[k];
+      if (dst >= 0 && out) outputChannelPtrs[k] = out + (size_t)dst * frameCount + offset;
+    }
+  }
+  else if (in && !usedDeviceInputs.empty())
+  {
+    auto channels = r.deviceInputChannels;
+    auto src = in + (size_t)channels * offset;
+    if (channels == 2 || channels == 4 || channels == 8 || usedDeviceInputs.size() == channels)
+    {
+      ClapWrapper::detail::shared::deinterleave(src, deviceInputPtrs.data(), channels, frames);
+    }
+    else
+    {
+      // only a few channels of a wide device are used
+      for (auto d : usedDeviceInputs)
+      {
+        auto dst = deviceInputPtrs[d];
+        for (auto i = 0U; i < frames; ++i) dst[i] = src[channels * i + d];
+      }
+    }
+  }
 
-  float *bufferChanPtr[utilityBufferMaxChannels]{};
-  clap_audio_buffer buffers[utilityBufferMaxChannels]{};  // probably twice as large
-  size_t ptrIdx{0};
-  size_t bufIdx{0};
+  if (warmingUp)
+  {
+    process.transport = nullptr;
+    clapPlugin->_plugin->process(clapPlugin->_plugin, &process);
+    return;
+  }
 
-  int32_t mainOutIdx{-1}, mainInIdx{-1};
+  // the transport runs over the part of the callback period this block takes
+  auto period = midiBlockClock.periodEnd - midiBlockClock.periodStart;
+  auto startNs = midiBlockClock.periodStart + period * offset / frameCount;
+  auto endNs = midiBlockClock.periodStart + period * (offset + frames) / frameCount;
+  process.transport = transport.startBlock(frames, currentSampleRate, startNs, endNs);
+  if (auto wrap = transport.loopWrap())
+  {
+    wrap->header.time += offset;
+    pushInputEvent(&(wrap->header));
+  }
 
-  process.audio_inputs = &(buffers[0]);
-  for (auto inp = 0U; inp < numAudioInputs; ++inp)
+  // the events up to the end of this block, with their times rebased to it. The ones of earlier
+  // blocks end up before offset, so the order stays as it is.
+  eventWindowStart += eventWindowSize;
+  eventWindowSize = 0;
+  while (eventWindowStart + eventWindowSize < (uint32_t)currInput)
+  {
+    auto ev = queuedEvent(eventWindowStart + eventWindowSize);
+    if (ev->time >= offset + frames) break;
+    ev->time = ev->time >= offset ? ev->time - offset : 0;
+    eventWindowSize++;
+  }
+  subBlockOffset = offset;
+
+  // events and play state changes are cheap to see, the input level is only looked at if needed
+  auto playing = (process.transport->flags & CLAP_TRANSPORT_IS_PLAYING) != 0;
+  auto activity =
+      processRequested.exchange(false) || eventWindowSize > 0 || playing != transportWasPlaying;
+  transportWasPlaying = playing;
+  if (pluginSleeping)
   {
-    // For now assert sterep
-    assert(inputChannelByBus[inp] == 2);
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    memset(bufferChanPtr[ptrIdx], 0, frameCount * sizeof(float));
-    ptrIdx++;
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    memset(bufferChanPtr[ptrIdx], 0, frameCount * sizeof(float));
-    ptrIdx++;
+    if (!activity && pluginInputsQuiet(frames))
+    {
+      sleptBlocks.fetch_add(1, std::memory_order_relaxed);
+      silenceDevice(out, frameCount, offset, frames);
+      return;
+    }
+    pluginSleeping = false;
+    activity = true;
+  }
+
+  auto status = clapPlugin->_plugin->process(clapPlugin->_plugin, &process);
+  pluginSleeping = sleepAllowed && shouldSleep(status, activity, frames);
 
-    buffers[bufIdx].channel_count = 2;
-    buffers[bufIdx].data32 = &(bufferChanPtr[ptrIdx - 2]);
+  if (!out) return;
 
-    if (mainInIdx < 0)
+  if (r.nonInterleaved)
+  {
+    for (const auto &[k, d] : r.outputCopies)
     {
-      // TODO cleaner
-      mainInIdx = (int32_t)(ptrIdx - 2);
+      memcpy(out + (size_t)d * frameCount + offset, outputChannelPtrs[k], frames * sizeof(float));
     }
-    bufIdx++;
+    for (auto d : r.silentOutputs)
+    {
+      memset(out + (size_t)d * frameCount + offset, 0, frames * sizeof(float));
+    }
+    return;
   }
 
-  process.audio_outputs = &(buffers[bufIdx]);
-  for (auto oup = 0U; oup < numAudioOutputs; ++oup)
-  {
-    // For now assert sterep
-    assert(outputChannelByBus[oup] == 2);
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    ptrIdx++;
-    bufferChanPtr[ptrIdx] = &(utilityBuffer[ptrIdx][0]);
-    ptrIdx++;
+  ClapWrapper::detail::shared::interleave(deviceOutputPtrs.data(),
+                                          out + (size_t)r.deviceOutputChannels * offset,
+                                          r.deviceOutputChannels, frames);
+}
 
-    buffers[bufIdx].channel_count = 2;
-    buffers[bufIdx].data32 = &(bufferChanPtr[ptrIdx - 2]);
+void StandaloneHost::applyFade(float *out, uint32_t frameCount)
+{
+  auto target = fadeOutRequested.load(std::memory_order_relaxed) ? 0.f : 1.f;
+  auto step = (float)(1.0 / std::max(1.0, fadeSeconds * currentSampleRate));
+  auto ramp = [target, step](float g)
+  { return target > g ? std::min(target, g + step) : std::max(target, g - step); };
 
-    if (mainOutIdx < 0)
+  auto gain = fadeGain;
+  if (out)
+  {
+    const auto &r = audioRouting;
+    auto channels = r.deviceOutputChannels;
+    for (auto d = 0U; d < channels; ++d)
     {
-      // TODO cleaner
-      mainOutIdx = (int32_t)(ptrIdx - 2);
+      gain = fadeGain;
+      for (auto i = 0U; i < frameCount; ++i)
+      {
+        gain = ramp(gain);
+        if (r.nonInterleaved)
+          out[(size_t)d * frameCount + i] *= gain;
+        else
+          out[(size_t)i * channels + d] *= gain;
+      }
     }
+  }
+  if (!out || audioRouting.deviceOutputChannels == 0)
+  {
+    for (auto i = 0U; i < frameCount; ++i) gain = ramp(gain);
+  }
+  fadeGain = gain;
 
-    bufIdx++;
+  if (target == 0.f && gain <= 0.f)
+  {
+    running = false;
+    if (!finishedRunning.exchange(true)) notifyLifecycle();
   }
+}
 
-  if (mainInIdx >= 0 && pInput)
+void StandaloneHost::silenceDevice(float *out, uint32_t frameCount, uint32_t offset, uint32_t frames)
+{
+  if (!out) return;
+  const auto &r = audioRouting;
+  if (!r.nonInterleaved)
   {
-    auto *g = (const float *)pInput;
-    auto stride = currentInputChannels;
-    auto chan2Off = (currentInputChannels > 1) ? 1 : 0;
+    memset(out + (size_t)r.deviceOutputChannels * offset, 0,
+           (size_t)r.deviceOutputChannels * frames * sizeof(float));
+    return;
+  }
+  for (auto d = 0U; d < r.deviceOutputChannels; ++d)
+  {
+    memset(out + (size_t)d * frameCount + offset, 0, frames * sizeof(float));
+  }
+}
 
+bool StandaloneHost::pluginInputsQuiet(uint32_t frameCount) const
+{
+  for (auto k = 0U; k < audioRouting.pluginInputChannels; ++k)
+  {
+    auto p = inputChannelPtrs[k];
+    if (p == utilityBuffer[utilityBufferZeroChannel]) continue;
     for (auto i = 0U; i < frameCount; ++i)
     {
-      utilityBuffer[mainInIdx][i] = g[stride * i];
-      utilityBuffer[mainInIdx + 1][i] = g[stride * i + chan2Off];
+      if (std::fabs(p[i]) > quietLevel) return false;
     }
   }
+  return true;
+}
 
-  clearInputEvents();
-  clap_event_midi midi;
-  midiChunk ck;
-  while (midiToAudioQueue.pop(ck))
+bool StandaloneHost::pluginOutputsQuiet(uint32_t frameCount) const
+{
+  for (auto k = 0U; k < audioRouting.pluginOutputChannels; ++k)
   {
-    midi.port_index = 0;
-    midi.header.size = sizeof(clap_event_midi);
-    midi.header.time = 0;
-    midi.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-    midi.header.type = CLAP_EVENT_MIDI;
-    midi.header.flags = 0;
-    memcpy(midi.data, ck.dat, sizeof(ck.dat));
-    pushInputEvent(&(midi.header));
+    auto p = outputChannelPtrs[k];
+    for (auto i = 0U; i < frameCount; ++i)
+    {
+      if (std::fabs(p[i]) > quietLevel) return false;
+    }
   }
+  return true;
+}
 
-  clapPlugin->_plugin->process(clapPlugin->_plugin, &process);
-
-  for (auto i = 0U; i < frameCount; ++i)
+bool StandaloneHost::shouldSleep(clap_process_status status, bool activity, uint32_t frameCount)
+{
+  switch (status)
   {
-    f[2 * i] = utilityBuffer[mainOutIdx][i];
-    f[2 * i + 1] = utilityBuffer[mainOutIdx + 1][i];
+    case CLAP_PROCESS_SLEEP:
+      return true;
+    case CLAP_PROCESS_CONTINUE_IF_NOT_QUIET:
+      return !activity && pluginInputsQuiet(frameCount) && pluginOutputsQuiet(frameCount);
+    case CLAP_PROCESS_TAIL:
+    {
+      if (activity || !pluginInputsQuiet(frameCount))
+      {
+        tailFramesLeft = -1;
+        return false;
+      }
+      if (tailFramesLeft < 0)
+      {
+        auto tail = clapPlugin->_ext._tail ? clapPlugin->_ext._tail->get(clapPlugin->_plugin) : 0;
+        // an infinite tail never ends
+        if (tail == UINT32_MAX) return false;
+        tailFramesLeft = tail;
+      }
+      tailFramesLeft -= frameCount;
+      if (tailFramesLeft > 0) return false;
+      tailFramesLeft = -1;
+      return true;
+    }
+    default:
+      return false;
   }
 }
 
@@ -294,73 +540,153 @@ bool StandaloneHost::unregister_timer(clap_id timer_id)
 }
 #endif
 
-static int64_t clapwrite(const clap_ostream *s, const void *buffer, uint64_t size)
+StandaloneSettings StandaloneHost::currentStandaloneSettings()
 {
-  auto ofs = static_cast<std::ofstream *>(s->ctx);
-  ofs->write((const char *)buffer, size);
-  return size;
+  StandaloneSettings res;
+
+  if (useNullAudio || nullAudioFallback)
+  {
+    // the null backend has no devices to remember, the ones from before stay
+    res = savedAudioSettings;
+  }
+  else if (rtaDac)
+  {
+    res.hasAudio = true;
+    res.audioApi = audioApiName;
+    res.audioInputUsed = audioInputUsed;
+    res.audioOutputUsed = audioOutputUsed;
+    // device ids are not stable across runs, so the names go into the file
+    auto in = audioInputUsed ? audioDevice(audioInputDeviceID) : std::nullopt;
+    auto out = audioOutputUsed ? audioDevice(audioOutputDeviceID) : std::nullopt;
+    if (in) res.audioInputDevice = in->name;
+    if (out) res.audioOutputDevice = out->name;
+    res.sampleRate = currentSampleRate;
+    res.bufferSize = requestedBufferSize > 0 ? requestedBufferSize : currentBufferSize;
+    res.inputRoutes = inputRoutes;
+    res.outputRoutes = outputRoutes;
+  }
+
+  midiInputPorts();
+  res.hasMidi = deviceCatalogue.midiAvailable;
+  if (res.hasMidi)
+  {
+    // the selection as it was made, with inputs which are not plugged in right now
+    res.midiInputsSelected = midiInputSelection.has_value();
+    if (res.midiInputsSelected) res.midiInputs = *midiInputSelection;
+    res.midiOutputs = midiOutputSelection;
+  }
+  return res;
 }
 
-static int64_t clapread(const struct clap_istream *s, void *buffer, uint64_t size)
+void StandaloneHost::applyStandaloneSettings(const StandaloneSettings &settings)
 {
-  auto ifs = static_cast<std::ifstream *>(s->ctx);
+  if (settings.hasMidi)
+  {
+    if (settings.midiInputsSelected)
+      midiInputSelection = settings.midiInputs;
+    else
+      midiInputSelection.reset();
+    midiOutputSelection = settings.midiOutputs;
+  }
 
-  // Oh this API is so terrible. I think this is right?
-  ifs->read(static_cast<char *>(buffer), size);
-  if (ifs->rdstate() == std::ios::goodbit || ifs->rdstate() == std::ios::eofbit) return ifs->gcount();
+  if (!settings.hasAudio) return;
+  savedAudioSettings = settings;
+  savedAudioSettings.hasMidi = false;
+  savedAudioSettings.midiInputs.clear();
+  savedAudioSettings.midiOutputs.clear();
+  if (startupAudioFromCommandLine)
+  {
+    LOGDETAIL("Audio devices given on the command line, ignoring the saved ones");
+    return;
+  }
 
-  if (ifs->rdstate() & std::ios::eofbit) return ifs->gcount();
+  bool wasRunning = isAudioRunning();
+  if (wasRunning) stopAudioThread();
 
-  return -1;
+  if (settings.audioApi != audioApiName)
+  {
+    auto api = RtAudio::getCompiledApiByName(settings.audioApi);
+    if (api != RtAudio::Api::UNSPECIFIED) setAudioApi(api);
+  }
+  guaranteeRtAudioDAC();
+
+  auto [defIn, defOut, defSr] = getDefaultAudioInOutSampleRate();
+  auto in = defIn, out = defOut;
+  for (auto &d : audioDevices())
+  {
+    if (d.name == settings.audioInputDevice) in = d.ID;
+    if (d.name == settings.audioOutputDevice) out = d.ID;
+  }
+  // startAudioThread treats device 0 as 'unused'
+  setStartupAudio(settings.audioInputUsed ? in : 0, settings.audioOutputUsed ? out : 0,
+                  settings.sampleRate > 0 ? settings.sampleRate : defSr);
+  if (settings.bufferSize > 0) requestedBufferSize = settings.bufferSize;
+  inputRoutes = settings.inputRoutes;
+  outputRoutes = settings.outputRoutes;
+
+  if (wasRunning) startAudioThread();
 }
 
 bool StandaloneHost::saveStandaloneAndPluginSettings(const fs::path &intoDir, const fs::path &withName)
 {
-  // This should obviously be a more robust file format. What we
-  // want is an envelope containing the standalone settings and then
-  // the streamed plugin data. What we have here is just the streamed
-  // plugin data with no settings space for audio port selection etc...
-
-  std::ofstream ofs(intoDir / withName, std::ios::out | std::ios::binary);
-  if (!ofs.is_open())
+  if (!clapPlugin || !clapPlugin->_ext._state)
   {
-    LOGINFO("[ERROR] Unable to open for writing '{}'", (intoDir / withName).u8string());
     return false;
   }
+
+  auto desc = clapPlugin->_plugin->desc;
+  return writeSettingsFile(intoDir / withName, currentStandaloneSettings(), desc->id,
+                           desc->version ? desc->version : "",
+                           [this](auto *cos) { return clapPlugin->save(cos); });
+}
+
+bool StandaloneHost::savePluginDefaultsIfChanged(const fs::path &intoDir, const fs::path &withName)
+{
   if (!clapPlugin || !clapPlugin->_ext._state)
   {
     return false;
   }
-  clap_ostream cos{};
-  cos.ctx = &ofs;
-  cos.write = clapwrite;
-  clapPlugin->_ext._state->save(clapPlugin->_plugin, &cos);
-  ofs.close();
 
-  return true;
+  // the defaults only change with the plugin, so keep the file of the same id and version
+  auto desc = clapPlugin->_plugin->desc;
+  std::string version = desc->version ? desc->version : "";
+  {
+    MappedSettingsFile existing;
+    if (existing.open(intoDir / withName) && !existing.isLegacy() &&
+        existing.pluginId() == desc->id && existing.pluginVersion() == version)
+    {
+      LOGDETAIL("Plugin defaults for {} {} are current", desc->id, version);
+      return true;
+    }
+  }
+
+  // no standalone section, resetting to the defaults only resets the plugin
+  return writeSettingsFile(intoDir / withName, StandaloneSettings(), desc->id, version,
+                           [this](auto *cos) { return clapPlugin->save(cos); });
 }
 
 bool StandaloneHost::tryLoadStandaloneAndPluginSettings(const fs::path &fromDir,
                                                         const fs::path &withName)
 {
-  // see comment above on this file format being not just the
-  // raw stream in the future
-  auto fsp = fromDir / withName;
-  std::ifstream ifs(fsp, std::ios::in | std::ios::binary);
-  if (!ifs.is_open())
+  if (!clapPlugin || !clapPlugin->_ext._state)
   {
     return false;
   }
-  if (!clapPlugin || !clapPlugin->_ext._state)
+
+  MappedSettingsFile file;
+  if (!file.open(fromDir / withName))
   {
     return false;
   }
-  clap_istream cis{};
-  cis.ctx = &ifs;
-  cis.read = clapread;
-  clapPlugin->_ext._state->load(clapPlugin->_plugin, &cis);
-  ifs.close();
-  return true;
+
+  if (!file.isLegacy() && file.pluginId() != clapPlugin->_plugin->desc->id)
+  {
+    LOGINFO("[WARNING] Settings were saved by '{}', loading them into '{}'", file.pluginId(),
+            clapPlugin->_plugin->desc->id);
+  }
+
+  applyStandaloneSettings(file.standaloneSettings());
+  return clapPlugin->load(file.pluginState());
 }
 
 void StandaloneHost::activatePlugin(int32_t sr, int32_t minBlock, int32_t maxBlock)
@@ -378,8 +704,95 @@ void StandaloneHost::activatePlugin(int32_t sr, int32_t minBlock, int32_t maxBlo
   clapPlugin->activate();
 
   clapPlugin->start_processing();
+  noteActivation(sr, minBlock, maxBlock);
+}
+
+void StandaloneHost::noteActivation(int32_t sr, int32_t minBlock, int32_t maxBlock)
+{
+  if (realtimeOptions.prefault) warmupBlocksLeft = prefaultBlocks;
 
+  activeSampleRate = sr;
+  activeMinBlock = (uint32_t)minBlock;
+  activeMaxBlock = (uint32_t)maxBlock;
+  pluginSleeping = false;
+  tailFramesLeft = -1;
   isActive = true;
 }
 
+void StandaloneHost::activatePluginFor(int32_t sr, int32_t minBlock, int32_t maxBlock)
+{
+  // larger blocks would be processed in sub-blocks, but are worth a reactivation to get them
+  // to the plugin whole
+  if (isActive && sr == activeSampleRate && (uint32_t)minBlock >= activeMinBlock &&
+      (uint32_t)maxBlock <= activeMaxBlock)
+  {
+    LOGINFO("Keeping the plugin active : sampleRate={} blockBounds={} to {}", sr, activeMinBlock,
+            activeMaxBlock);
+    pluginSleeping = false;
+    tailFramesLeft = -1;
+    return;
+  }
+  activatePlugin(sr, minBlock, maxBlock);
+}
+
+std::shared_ptr<Clap::Plugin> StandaloneHost::prepareReplacementPlugin(int32_t sr, int32_t minBlock,
+                                                                       int32_t maxBlock)
+{
+  if (!pluginFactory || !clapPlugin || !clapPlugin->_plugin) return nullptr;
+  if (clapPlugin->_ext._gui && !onPluginReplaced)
+  {
+    LOGDETAIL("No UI to move the editor to a second instance, reactivating for {}Hz", sr);
+    return nullptr;
+  }
+
+  LOGINFO("Preparing a second instance : sampleRate={} blockBounds={} to {}", sr, minBlock, maxBlock);
+  auto next = Clap::Plugin::createInstance(pluginFactory, clapPlugin->_plugin->desc->id, this);
+  if (!next || !next->_plugin)
+  {
+    LOGINFO("[WARNING] Unable to create a second instance, reactivating instead");
+    return nullptr;
+  }
+
+  if (clapPlugin->_ext._state)
+  {
+    Clap::StateMemento state;
+    if (!clapPlugin->save(state) || !next->load(state))
+    {
+      LOGINFO("[WARNING] The state did not carry over to a second instance, reactivating instead");
+      return nullptr;
+    }
+  }
+
+  next->setSampleRate(sr);
+  next->setBlockSizes(minBlock, maxBlock);
+  if (!next->activate())
+  {
+    LOGINFO("[WARNING] The second instance did not activate, reactivating instead");
+    return nullptr;
+  }
+  next->start_processing();
+  return next;
+}
+
+std::shared_ptr<Clap::Plugin> StandaloneHost::switchToPlugin(std::shared_ptr<Clap::Plugin> next,
+                                                             int32_t sr, int32_t minBlock,
+                                                             int32_t maxBlock)
+{
+  LOGINFO("Switching to the second instance : sampleRate={}", sr);
+  auto previous = std::move(clapPlugin);
+  clapPlugin = std::move(next);
+  noteActivation(sr, minBlock, maxBlock);
+  return previous;
+}
+
+void StandaloneHost::retirePlugin(const std::shared_ptr<Clap::Plugin> &previous)
+{
+  // the editor moves over before the instance behind it goes
+  if (onPluginReplaced) onPluginReplaced(previous, clapPlugin);
+  previous->stop_processing();
+  previous->deactivate();
+  // the UI may have passed a callback the new instance asked for to the old one
+  callbackRequested = true;
+}
+
 }  // namespace freeaudio::clap_wrapper::standalone
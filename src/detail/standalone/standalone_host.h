@@ -1,14 +1,23 @@
 #pragma once
 
+#include <chrono>
 #include <cstring>
 #include <unordered_map>
 #include <unordered_set>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <optional>
 #include <tuple>
 
 #include "standalone_details.h"
+#include "standalone_settings.h"
+#include "standalone_routing.h"
+#include "standalone_midi_timing.h"
+#include "standalone_null_audio.h"
+#include "standalone_transport.h"
+#include "standalone_telemetry.h"
+#include "standalone_realtime.h"
 
 #include "detail/clap/fsutil.h"
 
@@ -25,7 +34,7 @@
 #endif
 
 #include "clap_proxy.h"
-#include "detail/shared/fixedqueue.h"
+#include "detail/shared/spscbytering.h"
 
 namespace freeaudio::clap_wrapper::standalone
 {
@@ -49,12 +58,16 @@ struct StandaloneHost : Clap::IHost
     inputEvents.get = ie_get;
     outputEvents.ctx = this;
     outputEvents.try_push = oe_try_push;
+    readEnvironment();
   }
   virtual ~StandaloneHost();
+  // the CLAP_WRAPPER_ audio and MIDI options, read once before the command line can override them
+  void readEnvironment();
 
   static bool oe_try_push(const struct clap_output_events *oe, const clap_event_header_t *evt)
   {
-    return true;
+    auto sh = (StandaloneHost *)oe->ctx;
+    return sh->pushOutputEvent(evt);
   }
 
   static uint32_t ie_getsize(const struct clap_input_events *ie)
@@ -74,9 +87,14 @@ struct StandaloneHost : Clap::IHost
   const unsigned char eventQueue[queueSize]{};
 
   int currInput{0};
+  // the slots of eventQueue by time, as plugins expect them
+  uint16_t eventOrder[maxEventsPerCycle]{};
+  // a callback processed in sub-blocks shows each sub-block only its part of eventOrder
+  uint32_t eventWindowStart{0}, eventWindowSize{0};
   void clearInputEvents()
   {
     currInput = 0;
+    eventWindowStart = eventWindowSize = 0;
   }
   bool pushInputEvent(clap_event_header_t *event)
   {
@@ -89,19 +107,34 @@ struct StandaloneHost : Clap::IHost
       return false;
     }
     memcpy((void *)(eventQueue + currInput * eventSize), (const void *)event, event->size);
+
+    // events mostly arrive in order, so this rarely moves anything
+    auto pos = currInput;
+    while (pos > 0 && queuedEvent(pos - 1)->time > event->time)
+    {
+      eventOrder[pos] = eventOrder[pos - 1];
+      pos--;
+    }
+    eventOrder[pos] = (uint16_t)currInput;
     currInput++;
     return true;
   }
   uint32_t inputEventSize()
   {
-    return currInput;
+    return eventWindowSize;
   }
   const clap_event_header_t *inputEvent(uint32_t idx)
   {
-    return (const clap_event_header_t *)(eventQueue + idx * eventSize);
+    return queuedEvent(eventWindowStart + idx);
+  }
+  clap_event_header_t *queuedEvent(uint32_t idx)
+  {
+    return (clap_event_header_t *)(eventQueue + eventOrder[idx] * eventSize);
   }
 
+  // the instance which plays. A sample rate change replaces it, see prepareReplacementPlugin.
   std::shared_ptr<Clap::Plugin> clapPlugin;
+  const clap_plugin_factory *pluginFactory{nullptr};
   void setPlugin(std::shared_ptr<Clap::Plugin> plugin)
   {
     this->clapPlugin = plugin;
@@ -125,8 +158,12 @@ struct StandaloneHost : Clap::IHost
     TRACE;
   }
 
+  // see standalone_settings.h for the file format
   bool saveStandaloneAndPluginSettings(const fs::path &intoDir, const fs::path &withName);
+  bool savePluginDefaultsIfChanged(const fs::path &intoDir, const fs::path &withName);
   bool tryLoadStandaloneAndPluginSettings(const fs::path &fromDir, const fs::path &withName);
+  StandaloneSettings currentStandaloneSettings();
+  void applyStandaloneSettings(const StandaloneSettings &settings);
 
   uint32_t numAudioInputs{0}, numAudioOutputs{0};
   std::vector<uint32_t> inputChannelByBus;
@@ -223,25 +260,131 @@ struct StandaloneHost : Clap::IHost
   }
 
   // Implementation in standalone_host_midi.cpp
-  struct midiChunk
+  /*
+   * Every input has its own queue, filled by the RtMidi thread of that port and emptied by
+   * the audio thread, which merges them by time. Messages carry the time they arrived, on
+   * midiClockNow(), and can be of any length, so SysEx gets through.
+   */
+  static constexpr uint32_t midiQueueSize{64 * 1024};
+  struct MidiInput
   {
-    char dat[3]{};
-    midiChunk()
-    {
-      memset(dat, 0, sizeof(dat));
-    }
+    StandaloneHost *host{nullptr};
+    uint32_t port{0};
+    int64_t lastEventNs{0};
+    ClapWrapper::detail::shared::spscbytering<midiQueueSize> queue;
+    std::unique_ptr<RtMidiIn> rtMidiIn;  // last, so it stops calling back first
   };
-  ClapWrapper::detail::shared::fixedqueue<midiChunk, 4096> midiToAudioQueue;
-  std::vector<std::unique_ptr<RtMidiIn>> midiIns;
+  std::vector<std::unique_ptr<MidiInput>> midiIns;
+  // what the audio thread sees of midiIns. Cleared before an input is closed.
+  static constexpr uint32_t maxMidiInputs{64};
+  std::atomic<MidiInput *> activeMidiInputs[maxMidiInputs]{};
+  std::atomic<bool> midiDrainActive{false};
+  std::atomic<uint64_t> midiDrainCount{0};
+  // set while releaseMIDIInputs waits on lifecycleChanged for the drain in flight to end
+  std::atomic<bool> midiReleaseWaiting{false};
   uint32_t numMidiPorts{0};
   std::vector<uint32_t> currentMidiPorts;
+  // by name for the settings, the port numbers shift when devices come and go
+  std::vector<std::string> currentMidiPortNames;
+  // the MIDI inputs to bind by name, as the user chose them. All inputs without a choice.
+  std::optional<std::vector<std::string>> midiInputSelection;
   void startMIDIThread();
   void stopMIDIThread();
-  void processMIDIEvents(double deltatime, std::vector<unsigned char> *message);
+  bool openMIDIInput(uint32_t port);
+  void closeMIDIInputs();
+  void releaseMIDIInputs();
+  void processMIDIEvents(MidiInput &input, double deltatime, std::vector<unsigned char> *message);
   static void midiCallback(double deltatime, std::vector<unsigned char> *message, void *userData);
 
+  // audio thread: moves at most maxEventsPerCycle events and sysexArenaSize bytes of SysEx
+  // into the input events, the rest waits for the next block
+  void drainMIDIInputs();
+  static constexpr uint32_t sysexArenaSize{64 * 1024};
+  uint8_t sysexArena[sysexArenaSize]{};
+  std::atomic<uint32_t> midiEventsDeferred{0};
+
+  /*
+   * MIDI output. The audio thread turns the note and MIDI events of the plugin into MIDI
+   * bytes, stamped with when their sample plays, and queues them. A sender thread passes them
+   * on to the outputs once their time comes. The outputs are the saved selection, or a
+   * virtual port named after the plugin where the MIDI API has them.
+   */
+  struct MidiOutput
+  {
+    std::string name;
+    bool isVirtual{false};
+    std::unique_ptr<RtMidiOut> rtMidiOut;
+  };
+  std::vector<std::unique_ptr<MidiOutput>> midiOuts;  // only touched with the sender stopped
+  std::vector<std::string> midiOutputSelection;
+  ClapWrapper::detail::shared::spscbytering<midiQueueSize> midiOutQueue;
+  std::atomic<bool> midiOutRunning{false};
+  std::thread midiOutThread;
+  void startMIDIOutput();
+  void stopMIDIOutput();
+  void midiOutputLoop();
+  bool pushOutputEvent(const clap_event_header_t *evt);
+
+  // audio thread only, see standalone_midi_timing.h
+  BlockClock midiBlockClock;
+  // CLAP_WRAPPER_MIDI_JITTER_STATS=1 or --midi-jitter-stats report them when MIDI stops
+  MidiJitterStats midiJitterStats;
+
+  // what process.transport says, see standalone_transport.h. MIDI clock reaches it while
+  // the inputs are drained and never the plugin.
+  TransportEngine transport;
+
+  /*
+   * A plugin which returned CLAP_PROCESS_SLEEP, or went quiet after CONTINUE_IF_NOT_QUIET or
+   * its TAIL, isn't called again until there is input above quietLevel, an event, a change of
+   * the transport play state or a request_process. The device plays silence meanwhile.
+   */
+  static constexpr float quietLevel{1e-6f};
+  bool pluginSleeping{false};
+  bool sleepAllowed{true};  // --bench turns it off so that process runs on every block
+  int64_t tailFramesLeft{-1};  // counting down once the input went quiet, -1 while it isn't
+  bool transportWasPlaying{false};
+  std::atomic<bool> processRequested{false};
+  std::atomic<uint64_t> sleptBlocks{0};
+  void request_process() override
+  {
+    processRequested = true;
+  }
+  bool pluginInputsQuiet(uint32_t frameCount) const;
+  bool pluginOutputsQuiet(uint32_t frameCount) const;
+  bool shouldSleep(clap_process_status status, bool activity, uint32_t frameCount);
+
   // in standalone_host.cpp
   void clapProcess(void *pOutput, const void *pInoput, uint32_t frameCount);
+  // frames of the callback from offset, frameCount frames long on the device
+  void processSubBlock(float *out, const float *in, uint32_t frameCount, uint32_t offset,
+                       uint32_t frames);
+  void silenceDevice(float *out, uint32_t frameCount, uint32_t offset, uint32_t frames);
+
+  /*
+   * Switching devices or sample rates stops one stream and starts another. The output fades
+   * out over fadeSeconds before the callback acknowledges the stop, and in again when the next
+   * stream starts, so a switch is a short stretch of silence rather than a click.
+   */
+  static constexpr double fadeSeconds{0.005};
+  float fadeGain{0.f};
+  std::atomic<bool> fadeOutRequested{false};
+  void applyFade(float *out, uint32_t frameCount);
+  // where the sub-block being processed starts in its callback, for the output event times
+  uint32_t subBlockOffset{0};
+
+  // which device channels go to which bus, see standalone_routing.h. Empty means the default.
+  std::vector<AudioRoute> inputRoutes, outputRoutes;
+  AudioRouting audioRouting;
+  std::vector<clap_audio_buffer> audioInputBuffers, audioOutputBuffers;
+  std::vector<float *> inputChannelPtrs, outputChannelPtrs;
+  // interleaved streams: where each device channel is split into and interleaved from
+  std::vector<float *> deviceInputPtrs;
+  std::vector<const float *> deviceOutputPtrs;
+  std::vector<uint32_t> usedDeviceInputs;
+  bool hasSilentInputs{false};
+  // called with the stream opened but not running
+  void setupAudioRouting(uint32_t deviceIns, uint32_t deviceOuts, bool nonInterleaved);
 
   // Actual audio IO In standalone_host_audio.cpp
   std::unique_ptr<RtAudio> rtaDac;
@@ -252,7 +395,20 @@ struct StandaloneHost : Clap::IHost
   unsigned int audioInputDeviceID{0}, audioOutputDeviceID{0};
   bool audioInputUsed{true}, audioOutputUsed{true};
   int32_t currentSampleRate{0};
+  // what the user asked for, 0 for the default. currentBufferSize is what the device granted
+  // and the plugin is activated with.
+  static constexpr uint32_t defaultBufferSize{256}, minBufferSize{16};
+  uint32_t requestedBufferSize{0};
   uint32_t currentBufferSize{0};
+  // callbacks larger than the plugin was activated for, processed in sub-blocks. The largest
+  // one becomes the maximum block size the next time the plugin is activated.
+  std::atomic<uint32_t> oversizedBlocks{0}, largestOversizedBlock{0};
+  // see standalone_telemetry.h. The JSON is written by mainFinish, if there is a path.
+  AudioTelemetry audioTelemetry;
+  std::vector<AudioTelemetry::Snapshot> telemetryStreams;  // the streams stopped so far
+  std::string telemetryJsonPath;
+  void writeTelemetryJson();
+  uint32_t telemetryLogSeconds{30};
   uint32_t currentInputChannels{0}, currentOutputChannels{0};
   void guaranteeRtAudioDAC();
   void setAudioApi(RtAudio::Api api);
@@ -261,9 +417,55 @@ struct StandaloneHost : Clap::IHost
   void startAudioThreadOn(unsigned int inputDeviceID, uint32_t inputChannels, bool useInput,
                           unsigned int outputDeviceID, uint32_t outputChannels, bool useOutput,
                           int32_t sampleRate);
+  // the part of startAudioThreadOn after the previous stream stopped, a missing side is nullptr
+  void openAudioStream(RtAudio::StreamParameters *oParams,
+                       const std::optional<RtAudio::DeviceInfo> &outInfo,
+                       RtAudio::StreamParameters *iParams,
+                       const std::optional<RtAudio::DeviceInfo> &inInfo, int32_t sampleRate,
+                       uint32_t requestFrames);
   void stopAudioThread();
+  bool isAudioRunning();
+
+  /*
+   * The null backend, see standalone_null_audio.h. Used when asked for with --null-audio or
+   * CLAP_WRAPPER_NULL_AUDIO=1, and when RtAudio finds no device at all. That fallback only
+   * lasts until the next stream starts, which uses a device plugged in meanwhile.
+   */
+  bool useNullAudio{false};
+  bool nullAudioFallback{false};
+  // the audio part of the settings applied last. The null backend has no devices to save, so
+  // these are saved instead of wiping the device setup.
+  StandaloneSettings savedAudioSettings;
+  NullAudioDriver::Config nullAudioConfig;
+  std::unique_ptr<NullAudioDriver> nullAudio;
+  void startNullAudio(int32_t sampleRate);
+
+  /*
+   * Realtime hardening, see standalone_realtime.h. The audio callbacks note their thread on
+   * the first call. prepareRealtime runs before a stream starts, hardenAudioThread after.
+   * With prefault, the first prefaultBlocks callbacks after the plugin was (re)activated warm
+   * it up on the audio thread. They take no MIDI, have no transport, send nothing and play
+   * silence, and the fade in only starts after them. A stream which keeps the plugin active
+   * doesn't warm it up again, that would move its state on.
+   */
+  RealtimeOptions realtimeOptions;
+  static constexpr uint32_t prefaultBlocks{8};
+  realtime::ThreadHandle audioThread;
+  std::atomic<bool> audioThreadKnown{false};
+  bool memoryLocked{false};
+  uint32_t warmupBlocksLeft{0};  // set by activatePlugin, counted down by the audio thread
+  bool warmingUp{false};         // audio thread only
+  void noteAudioThread()
+  {
+    if (audioThreadKnown.load(std::memory_order_relaxed)) return;
+    audioThread = realtime::currentThread();
+    audioThreadKnown.store(true, std::memory_order_release);
+    notifyLifecycle();
+  }
+  void prepareRealtime();
+  void hardenAudioThread();
 
-  bool startupAudioSet{false};
+  bool startupAudioSet{false}, startupAudioFromCommandLine{false};
   unsigned int startAudioIn{0}, startAudioOut{0};
   int startSampleRate{0};
   void setStartupAudio(unsigned int in, unsigned int out, int sr)
@@ -275,7 +477,57 @@ struct StandaloneHost : Clap::IHost
   }
 
   void activatePlugin(int32_t sr, int32_t minBlock, int32_t maxBlock);
+  // for a new stream: leaves the plugin active, with its state, where it can run the stream as
+  // it is, which spares heavy plugins their reallocation on a device change
+  void activatePluginFor(int32_t sr, int32_t minBlock, int32_t maxBlock);
+  void noteActivation(int32_t sr, int32_t minBlock, int32_t maxBlock);
   bool isActive{false};
+  int32_t activeSampleRate{0};
+  uint32_t activeMinBlock{0}, activeMaxBlock{0};
+
+  /*
+   * A new sample rate needs an activation, which heavy plugins take seconds over. So while the
+   * old stream still plays, a second instance is created from pluginFactory, given the state
+   * of the first and activated for the new rate. It takes over once the old stream faded out,
+   * and the first instance is retired once the new stream runs. onPluginReplaced(previous,
+   * current) is where the UI moves the editor over, a plugin with an editor and no UI to move
+   * it is reactivated instead. Whatever the old instance does between the state handover and
+   * the fade out doesn't carry over.
+   */
+  std::function<void(const std::shared_ptr<Clap::Plugin> &, const std::shared_ptr<Clap::Plugin> &)>
+      onPluginReplaced{nullptr};
+  // main thread, nullptr where the plugin has to be reactivated instead
+  std::shared_ptr<Clap::Plugin> prepareReplacementPlugin(int32_t sr, int32_t minBlock,
+                                                         int32_t maxBlock);
+  // with the stream stopped, returns the instance replaced
+  std::shared_ptr<Clap::Plugin> switchToPlugin(std::shared_ptr<Clap::Plugin> next, int32_t sr,
+                                               int32_t minBlock, int32_t maxBlock);
+  void retirePlugin(const std::shared_ptr<Clap::Plugin> &previous);
+
+  /*
+   * The audio and MIDI devices, probed once and kept. Asking a device about itself can mean
+   * opening it, which takes ALSA a good part of a second per device, and the settings UIs ask
+   * again and again. invalidateDevices() has them probed again on next use; the UIs call it on
+   * a hotplug notification or when their settings open, as does RtAudio losing a device.
+   */
+  struct DeviceCatalogue
+  {
+    bool audioProbed{false};
+    std::vector<RtAudio::DeviceInfo> audioDevices;
+    bool midiProbed{false}, midiAvailable{false};
+    std::vector<std::string> midiInputs;
+  };
+  DeviceCatalogue deviceCatalogue;
+  std::atomic<bool> devicesChanged{false};
+  void invalidateDevices()  // any thread
+  {
+    devicesChanged = true;
+  }
+  // main thread
+  const std::vector<RtAudio::DeviceInfo> &audioDevices();
+  std::optional<RtAudio::DeviceInfo> audioDevice(unsigned int id);
+  const std::vector<std::string> &midiInputPorts();
+  void refreshDevicesIfChanged();
 
   std::vector<RtAudio::Api> getCompiledApi();
   std::vector<RtAudio::DeviceInfo> getInputAudioDevices();
@@ -286,14 +538,42 @@ struct StandaloneHost : Clap::IHost
   clap_input_events inputEvents{};
   clap_output_events outputEvents{};
 
+  /*
+   * Handshakes between the audio callback and the threads starting and stopping it. The
+   * callback notifies lifecycleChanged once when it first runs and once when it sees running
+   * go false, so stopping or switching audio waits about a period, not a polling interval.
+   * It also notifies at the end of a MIDI drain while releaseMIDIInputs waits for one.
+   * Whoever holds the process up in mainWait is woken by requestShutdown(), which a SIGINT
+   * or SIGTERM (Ctrl-C on Windows) calls through entry.cpp.
+   */
   std::atomic<bool> running{true}, finishedRunning{false};
+  std::mutex lifecycleMutex;
+  std::condition_variable lifecycleChanged;
+  bool shutdownRequested{false};
+  void notifyLifecycle()  // any thread, the audio thread only on the occasions above
+  {
+    // taking the lock orders this against a waiter between its check and its wait
+    {
+      std::lock_guard<std::mutex> g(lifecycleMutex);
+    }
+    lifecycleChanged.notify_all();
+  }
+  // waits at most timeout for the audio callback to be seen, or to see the stop
+  bool waitForAudioThread(std::chrono::milliseconds timeout);
+  bool waitForAudioStopped(std::chrono::milliseconds timeout);
+  void requestShutdown();
+  void waitForShutdown();
 
   // We need to have play buffers for the clap. For now lets assume
-  // (1) the standalone is never more than 64 total ins and outs and
+  // (1) the standalone is never more than 62 total ins and outs and
   // (2) the block size is less that 4096 * 16 and
   // (3) memory in the standalone is pretty cheap
+  // The last two channels are silence for unconnected inputs and a sink for unused device inputs.
   static constexpr int utilityBufferSize{4096 * 16};
   static constexpr int utilityBufferMaxChannels{64};
-  float utilityBuffer[utilityBufferMaxChannels][utilityBufferSize]{};
+  static constexpr int utilityBufferZeroChannel{utilityBufferMaxChannels - 1};
+  static constexpr int utilityBufferDiscardChannel{utilityBufferMaxChannels - 2};
+  static constexpr int utilityBufferPluginChannels{utilityBufferMaxChannels - 2};
+  alignas(64) float utilityBuffer[utilityBufferMaxChannels][utilityBufferSize]{};
 };
 }  // namespace freeaudio::clap_wrapper::standalone
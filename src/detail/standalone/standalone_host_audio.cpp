@@ -16,17 +16,24 @@
 #include "standalone_host.h"
 #include "entry.h"
 
+#include <algorithm>
+#include <cstdlib>
+
 namespace freeaudio::clap_wrapper::standalone
 {
 int rtaCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
                 double /* streamTime */, RtAudioStreamStatus status, void *data)
 {
-  if (status)
-  {
-  }
   auto sh = (StandaloneHost *)data;
+  sh->noteAudioThread();
+  auto start = AudioTelemetry::now();
   sh->clapProcess(outputBuffer, inputBuffer, nBufferFrames);
 
+  uint8_t xruns = 0;
+  if (status & RTAUDIO_INPUT_OVERFLOW) xruns |= AudioTelemetry::INPUT_OVERFLOW;
+  if (status & RTAUDIO_OUTPUT_UNDERFLOW) xruns |= AudioTelemetry::OUTPUT_UNDERFLOW;
+  sh->audioTelemetry.callbackDone(start, nBufferFrames, xruns);
+
   return 0;
 }
 
@@ -35,6 +42,7 @@ void rtaErrorCallback(RtAudioErrorType errorType, const std::string &errorText)
   if (errorType != RTAUDIO_OUTPUT_UNDERFLOW && errorType != RTAUDIO_INPUT_OVERFLOW)
   {
     LOGINFO("[ERROR] RtAudio reports '{}' [{}]", errorText, (int)errorType);
+    if (errorType == RTAUDIO_DEVICE_DISCONNECT) getStandaloneHost()->invalidateDevices();
     auto ae = getStandaloneHost()->displayAudioError;
     if (ae)
     {
@@ -43,6 +51,8 @@ void rtaErrorCallback(RtAudioErrorType errorType, const std::string &errorText)
   }
   else
   {
+    // counted in the telemetry, so only the first makes it into the log
+    getStandaloneHost()->audioTelemetry.reportedXrun();
     static bool reported = false;
     if (!reported)
     {
@@ -52,6 +62,27 @@ void rtaErrorCallback(RtAudioErrorType errorType, const std::string &errorText)
   }
 }
 
+void StandaloneHost::readEnvironment()
+{
+  auto na = getenv("CLAP_WRAPPER_NULL_AUDIO");
+  if (na && na[0] && na[0] != '0') useNullAudio = true;
+  if (auto j = getenv("CLAP_WRAPPER_NULL_AUDIO_JITTER_US"))
+    nullAudioConfig.jitterUs = (uint32_t)std::strtoul(j, nullptr, 10);
+  if (auto l = getenv("CLAP_WRAPPER_NULL_AUDIO_LOG")) nullAudioConfig.marginLogPath = l;
+  if (auto t = getenv("CLAP_WRAPPER_TELEMETRY_JSON")) telemetryJsonPath = t;
+  if (auto t = getenv("CLAP_WRAPPER_TELEMETRY_LOG_SECONDS"))
+    telemetryLogSeconds = (uint32_t)std::strtoul(t, nullptr, 10);
+  auto js = getenv("CLAP_WRAPPER_MIDI_JITTER_STATS");
+  if (js && js[0] && js[0] != '0') midiJitterStats.enabled = true;
+  realtimeOptions.readEnvironment();
+}
+
+void StandaloneHost::writeTelemetryJson()
+{
+  if (telemetryJsonPath.empty()) return;
+  AudioTelemetry::writeJson(telemetryJsonPath, telemetryStreams);
+}
+
 void StandaloneHost::guaranteeRtAudioDAC()
 {
   if (!rtaDac)
@@ -64,6 +95,8 @@ void StandaloneHost::guaranteeRtAudioDAC()
 void StandaloneHost::setAudioApi(RtAudio::Api api)
 {
   rtaDac = std::make_unique<RtAudio>(api, &rtaErrorCallback);
+  deviceCatalogue.audioProbed = false;
+  deviceCatalogue.audioDevices.clear();
   audioApi = api;
   audioApiName = rtaDac->getApiName(api);
   audioApiDisplayName = rtaDac->getApiDisplayName(api);
@@ -75,42 +108,84 @@ std::tuple<unsigned int, unsigned int, int32_t> StandaloneHost::getDefaultAudioI
   guaranteeRtAudioDAC();
   auto iid = rtaDac->getDefaultInputDevice();
   auto oid = rtaDac->getDefaultOutputDevice();
-  auto outInfo = rtaDac->getDeviceInfo(oid);
-  auto sr = outInfo.currentSampleRate;
-  if (sr < 1)
+  auto outInfo = audioDevice(oid);
+  auto sr = outInfo ? outInfo->currentSampleRate : 0;
+  if (sr < 1 && outInfo)
   {
-    sr = outInfo.preferredSampleRate;
+    sr = outInfo->preferredSampleRate;
   }
 
   return {iid, oid, (int32_t)sr};
 }
+void nullAudioCallback(void *data, float *output, const float *input, uint32_t frames)
+{
+  auto sh = (StandaloneHost *)data;
+  sh->noteAudioThread();
+  auto start = AudioTelemetry::now();
+  sh->clapProcess(output, input, frames);
+  sh->audioTelemetry.callbackDone(start, frames, 0);
+}
+
 void StandaloneHost::startAudioThread()
 {
   guaranteeRtAudioDAC();
 
+  // open every channel of the devices, the routing decides what is used
+  auto allChannels = (uint32_t)utilityBufferMaxChannels;
   if (startupAudioSet)
   {
     auto in = startAudioIn;
     auto out = startAudioOut;
     auto sr = startSampleRate;
-    startAudioThreadOn(in, 2, in > 0 && numAudioInputs > 0, out, 2, out > 0 && numAudioOutputs > 0, sr);
+    startAudioThreadOn(in, allChannels, in > 0 && numAudioInputs > 0, out, allChannels,
+                       out > 0 && numAudioOutputs > 0, sr);
   }
   else
   {
     auto [in, out, sr] = getDefaultAudioInOutSampleRate();
-    startAudioThreadOn(in, 2, numAudioInputs > 0, out, 2, numAudioOutputs > 0, sr);
+    startAudioThreadOn(in, allChannels, numAudioInputs > 0, out, allChannels, numAudioOutputs > 0, sr);
   }
 }
 
-std::vector<RtAudio::DeviceInfo> filterDevicesBy(const std::unique_ptr<RtAudio> &rtaDac,
+void StandaloneHost::refreshDevicesIfChanged()
+{
+  if (!devicesChanged.exchange(false)) return;
+  LOGDETAIL("Devices changed, probing them again when next needed");
+  deviceCatalogue.audioProbed = false;
+  deviceCatalogue.midiProbed = false;
+}
+
+const std::vector<RtAudio::DeviceInfo> &StandaloneHost::audioDevices()
+{
+  guaranteeRtAudioDAC();
+  refreshDevicesIfChanged();
+
+  auto &c = deviceCatalogue;
+  if (!c.audioProbed)
+  {
+    c.audioDevices.clear();
+    for (auto d : rtaDac->getDeviceIds()) c.audioDevices.push_back(rtaDac->getDeviceInfo(d));
+    c.audioProbed = true;
+    LOGDETAIL("Found {} audio devices", c.audioDevices.size());
+  }
+  return c.audioDevices;
+}
+
+std::optional<RtAudio::DeviceInfo> StandaloneHost::audioDevice(unsigned int id)
+{
+  for (auto &d : audioDevices())
+  {
+    if (d.ID == id) return d;
+  }
+  return std::nullopt;
+}
+
+std::vector<RtAudio::DeviceInfo> filterDevicesBy(const std::vector<RtAudio::DeviceInfo> &devices,
                                                  std::function<bool(const RtAudio::DeviceInfo &)> f)
 {
   std::vector<RtAudio::DeviceInfo> res;
-  auto dids = rtaDac->getDeviceIds();
-  auto dnms = rtaDac->getDeviceNames();
-  for (auto d : dids)
+  for (auto &inf : devices)
   {
-    auto inf = rtaDac->getDeviceInfo(d);
     if (f(inf))
     {
       res.push_back(inf);
@@ -131,27 +206,24 @@ std::vector<RtAudio::Api> StandaloneHost::getCompiledApi()
 
 std::vector<RtAudio::DeviceInfo> StandaloneHost::getInputAudioDevices()
 {
-  guaranteeRtAudioDAC();
-  return filterDevicesBy(rtaDac, [](auto &a) { return a.inputChannels > 0; });
+  return filterDevicesBy(audioDevices(), [](auto &a) { return a.inputChannels > 0; });
 }
 
 std::vector<RtAudio::DeviceInfo> StandaloneHost::getOutputAudioDevices()
 {
-  guaranteeRtAudioDAC();
-  return filterDevicesBy(rtaDac, [](auto &a) { return a.outputChannels > 0; });
+  return filterDevicesBy(audioDevices(), [](auto &a) { return a.outputChannels > 0; });
 }
 
 std::vector<int32_t> StandaloneHost::getSampleRates()
 {
-  guaranteeRtAudioDAC();
-
   std::vector<int32_t> res;
 
-  auto samplesRates{rtaDac->getDeviceInfo(audioInputDeviceID).sampleRates};
-
-  for (auto &sampleRate : rtaDac->getDeviceInfo(audioInputDeviceID).sampleRates)
+  if (auto inf = audioDevice(audioInputDeviceID))
   {
-    res.push_back(sampleRate);
+    for (auto &sampleRate : inf->sampleRates)
+    {
+      res.push_back(sampleRate);
+    }
   }
 
   return res;
@@ -161,8 +233,9 @@ std::vector<uint32_t> StandaloneHost::getBufferSizes()
 {
   guaranteeRtAudioDAC();
 
-  std::vector<uint32_t> res{16,  32,  48,  64,  96,  128,  144,  160,
-                            192, 224, 256, 480, 512, 1024, 2048, 4096};
+  // the device may round these, startAudioThreadOn reports what it granted
+  std::vector<uint32_t> res{16,  32,  48,  64,  96,   128,  144,  160,  192,
+                            224, 256, 480, 512, 1024, 2048, 4096, 8192};
   return res;
 }
 
@@ -172,11 +245,15 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
 {
   guaranteeRtAudioDAC();
 
-  if (rtaDac->isStreamRunning())
+  nullAudioFallback = !useNullAudio && audioDevices().empty();
+  if (nullAudioFallback)
   {
-    stopAudioThread();
-    running = true;
-    finishedRunning = false;
+    LOGINFO("[WARNING] No audio devices found, running on the null audio backend");
+  }
+  if (useNullAudio || nullAudioFallback)
+  {
+    startNullAudio(reqSampleRate);
+    return;
   }
 
   audioInputDeviceID = inputDeviceID;
@@ -184,8 +261,21 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
   audioOutputDeviceID = outputDeviceID;
   audioOutputUsed = useOutput;
 
-  auto dids = rtaDac->getDeviceIds();
-  auto dnms = rtaDac->getDeviceNames();
+  // a device plugged in since the catalogue was probed is not in it yet
+  auto deviceInfo = [this](bool used, unsigned int id)
+  {
+    if (!used) return std::optional<RtAudio::DeviceInfo>();
+    if (!audioDevice(id)) invalidateDevices();
+    return audioDevice(id);
+  };
+  auto outInfo = deviceInfo(useOutput, outputDeviceID);
+  auto inInfo = deviceInfo(useInput, inputDeviceID);
+  if ((useOutput && !outInfo) || (useInput && !inInfo))
+  {
+    auto missing = useOutput && !outInfo ? outputDeviceID : inputDeviceID;
+    LOGINFO("[ERROR] Audio device {} is not available", missing);
+    return;
+  }
 
   RtAudio::StreamParameters oParams;
   int32_t sampleRate{reqSampleRate};
@@ -193,24 +283,23 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
   if (useOutput)
   {
     oParams.deviceId = outputDeviceID;
-    auto outInfo = rtaDac->getDeviceInfo(oParams.deviceId);
-    oParams.nChannels = std::min(outputChannels, outInfo.outputChannels);
+    oParams.nChannels = std::min(outputChannels, outInfo->outputChannels);
     oParams.firstChannel = 0;
     if (sampleRate < 0)
     {
-      sampleRate = outInfo.preferredSampleRate;
+      sampleRate = outInfo->preferredSampleRate;
     }
     else
     {
       // Mkae sure this sample rate is available
       bool isPossible{false};
-      for (auto sr : outInfo.sampleRates)
+      for (auto sr : outInfo->sampleRates)
       {
         isPossible = isPossible || ((int)sr == (int)sampleRate);
       }
       if (!isPossible)
       {
-        sampleRate = outInfo.preferredSampleRate;
+        sampleRate = outInfo->preferredSampleRate;
       }
     }
   }
@@ -219,10 +308,9 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
   if (useInput)
   {
     iParams.deviceId = inputDeviceID;
-    auto inInfo = rtaDac->getDeviceInfo(iParams.deviceId);
-    iParams.nChannels = std::min(inputChannels, inInfo.inputChannels);
+    iParams.nChannels = std::min(inputChannels, inInfo->inputChannels);
     iParams.firstChannel = 0;
-    if (sampleRate < 0) sampleRate = inInfo.preferredSampleRate;
+    if (sampleRate < 0) sampleRate = inInfo->preferredSampleRate;
   }
 
   if (sampleRate < 0)
@@ -231,52 +319,101 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
     sampleRate = 48000;
   }
 
-  currentSampleRate = sampleRate;
-
-  RtAudio::StreamOptions options;
-  options.flags = RTAUDIO_SCHEDULE_REALTIME;
-
   /*
    * RTAudio doesn't tell you what the possible frame sizes are but instead
-   * just tells you to try open stream with power of twos you want. So leave
-   * this for now at 256 and return to it shortly.
+   * just tells you to try open stream with the one you want, and changes it
+   * to what the device can do.
    */
-  LOGINFO("[WARNING] Hardcoding frame size to 256 samples for now");
+  auto requestFrames = requestedBufferSize > 0 ? requestedBufferSize : defaultBufferSize;
+  requestFrames = std::clamp(requestFrames, minBufferSize, (uint32_t)utilityBufferSize - 1);
+
+  // the block the device will grant isn't known before the stream opens, larger ones are
+  // processed in sub-blocks
+  std::shared_ptr<Clap::Plugin> replacement;
+  auto replacementMaxBlock = std::clamp(std::max(largestOversizedBlock.load(), requestFrames),
+                                        currentBufferSize, (uint32_t)utilityBufferSize - 1);
+  if (isAudioRunning() && isActive && sampleRate != activeSampleRate)
+    replacement = prepareReplacementPlugin(sampleRate, 1, (int32_t)replacementMaxBlock);
 
-  if (currentBufferSize == 0)
+  if (isAudioRunning()) stopAudioThread();
+
+  std::shared_ptr<Clap::Plugin> previous;
+  if (replacement)
+    previous = switchToPlugin(std::move(replacement), sampleRate, 1, (int32_t)replacementMaxBlock);
+
+  openAudioStream(useOutput ? &oParams : nullptr, outInfo, useInput ? &iParams : nullptr, inInfo,
+                  sampleRate, requestFrames);
+
+  // the previous instance only goes once the new one plays
+  if (previous) retirePlugin(previous);
+}
+
+void StandaloneHost::openAudioStream(RtAudio::StreamParameters *oParams,
+                                     const std::optional<RtAudio::DeviceInfo> &outInfo,
+                                     RtAudio::StreamParameters *iParams,
+                                     const std::optional<RtAudio::DeviceInfo> &inInfo,
+                                     int32_t sampleRate, uint32_t requestFrames)
+{
+  currentSampleRate = sampleRate;
+
+  // one block per channel lets the plugin render straight into the device buffers
+  RtAudio::StreamOptions options;
+  options.flags = RTAUDIO_SCHEDULE_REALTIME | RTAUDIO_NONINTERLEAVED;
+
+  auto openStream = [&]()
   {
-    currentBufferSize = 256;
+    currentBufferSize = requestFrames;
+    return rtaDac->openStream(oParams, iParams, RTAUDIO_FLOAT32, sampleRate, &currentBufferSize,
+                              &rtaCallback, (void *)this, &options);
+  };
+  if (openStream())
+  {
+    LOGINFO("[WARNING] Non interleaved stream failed '{}', trying interleaved", rtaDac->getErrorText());
+    rtaDac->closeStream();
+    options.flags &= ~RTAUDIO_NONINTERLEAVED;
+    if (openStream())
+    {
+      LOGINFO("[ERROR] Error opening rta stream '{}'", rtaDac->getErrorText());
+      rtaDac->closeStream();
+      // the device may have gone since it was probed
+      invalidateDevices();
+      return;
+    }
   }
 
-  if (rtaDac->openStream((useOutput) ? &oParams : nullptr, (useInput) ? &iParams : nullptr,
-                         RTAUDIO_FLOAT32, sampleRate, &currentBufferSize, &rtaCallback, (void *)this,
-                         &options))
+  if (currentBufferSize != requestFrames)
   {
-    LOGINFO("[ERROR] Error opening rta stream '{}'", rtaDac->getErrorText());
+    LOGINFO("Requested a buffer size of {}, the device granted {}", requestFrames, currentBufferSize);
+  }
+  if (currentBufferSize == 0 || currentBufferSize >= (uint32_t)utilityBufferSize)
+  {
+    LOGINFO("[ERROR] Buffer size {} is not supported", currentBufferSize);
     rtaDac->closeStream();
     return;
   }
 
-  activatePlugin(sampleRate, 1, currentBufferSize * 2);
+  currentInputChannels = iParams ? iParams->nChannels : 0;
+  currentOutputChannels = oParams ? oParams->nChannels : 0;
+  setupAudioRouting(currentInputChannels, currentOutputChannels,
+                    (options.flags & RTAUDIO_NONINTERLEAVED) != 0);
+
+  // a backend which sent larger callbacks than it granted last time will likely do so again.
+  // Any oversized callback is split into sub-blocks whose last one is shorter than the granted
+  // size, so the plugin is always activated with a minimum of 1 frame, as most hosts do.
+  auto maxBlock = std::clamp(largestOversizedBlock.load(), currentBufferSize,
+                             (uint32_t)utilityBufferSize - 1);
+  activatePluginFor(sampleRate, 1, (int32_t)maxBlock);
 
   LOGDETAIL("RtAudio Attached Devices");
-  if (useOutput)
+  if (oParams)
   {
-    for (auto i = 0U; i < dids.size(); ++i)
-    {
-      if (oParams.deviceId == dids[i]) LOGDETAIL("  - Output : '{}'", dnms[i]);
-    }
-    currentOutputChannels = oParams.nChannels;
-    LOGDETAIL("RtAudio Output Stream Channels {}", oParams.nChannels);
+    LOGDETAIL("  - Output : '{}'", outInfo->name);
+    LOGDETAIL("RtAudio Output Stream Channels {}", oParams->nChannels);
   }
-  if (useInput)
+  if (iParams)
   {
-    for (auto i = 0U; i < dids.size(); ++i)
-    {
-      if (iParams.deviceId == dids[i]) LOGDETAIL("  - Input : '{}'", dnms[i]);
-    }
-    currentInputChannels = iParams.nChannels;
-    LOGDETAIL("RtAudio Input Stream Channels {}", iParams.nChannels);
+    LOGDETAIL("  - Input : '{}'", inInfo->name);
+    LOGDETAIL("RtAudio Input Stream Channels {}", iParams->nChannels);
   }
 
   if (!rtaDac->isStreamOpen())
@@ -285,35 +422,200 @@ void StandaloneHost::startAudioThreadOn(unsigned int inputDeviceID, uint32_t inp
     return;
   }
 
+  prepareRealtime();
+  audioTelemetry.start(sampleRate, currentBufferSize, telemetryLogSeconds);
   if (rtaDac->startStream())
   {
     LOGINFO("[ERROR] startStream failed : {}", rtaDac->getErrorText());
     return;
   }
+  hardenAudioThread();
+}
+
+void StandaloneHost::startNullAudio(int32_t sampleRate)
+{
+  auto requestFrames = requestedBufferSize > 0 ? requestedBufferSize : defaultBufferSize;
+  auto newRate = sampleRate > 0 ? sampleRate : 48000;
+  auto blockSize = std::clamp(requestFrames, minBufferSize, (uint32_t)utilityBufferSize - 1);
+
+  std::shared_ptr<Clap::Plugin> replacement;
+  if (isAudioRunning() && isActive && newRate != activeSampleRate)
+    replacement = prepareReplacementPlugin(newRate, (int32_t)blockSize, (int32_t)blockSize);
+
+  if (isAudioRunning()) stopAudioThread();
+
+  std::shared_ptr<Clap::Plugin> previous;
+  if (replacement)
+    previous = switchToPlugin(std::move(replacement), newRate, (int32_t)blockSize, (int32_t)blockSize);
+
+  auto &c = nullAudioConfig;
+  c.sampleRate = newRate;
+  c.blockSize = blockSize;
+  c.inputChannels = numAudioInputs > 0 ? 2 : 0;
+  c.outputChannels = numAudioOutputs > 0 ? 2 : 0;
+
+  currentSampleRate = c.sampleRate;
+  currentBufferSize = c.blockSize;
+  currentInputChannels = c.inputChannels;
+  currentOutputChannels = c.outputChannels;
+  audioApiName = "null";
+  audioApiDisplayName = "Null Audio";
+  setupAudioRouting(currentInputChannels, currentOutputChannels, true);
+  activatePluginFor(c.sampleRate, (int32_t)c.blockSize, (int32_t)c.blockSize);
+
+  LOGINFO("Null audio: {} frames at {}Hz, jitter up to {}us", c.blockSize, c.sampleRate, c.jitterUs);
+  nullAudio = std::make_unique<NullAudioDriver>();
+  prepareRealtime();
+  audioTelemetry.start(c.sampleRate, c.blockSize, telemetryLogSeconds);
+  if (!nullAudio->start(c, &nullAudioCallback, this))
+    LOGINFO("[ERROR] Null audio failed to start");
+  else
+    hardenAudioThread();
+
+  // the previous instance only goes once the new one plays
+  if (previous) retirePlugin(previous);
+}
+
+void StandaloneHost::prepareRealtime()
+{
+  audioThreadKnown = false;
+  if (realtimeOptions.lockMemory && !memoryLocked)
+  {
+    std::string problem;
+    memoryLocked = realtime::lockMemory(problem);
+    if (memoryLocked)
+      LOGINFO("Realtime: process memory locked");
+    else
+      LOGINFO("[WARNING] Realtime: {}", problem);
+  }
+  if (!realtimeOptions.prefault) return;
+
+  auto frames = std::max(currentBufferSize, 1U);
+  for (auto &channel : utilityBuffer) realtime::prefault(channel, frames * sizeof(float));
+  realtime::prefault((void *)eventQueue, sizeof(eventQueue));
+  realtime::prefault(sysexArena, sizeof(sysexArena));
+  if (warmupBlocksLeft > 0)
+    LOGINFO("Realtime: host buffers prefaulted, the plugin warms up in the first {} blocks",
+            warmupBlocksLeft);
+  else
+    LOGINFO("Realtime: host buffers prefaulted");
+}
+
+void StandaloneHost::hardenAudioThread()
+{
+  const auto &o = realtimeOptions;
+  if (o.cpus.empty() && o.priority <= 0) return;
+
+  // the backend calls back within a period or two of starting
+  if (!waitForAudioThread(std::chrono::milliseconds(2000)))
+  {
+    LOGINFO("[WARNING] Realtime: the audio thread never called back, so it is left as it is");
+    return;
+  }
+
+  std::string problem;
+  if (!o.cpus.empty())
+  {
+    std::string cpus;
+    for (auto c : o.cpus) cpus += (cpus.empty() ? "" : ",") + std::to_string(c);
+    if (realtime::pinThread(audioThread, o.cpus, problem))
+      LOGINFO("Realtime: audio thread pinned to CPU {}", cpus);
+    else
+      LOGINFO("[WARNING] Realtime: {}", problem);
+  }
+  if (o.priority > 0)
+  {
+    if (realtime::setThreadPriority(audioThread, o.priority, problem))
+      LOGINFO("Realtime: audio thread priority set to {}", o.priority);
+    else
+      LOGINFO("[WARNING] Realtime: {}", problem);
+  }
+}
+
+bool StandaloneHost::waitForAudioThread(std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(lifecycleMutex);
+  auto known = [this]() { return audioThreadKnown.load(std::memory_order_acquire); };
+  return lifecycleChanged.wait_for(lock, timeout, known);
+}
+
+bool StandaloneHost::waitForAudioStopped(std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(lifecycleMutex);
+  return lifecycleChanged.wait_for(lock, timeout, [this]() { return finishedRunning.load(); });
+}
+
+void StandaloneHost::requestShutdown()
+{
+  {
+    std::lock_guard<std::mutex> g(lifecycleMutex);
+    shutdownRequested = true;
+  }
+  lifecycleChanged.notify_all();
+}
+
+void StandaloneHost::waitForShutdown()
+{
+  std::unique_lock<std::mutex> lock(lifecycleMutex);
+  lifecycleChanged.wait(lock, [this]() { return shutdownRequested; });
+}
+
+bool StandaloneHost::isAudioRunning()
+{
+  return (nullAudio && nullAudio->isRunning()) || (rtaDac && rtaDac->isStreamRunning());
 }
 
 void StandaloneHost::stopAudioThread()
 {
   LOGINFO("Shutting down audio");
-  if (!rtaDac->isStreamRunning())
+  if (!isAudioRunning())
   {
   }
   else
   {
-    running = false;
-
-    // bit of a hack. Wait until we get an ack from audio callback
-    for (auto i = 0; i < 10000 && !finishedRunning; ++i)
+    // the callback fades out and acknowledges once it is silent. One which never comes, from a
+    // device which went away, is given a few periods.
+    fadeOutRequested = true;
+    auto periodMs = currentSampleRate > 0 ? currentBufferSize * 1000 / (uint32_t)currentSampleRate : 0;
+    auto fadeMs = (uint32_t)(fadeSeconds * 1000) + 1;
+    if (!waitForAudioStopped(std::chrono::milliseconds(100 + 4 * periodMs + fadeMs)))
     {
-      using namespace std::chrono_literals;
-      std::this_thread::sleep_for(1ms);
+      LOGINFO("[WARNING] The audio callback did not acknowledge the stop, stopping the stream anyway");
     }
+    running = false;
 
     if (rtaDac && rtaDac->isStreamRunning())
     {
       rtaDac->stopStream();
       rtaDac->closeStream();
     }
+    if (nullAudio && nullAudio->isRunning())
+    {
+      nullAudio->stop();
+      LOGINFO("{}", nullAudio->report());
+    }
+
+    if (auto n = oversizedBlocks.exchange(0))
+    {
+      LOGINFO("[WARNING] {} callbacks, up to {} frames, were larger than the {} frames the plugin "
+              "was activated for and processed in sub-blocks",
+              n, largestOversizedBlock.load(), activeMaxBlock);
+    }
+    audioTelemetry.stop();
+    auto telemetry = audioTelemetry.snapshot();
+    LOGINFO("{}", AudioTelemetry::summary(telemetry));
+    if (telemetry.callbacks > 0) telemetryStreams.push_back(std::move(telemetry));
+
+    if (auto n = sleptBlocks.exchange(0))
+    {
+      LOGDETAIL("The plugin slept through {} blocks", n);
+    }
+
+    // ready for the stream started next, by a device or sample rate change, which fades in
+    fadeOutRequested = false;
+    fadeGain = 0.f;
+    running = true;
+    finishedRunning = false;
   }
   return;
 }
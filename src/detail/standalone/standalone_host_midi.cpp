@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
 #include "standalone_host.h"
 #include "standalone_details.h"
 
@@ -14,63 +19,435 @@
 
 namespace freeaudio::clap_wrapper::standalone
 {
+const std::vector<std::string> &StandaloneHost::midiInputPorts()
+{
+  refreshDevicesIfChanged();
+
+  auto &c = deviceCatalogue;
+  if (!c.midiProbed)
+  {
+    c.midiProbed = true;
+    c.midiInputs.clear();
+    try
+    {
+      RtMidiIn probe;
+      for (auto i = 0U; i < probe.getPortCount(); ++i) c.midiInputs.push_back(probe.getPortName(i));
+      c.midiAvailable = true;
+    }
+    catch (RtMidiError &error)
+    {
+      error.printMessage();
+      c.midiAvailable = false;
+    }
+  }
+  return c.midiInputs;
+}
+
 void StandaloneHost::startMIDIThread()
+{
+  LOGINFO("Initializing Midi");
+  const auto &ports = midiInputPorts();
+  if (!deviceCatalogue.midiAvailable) exit(EXIT_FAILURE);
+  numMidiPorts = (uint32_t)ports.size();
+
+  // the names come from the catalogue, only the ports which get bound are opened
+  LOGDETAIL("MIDI: There are {} MIDI input sources available. Binding {}.", numMidiPorts,
+            midiInputSelection.has_value() ? "the saved selection" : "all");
+  currentMidiPorts.clear();
+  currentMidiPortNames.clear();
+  for (unsigned int i = 0; i < numMidiPorts; i++)
+  {
+    if (midiInputSelection.has_value() &&
+        std::find(midiInputSelection->begin(), midiInputSelection->end(), ports[i]) ==
+            midiInputSelection->end())
+    {
+      continue;
+    }
+    openMIDIInput(i);
+  }
+
+  if (createsMidiOutput) startMIDIOutput();
+}
+
+bool StandaloneHost::openMIDIInput(uint32_t port)
 {
   try
   {
-    LOGINFO("Initializing Midi");
-    auto midiIn = std::make_unique<RtMidiIn>();
-    numMidiPorts = midiIn->getPortCount();
+    const auto &ports = midiInputPorts();
+    auto input = std::make_unique<MidiInput>();
+    input->host = this;
+    input->port = port;
+    auto name = port < ports.size() ? ports[port] : std::string();
+    input->rtMidiIn = std::make_unique<RtMidiIn>();
+    LOGDETAIL("  - '{}'", name);
+
+    std::atomic<MidiInput *> *slot{nullptr};
+    for (auto &s : activeMidiInputs)
+    {
+      if (!s.load())
+      {
+        slot = &s;
+        break;
+      }
+    }
+    if (!slot)
+    {
+      LOGINFO("[ERROR] MIDI: Only {} inputs can be open at once, not opening port {}", maxMidiInputs,
+              port);
+      return false;
+    }
+
+    input->rtMidiIn->openPort(port);
+    // SysEx goes through and timing goes to the transport, active sensing is dropped
+    input->rtMidiIn->ignoreTypes(false, false, true);
+    input->rtMidiIn->setCallback(midiCallback, input.get());
+    slot->store(input.get());
+    midiIns.push_back(std::move(input));
+    currentMidiPorts.push_back(port);
+    if (!name.empty()) currentMidiPortNames.push_back(name);
+    return true;
   }
   catch (RtMidiError &error)
   {
     error.printMessage();
-    exit(EXIT_FAILURE);
+  }
+  return false;
+}
+
+void StandaloneHost::closeMIDIInputs()
+{
+  releaseMIDIInputs();
+  currentMidiPorts.clear();
+  currentMidiPortNames.clear();
+}
+
+void StandaloneHost::releaseMIDIInputs()
+{
+  for (auto &s : activeMidiInputs) s.store(nullptr);
+
+  // a drain which started before the slots were cleared can still be reading the queues, and
+  // the inputs are only freed once it is over
+  {
+    std::unique_lock<std::mutex> lock(lifecycleMutex);
+    midiReleaseWaiting.store(true);
+    auto drains = midiDrainCount.load();
+    lifecycleChanged.wait(lock, [this, drains]()
+                          { return !midiDrainActive.load() || midiDrainCount.load() != drains; });
+    midiReleaseWaiting.store(false);
   }
 
-  LOGDETAIL("MIDI: There are {} MIDI input sources available. Binding all.", numMidiPorts);
-  for (unsigned int i = 0; i < numMidiPorts; i++)
+  for (auto &input : midiIns)
   {
-    try
+    auto dropped = input->queue.takeDropped();
+    if (dropped)
+      LOGINFO("[WARNING] MIDI: {} messages from port {} did not fit its queue", dropped, input->port);
+  }
+  auto deferred = midiEventsDeferred.exchange(0);
+  if (deferred) LOGINFO("MIDI: {} times there were more events than fit one block", deferred);
+  midiIns.clear();
+}
+
+void StandaloneHost::processMIDIEvents(MidiInput &input, double deltatime,
+                                       std::vector<unsigned char> *message)
+{
+  auto nBytes = message->size();
+
+  /*
+   * Some backends hand over messages in bursts, but still report the time between them.
+   * Follow that spacing while it stays close to when the messages really arrive.
+   */
+  static constexpr int64_t burstToleranceNs{2'000'000};
+  auto now = midiClockNow();
+  auto t = now;
+  if (input.lastEventNs > 0)
+  {
+    auto spaced = input.lastEventNs + (int64_t)(deltatime * 1e9);
+    if (spaced <= now && now - spaced < burstToleranceNs) t = spaced;
+  }
+  input.lastEventNs = t;
+
+  if (nBytes > 0) input.queue.push(t, message->data(), (uint32_t)nBytes);
+}
+
+void StandaloneHost::midiCallback(double deltatime, std::vector<unsigned char> *message, void *userData)
+{
+  auto input = (MidiInput *)userData;
+  input->host->processMIDIEvents(*input, deltatime, message);
+}
+
+void StandaloneHost::stopMIDIThread()
+{
+  // currentMidiPorts stays, it goes into the settings saved on the way out
+  releaseMIDIInputs();
+  stopMIDIOutput();
+
+  if (midiJitterStats.enabled)
+  {
+    LOGINFO("MIDI timing, events placed in the block : {}", midiJitterStats.placed.report());
+    LOGINFO("MIDI timing, all events at block start  : {}", midiJitterStats.blockStart.report());
+    midiJitterStats = MidiJitterStats();
+    midiJitterStats.enabled = true;
+  }
+}
+
+void StandaloneHost::drainMIDIInputs()
+{
+  midiDrainActive.store(true);
+
+  MidiInput *inputs[maxMidiInputs];
+  uint32_t n = 0;
+  for (auto &s : activeMidiInputs)
+  {
+    auto in = s.load();
+    if (in) inputs[n++] = in;
+  }
+
+  // the queues are each in time order, so taking the oldest head each time merges them
+  uint32_t arenaUsed = 0;
+  bool deferred = false;
+  while (true)
+  {
+    MidiInput *from{nullptr};
+    int64_t time{0};
+    const uint8_t *data{nullptr};
+    uint32_t size{0};
+    for (auto i = 0U; i < n; ++i)
     {
-      auto midiIn = std::make_unique<RtMidiIn>();
-      LOGDETAIL("  - '{}'", midiIn->getPortName(i));
-      midiIn->openPort(i);
-      midiIn->setCallback(midiCallback, this);
-      midiIns.push_back(std::move(midiIn));
+      int64_t t;
+      const uint8_t *d;
+      uint32_t sz;
+      if (inputs[i]->queue.peek(t, d, sz) && (!from || t < time))
+      {
+        from = inputs[i];
+        time = t;
+        data = d;
+        size = sz;
+      }
     }
-    catch (RtMidiError &error)
+    if (!from) break;
+    if (TransportEngine::isTransportMessage(data, size))
     {
-      error.printMessage();
+      transport.midiMessage(time, data, size);
+      from->queue.pop();
+      continue;
+    }
+    if (currInput >= maxEventsPerCycle)
+    {
+      deferred = true;
+      break;
+    }
+
+    auto offset = midiBlockClock.offsetFor(time);
+    if (data[0] == 0xF0)
+    {
+      if (arenaUsed + size > sysexArenaSize)
+      {
+        deferred = true;
+        break;
+      }
+      memcpy(sysexArena + arenaUsed, data, size);
+
+      clap_event_midi_sysex sysex;
+      sysex.header.size = sizeof(clap_event_midi_sysex);
+      sysex.header.time = offset;
+      sysex.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+      sysex.header.type = CLAP_EVENT_MIDI_SYSEX;
+      sysex.header.flags = 0;
+      sysex.port_index = 0;
+      sysex.buffer = sysexArena + arenaUsed;
+      sysex.size = size;
+      arenaUsed += size;
+      pushInputEvent(&(sysex.header));
     }
+    else if (size <= 3)
+    {
+      clap_event_midi midi;
+      midi.header.size = sizeof(clap_event_midi);
+      midi.header.time = offset;
+      midi.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+      midi.header.type = CLAP_EVENT_MIDI;
+      midi.header.flags = 0;
+      midi.port_index = 0;
+      memset(midi.data, 0, sizeof(midi.data));
+      memcpy(midi.data, data, size);
+      pushInputEvent(&(midi.header));
+    }
+    if (midiJitterStats.enabled) midiJitterStats.add(midiBlockClock, time, offset);
+    from->queue.pop();
   }
+
+  // whatever is left plays in the next block
+  if (deferred) midiEventsDeferred.fetch_add(1, std::memory_order_relaxed);
+
+  midiDrainCount.fetch_add(1);
+  midiDrainActive.store(false);
+  if (midiReleaseWaiting.load()) notifyLifecycle();
 }
 
-void StandaloneHost::processMIDIEvents(double deltatime, std::vector<unsigned char> *message)
+void StandaloneHost::startMIDIOutput()
 {
-  auto nBytes = message->size();
+  if (midiOutRunning) return;
 
-  if (nBytes <= 3)
+  try
   {
-    midiChunk ck;
-    memset(ck.dat, 0, sizeof(ck.dat));
-    memcpy(ck.dat, message->data(), nBytes);
-    midiToAudioQueue.push(ck);
+    if (midiOutputSelection.empty())
+    {
+      auto out = std::make_unique<MidiOutput>();
+      out->rtMidiOut = std::make_unique<RtMidiOut>();
+      out->name = std::string(clapPlugin->_plugin->desc->name) + " MIDI Out";
+      out->isVirtual = true;
+      out->rtMidiOut->openVirtualPort(out->name);
+      LOGDETAIL("MIDI: Sending the plugin MIDI output to virtual port '{}'", out->name);
+      midiOuts.push_back(std::move(out));
+    }
+    else
+    {
+      auto probe = std::make_unique<RtMidiOut>();
+      for (auto i = 0U; i < probe->getPortCount(); ++i)
+      {
+        auto name = probe->getPortName(i);
+        if (std::find(midiOutputSelection.begin(), midiOutputSelection.end(), name) ==
+            midiOutputSelection.end())
+        {
+          continue;
+        }
+        auto out = std::make_unique<MidiOutput>();
+        out->rtMidiOut = std::make_unique<RtMidiOut>();
+        out->name = name;
+        out->rtMidiOut->openPort(i);
+        LOGDETAIL("MIDI: Sending the plugin MIDI output to '{}'", name);
+        midiOuts.push_back(std::move(out));
+      }
+    }
   }
+  catch (RtMidiError &error)
+  {
+    // virtual ports are not available with every API, Windows MM has none
+    error.printMessage();
+  }
+
+  if (midiOuts.empty())
+  {
+    LOGINFO("[WARNING] MIDI: The plugin creates MIDI output, but there is no port to send it to");
+    return;
+  }
+
+  midiOutRunning = true;
+  midiOutThread = std::thread([this]() { midiOutputLoop(); });
 }
 
-void StandaloneHost::midiCallback(double deltatime, std::vector<unsigned char> *message, void *userData)
+void StandaloneHost::stopMIDIOutput()
 {
-  auto sh = (StandaloneHost *)userData;
-  sh->processMIDIEvents(deltatime, message);
+  if (midiOutRunning)
+  {
+    midiOutRunning = false;
+    midiOutThread.join();
+  }
+
+  auto dropped = midiOutQueue.takeDropped();
+  if (dropped) LOGINFO("[WARNING] MIDI: {} output messages did not fit the queue", dropped);
+  midiOuts.clear();
 }
 
-void StandaloneHost::stopMIDIThread()
+void StandaloneHost::midiOutputLoop()
+{
+  using namespace std::chrono_literals;
+  while (midiOutRunning)
+  {
+    int64_t time{0};
+    const uint8_t *data{nullptr};
+    uint32_t size{0};
+    bool pending = false;
+    while ((pending = midiOutQueue.peek(time, data, size)) && time <= midiClockNow())
+    {
+      for (auto &out : midiOuts)
+      {
+        try
+        {
+          out->rtMidiOut->sendMessage(data, size);
+        }
+        catch (RtMidiError &error)
+        {
+          error.printMessage();
+        }
+      }
+      midiOutQueue.pop();
+    }
+
+    auto wait = std::chrono::nanoseconds(1ms);
+    if (pending) wait = std::min(wait, std::chrono::nanoseconds(time - midiClockNow()));
+    if (wait.count() > 0) std::this_thread::sleep_for(wait);
+  }
+}
+
+namespace
 {
-  for (auto &m : midiIns)
+// the length of a channel or system common message from its status byte
+uint32_t midiMessageLength(uint8_t status)
+{
+  switch (status & 0xF0)
+  {
+    case 0xC0:
+    case 0xD0:
+      return 2;
+    case 0xF0:
+      break;
+    default:
+      return 3;
+  }
+  switch (status)
   {
-    m.reset();
+    case 0xF1:
+    case 0xF3:
+      return 2;
+    case 0xF2:
+      return 3;
+    default:
+      return 1;
+  }
+}
+}  // namespace
+
+bool StandaloneHost::pushOutputEvent(const clap_event_header_t *evt)
+{
+  if (!midiOutRunning || warmingUp || evt->space_id != CLAP_CORE_EVENT_SPACE_ID) return true;
+
+  auto time = midiBlockClock.timeOf(subBlockOffset + evt->time);
+  switch (evt->type)
+  {
+    case CLAP_EVENT_NOTE_ON:
+    case CLAP_EVENT_NOTE_OFF:
+    {
+      auto ev = (const clap_event_note *)evt;
+      if (ev->key < 0 || ev->key > 127) return true;
+      auto channel = (uint8_t)(ev->channel < 0 ? 0 : ev->channel & 0x0F);
+      auto velocity = (uint8_t)std::clamp((int)(ev->velocity * 127 + 0.5), 0, 127);
+      uint8_t msg[3]{(uint8_t)(0x80 | channel), (uint8_t)ev->key, velocity};
+      if (evt->type == CLAP_EVENT_NOTE_ON)
+      {
+        msg[0] |= 0x10;
+        // a note on with velocity 0 is a note off
+        if (msg[2] == 0) msg[2] = 1;
+      }
+      midiOutQueue.push(time, msg, 3);
+      break;
+    }
+    case CLAP_EVENT_MIDI:
+    {
+      auto ev = (const clap_event_midi *)evt;
+      if (ev->data[0] & 0x80) midiOutQueue.push(time, ev->data, midiMessageLength(ev->data[0]));
+      break;
+    }
+    case CLAP_EVENT_MIDI_SYSEX:
+    {
+      auto ev = (const clap_event_midi_sysex *)evt;
+      if (ev->buffer && ev->size) midiOutQueue.push(time, ev->buffer, ev->size);
+      break;
+    }
+    default:
+      break;
   }
+  return true;
 }
 
 }  // namespace freeaudio::clap_wrapper::standalone
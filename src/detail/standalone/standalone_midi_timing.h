@@ -0,0 +1,125 @@
+#pragma once
+
+/*
+ * Placing incoming MIDI inside the audio block.
+ *
+ * MIDI arrives on its own threads at any time while the audio callback only runs once per
+ * block. Everything the callback finds in the queue therefore arrived during the previous
+ * block period, and BlockClock maps that period onto the samples of the current block.
+ * Each event plays exactly one block after it arrived, instead of all of them landing on
+ * the first sample.
+ *
+ * Callbacks don't come exactly one period apart, so the period boundaries are a smoothed
+ * estimate: the expected start moves by the nominal block length and is pulled a little
+ * towards the measured one. A stall or a change of the block size resets it.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include "standalone_details.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+inline int64_t midiClockNow()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct BlockClock
+{
+  static constexpr double smoothing{1.0 / 16.0};
+
+  // call at the start of every audio block, before placing events
+  void startBlock(int64_t nowNs, uint32_t frameCount, double sampleRate)
+  {
+    auto periodNs = (double)frameCount * 1e9 / sampleRate;
+    if (!valid || frameCount != frames ||
+        std::fabs((double)(nowNs - periodEnd) - periodNs) > 2.0 * periodNs)
+    {
+      periodEnd = nowNs;
+      periodStart = nowNs - (int64_t)periodNs;
+      valid = true;
+    }
+    else
+    {
+      periodStart = periodEnd;
+      auto expected = (double)periodEnd + periodNs;
+      periodEnd = (int64_t)(expected + ((double)nowNs - expected) * smoothing);
+    }
+    frames = frameCount;
+  }
+
+  // the sample in this block for an event which arrived at eventNs
+  uint32_t offsetFor(int64_t eventNs) const
+  {
+    if (frames == 0 || eventNs <= periodStart) return 0;
+    auto span = std::max<int64_t>(1, periodEnd - periodStart);
+    auto pos = (int64_t)((double)(eventNs - periodStart) * frames / (double)span);
+    return (uint32_t)std::clamp<int64_t>(pos, 0, frames - 1);
+  }
+
+  // when the sample at offset is heard, on the same clock
+  int64_t timeOf(uint32_t offset) const
+  {
+    auto span = periodEnd - periodStart;
+    return periodEnd + (frames ? span * offset / frames : 0);
+  }
+
+  bool valid{false};
+  uint32_t frames{0};
+  int64_t periodStart{0}, periodEnd{0};
+};
+
+/*
+ * The measurement mode: the time from an event arriving to it being played, for the
+ * placed events and for what placing every event at the start of the block would give.
+ * The spread (max - min) of these is the jitter. Filled on the audio thread, read once
+ * audio stopped.
+ */
+struct MidiJitterStats
+{
+  struct Accumulator
+  {
+    uint64_t count{0};
+    double sum{0}, sumSquares{0};
+    int64_t min{std::numeric_limits<int64_t>::max()}, max{std::numeric_limits<int64_t>::min()};
+
+    void add(int64_t v)
+    {
+      count++;
+      sum += (double)v;
+      sumSquares += (double)v * (double)v;
+      min = std::min(min, v);
+      max = std::max(max, v);
+    }
+    std::string report() const
+    {
+      if (count == 0) return "no events";
+      auto mean = sum / count;
+      auto sd = std::sqrt(std::max(0.0, sumSquares / count - mean * mean));
+      char buf[256];
+      snprintf(buf, sizeof(buf),
+               "latency mean %.3fms, stddev %.3fms, min %.3fms, max %.3fms, jitter %.3fms",
+               mean * 1e-6, sd * 1e-6, min * 1e-6, max * 1e-6, (double)(max - min) * 1e-6);
+      return buf;
+    }
+  };
+
+  bool enabled{false};
+  Accumulator placed, blockStart;
+
+  void add(const BlockClock &clock, int64_t arrivedNs, uint32_t offset)
+  {
+    placed.add(clock.timeOf(offset) - arrivedNs);
+    blockStart.add(clock.timeOf(0) - arrivedNs);
+  }
+};
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,173 @@
+#include "standalone_null_audio.h"
+#include "standalone_details.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <random>
+
+#if LIN || MAC
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if LIN
+#include <cerrno>
+#include <ctime>
+#endif
+#if WIN
+#include <windows.h>
+#endif
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace
+{
+int64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void sleepUntilNs(int64_t t)
+{
+#if LIN
+  // steady_clock is CLOCK_MONOTONIC on Linux, and this sleeps to an absolute time
+  timespec ts{(time_t)(t / 1'000'000'000), (long)(t % 1'000'000'000)};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+  {
+  }
+#else
+  std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(t)));
+#endif
+}
+
+bool raiseToRealtime()
+{
+#if LIN || MAC
+  sched_param param{};
+  param.sched_priority =
+      std::max(sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO) - 10);
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#elif WIN
+  return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+  return false;
+#endif
+}
+}  // namespace
+
+NullAudioDriver::~NullAudioDriver()
+{
+  stop();
+}
+
+bool NullAudioDriver::start(const Config &config, Callback cb, void *data)
+{
+  if (runFlag || !cb || config.sampleRate <= 0 || config.blockSize == 0) return false;
+
+  cfg = config;
+  callback = cb;
+  callbackData = data;
+  inputBuffer.assign((size_t)cfg.inputChannels * cfg.blockSize, 0.f);
+  outputBuffer.assign((size_t)cfg.outputChannels * cfg.blockSize, 0.f);
+
+  callbacks = missed = resyncs = 0;
+  minMargin = std::numeric_limits<int64_t>::max();
+  maxMargin = std::numeric_limits<int64_t>::min();
+  sumMargin = 0;
+  recent.assign(marginHistory, 0);
+
+  runFlag = true;
+  thread = std::thread([this]() { run(); });
+  return true;
+}
+
+void NullAudioDriver::stop()
+{
+  if (!runFlag) return;
+  runFlag = false;
+  thread.join();
+
+  if (cfg.marginLogPath.empty()) return;
+  std::ofstream log(cfg.marginLogPath);
+  for (auto m : margins()) log << m << "\n";
+  if (!log) LOGINFO("[ERROR] Null audio: can't write the margins to '{}'", cfg.marginLogPath);
+}
+
+int64_t NullAudioDriver::framesToNs(uint64_t frames) const
+{
+  // whole seconds and the rest apart, so this neither overflows nor accumulates rounding
+  auto sr = (uint64_t)cfg.sampleRate;
+  return (int64_t)((frames / sr) * 1'000'000'000ULL + (frames % sr) * 1'000'000'000ULL / sr);
+}
+
+void NullAudioDriver::run()
+{
+  realtime = raiseToRealtime();
+  if (!realtime) LOGINFO("[WARNING] Null audio: no realtime scheduling, running at normal priority");
+
+  std::mt19937 rng(cfg.seed);
+  std::uniform_int_distribution<int64_t> jitter(0, (int64_t)cfg.jitterUs * 1000);
+  auto period = framesToNs(cfg.blockSize);
+
+  auto start = nowNs() + period;
+  uint64_t frames = 0;
+  while (runFlag)
+  {
+    auto wake = start + framesToNs(frames);
+    if (cfg.jitterUs) wake += jitter(rng);
+    sleepUntilNs(wake);
+
+    callback(callbackData, outputBuffer.data(), inputBuffer.data(), cfg.blockSize);
+
+    frames += cfg.blockSize;
+    auto now = nowNs();
+    auto margin = start + framesToNs(frames) - now;
+
+    recent[callbacks % marginHistory] = margin;
+    callbacks++;
+    if (margin < 0) missed++;
+    minMargin = std::min(minMargin, margin);
+    maxMargin = std::max(maxMargin, margin);
+    sumMargin += (double)margin;
+
+    // a device would have dropped a buffer, so the schedule moves on rather than catching up
+    if (margin < -period)
+    {
+      start = now - framesToNs(frames);
+      resyncs++;
+    }
+  }
+}
+
+std::vector<int64_t> NullAudioDriver::margins() const
+{
+  std::vector<int64_t> res;
+  auto n = (uint32_t)std::min<uint64_t>(callbacks, marginHistory);
+  for (auto i = 0U; i < n; ++i) res.push_back(recent[(callbacks - n + i) % marginHistory]);
+  return res;
+}
+
+std::string NullAudioDriver::report() const
+{
+  char buf[512];
+  if (callbacks == 0) return "Null audio: no callbacks";
+
+  auto sorted = margins();
+  std::sort(sorted.begin(), sorted.end());
+  auto p1 = sorted[sorted.size() / 100];
+  auto median = sorted[sorted.size() / 2];
+  snprintf(buf, sizeof(buf),
+           "Null audio: %llu callbacks of %u frames at %dHz (period %.3fms, jitter up to %uus, %s). "
+           "Deadline margin min %.3fms, 1%% %.3fms, median %.3fms, mean %.3fms, max %.3fms. "
+           "%llu missed, %llu resyncs",
+           (unsigned long long)callbacks, cfg.blockSize, cfg.sampleRate,
+           framesToNs(cfg.blockSize) * 1e-6, cfg.jitterUs, realtime ? "realtime" : "normal priority",
+           minMargin * 1e-6, p1 * 1e-6, median * 1e-6, sumMargin / callbacks * 1e-6, maxMargin * 1e-6,
+           (unsigned long long)missed, (unsigned long long)resyncs);
+  return buf;
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * An audio backend without a device. A thread calls back one block at a time on the exact
+ * schedule a sound card at the given sample rate and buffer size would: block k is due at
+ * start + k * blockSize / sampleRate, computed in whole nanoseconds so nothing drifts.
+ *
+ * The thread asks for SCHED_FIFO (time critical on Windows) and carries on at normal
+ * priority if it doesn't get it. Each wake up can be delayed by a random amount up to
+ * jitterUs, from a fixed seed, to rehearse late scheduling reproducibly. For every callback
+ * the margin to its deadline, the time the next block is due, is recorded; a negative
+ * margin is a callback a real device would have glitched on.
+ *
+ * Inputs are silent and outputs are dropped. Both are non interleaved.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+class NullAudioDriver
+{
+ public:
+  struct Config
+  {
+    int32_t sampleRate{48000};
+    uint32_t blockSize{256};
+    uint32_t inputChannels{2}, outputChannels{2};
+    uint32_t jitterUs{0};
+    uint32_t seed{1};
+    // every recorded margin goes there on stop(), one per line in nanoseconds
+    std::string marginLogPath;
+  };
+  using Callback = void (*)(void *data, float *output, const float *input, uint32_t frames);
+
+  NullAudioDriver() = default;
+  ~NullAudioDriver();
+  NullAudioDriver(const NullAudioDriver &) = delete;
+  NullAudioDriver &operator=(const NullAudioDriver &) = delete;
+
+  bool start(const Config &config, Callback callback, void *data);
+  void stop();
+  bool isRunning() const
+  {
+    return runFlag;
+  }
+  const Config &config() const
+  {
+    return cfg;
+  }
+
+  // a summary of the margins of the last run, valid after stop()
+  std::string report() const;
+
+  // the margins of the most recent callbacks, oldest first, valid after stop()
+  std::vector<int64_t> margins() const;
+  static constexpr uint32_t marginHistory{1 << 16};
+
+ private:
+  void run();
+  int64_t framesToNs(uint64_t frames) const;
+
+  Config cfg;
+  Callback callback{nullptr};
+  void *callbackData{nullptr};
+  std::vector<float> inputBuffer, outputBuffer;
+
+  std::thread thread;
+  std::atomic<bool> runFlag{false};
+  bool realtime{false};
+
+  // written by the audio thread only, read once it has stopped
+  uint64_t callbacks{0}, missed{0}, resyncs{0};
+  int64_t minMargin{0}, maxMargin{0};
+  double sumMargin{0};
+  std::vector<int64_t> recent;
+};
+}  // namespace freeaudio::clap_wrapper::standalone
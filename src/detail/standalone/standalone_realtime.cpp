@@ -0,0 +1,159 @@
+#include "standalone_realtime.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#if LIN || MAC
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if WIN
+#include <windows.h>
+#endif
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace
+{
+bool envFlag(const char *name)
+{
+  auto v = getenv(name);
+  return v && v[0] && v[0] != '0';
+}
+}  // namespace
+
+void RealtimeOptions::readEnvironment()
+{
+  if (envFlag("CLAP_WRAPPER_RT_LOCK_MEMORY")) lockMemory = true;
+  if (envFlag("CLAP_WRAPPER_RT_PREFAULT")) prefault = true;
+  if (auto c = getenv("CLAP_WRAPPER_RT_CPUS")) parseCpuList(c, cpus);
+  if (auto p = getenv("CLAP_WRAPPER_RT_PRIORITY")) priority = std::clamp(atoi(p), 0, 99);
+}
+
+bool parseCpuList(const std::string &s, std::vector<uint32_t> &cpus)
+{
+  std::vector<uint32_t> res;
+  std::istringstream iss(s);
+  std::string item;
+  while (std::getline(iss, item, ','))
+  {
+    unsigned int from{0}, to{0};
+    char dash{0};
+    std::istringstream is(item);
+    if (!(is >> from)) return false;
+    to = from;
+    if (is >> dash && (dash != '-' || !(is >> to) || to < from)) return false;
+    for (auto c = from; c <= to && c < 1024; ++c) res.push_back(c);
+  }
+  if (res.empty()) return false;
+  cpus = res;
+  return true;
+}
+
+namespace realtime
+{
+ThreadHandle currentThread()
+{
+  ThreadHandle h;
+  h.valid = true;
+#if LIN || MAC
+  h.thread = pthread_self();
+#elif WIN
+  h.threadId = GetCurrentThreadId();
+#endif
+  return h;
+}
+
+bool lockMemory(std::string &problem)
+{
+#if LIN
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) return true;
+  problem = std::string("mlockall failed: ") + strerror(errno) +
+            ". Raise the locked memory limit (ulimit -l, memlock in /etc/security/limits.d) or grant "
+            "CAP_IPC_LOCK";
+  return false;
+#else
+  problem = "locking the process memory is only supported on Linux";
+  return false;
+#endif
+}
+
+bool pinThread(const ThreadHandle &thread, const std::vector<uint32_t> &cpus, std::string &problem)
+{
+  if (!thread.valid || cpus.empty()) return false;
+#if LIN
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto c : cpus)
+  {
+    if (c < CPU_SETSIZE) CPU_SET(c, &set);
+  }
+  auto res = pthread_setaffinity_np(thread.thread, sizeof(set), &set);
+  if (res == 0) return true;
+  problem = std::string("pinning the audio thread failed: ") + strerror(res) +
+            (res == EINVAL ? ". None of the CPUs is available to the process" : "");
+  return false;
+#elif WIN
+  DWORD_PTR mask{0};
+  for (auto c : cpus)
+  {
+    if (c < sizeof(mask) * 8) mask |= (DWORD_PTR)1 << c;
+  }
+  auto h = OpenThread(THREAD_SET_INFORMATION | THREAD_QUERY_INFORMATION, FALSE, thread.threadId);
+  auto ok = h && SetThreadAffinityMask(h, mask) != 0;
+  if (!ok) problem = "pinning the audio thread failed, error " + std::to_string(GetLastError());
+  if (h) CloseHandle(h);
+  return ok;
+#else
+  problem = "macOS doesn't let threads be pinned to CPUs";
+  return false;
+#endif
+}
+
+bool setThreadPriority(const ThreadHandle &thread, int priority, std::string &problem)
+{
+  if (!thread.valid || priority <= 0) return false;
+#if LIN || MAC
+  sched_param param{};
+  param.sched_priority = std::clamp(priority, sched_get_priority_min(SCHED_FIFO),
+                                    sched_get_priority_max(SCHED_FIFO));
+  auto res = pthread_setschedparam(thread.thread, SCHED_FIFO, &param);
+  if (res == 0) return true;
+  problem = std::string("setting SCHED_FIFO priority ") + std::to_string(param.sched_priority) +
+            " failed: " + strerror(res);
+#if LIN
+  if (res == EPERM)
+    problem += ". Raise the realtime priority limit (ulimit -r, rtprio in /etc/security/limits.d, "
+               "usually by joining the audio group) or grant CAP_SYS_NICE";
+#endif
+  return false;
+#elif WIN
+  auto h = OpenThread(THREAD_SET_INFORMATION | THREAD_QUERY_INFORMATION, FALSE, thread.threadId);
+  auto ok = h && SetThreadPriority(h, THREAD_PRIORITY_TIME_CRITICAL) != 0;
+  if (!ok) problem = "setting the thread priority failed, error " + std::to_string(GetLastError());
+  if (h) CloseHandle(h);
+  return ok;
+#else
+  return false;
+#endif
+}
+
+void prefault(void *data, size_t bytes)
+{
+  if (!data || bytes == 0) return;
+#if LIN || MAC
+  static const auto page = (size_t)std::max(4096L, sysconf(_SC_PAGESIZE));
+#else
+  static const size_t page = 4096;
+#endif
+  // volatile, so the writes of what is already there are not optimised away
+  auto p = (volatile char *)data;
+  for (size_t i = 0; i < bytes; i += page) p[i] = p[i];
+  p[bytes - 1] = p[bytes - 1];
+}
+}  // namespace realtime
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+ * Opt-in hardening of the audio thread, for rigs where a page fault or a migration to a busy
+ * core on the first note is already too much:
+ *
+ *   - lockMemory keeps every page of the process in RAM (mlockall on Linux)
+ *   - prefault writes to the host buffers before the stream starts, and runs a freshly
+ *     activated plugin for a few silent callbacks before the fade in, so neither takes its
+ *     first page faults while it is heard
+ *   - cpus pins the audio thread to those CPUs
+ *   - priority sets its realtime priority instead of leaving it to the audio backend
+ *
+ * The audio thread belongs to the backend, so it is only known once it calls back. The host
+ * notes it then and applies the rest from the main thread. Whatever can't be applied,
+ * mostly for lack of permissions, is logged with what to change.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if LIN || MAC
+#include <pthread.h>
+#endif
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct RealtimeOptions
+{
+  bool lockMemory{false};
+  bool prefault{false};
+  // empty leaves the thread wherever the scheduler puts it
+  std::vector<uint32_t> cpus;
+  // a SCHED_FIFO priority from 1 to 99, 0 keeps what the backend chose. On Windows any
+  // priority means time critical.
+  int priority{0};
+
+  bool any() const
+  {
+    return lockMemory || prefault || !cpus.empty() || priority > 0;
+  }
+  // CLAP_WRAPPER_RT_LOCK_MEMORY=1, CLAP_WRAPPER_RT_PREFAULT=1, CLAP_WRAPPER_RT_CPUS=2,3 and
+  // CLAP_WRAPPER_RT_PRIORITY=80
+  void readEnvironment();
+};
+
+// "2,3" or "2-5,7"
+bool parseCpuList(const std::string &s, std::vector<uint32_t> &cpus);
+
+namespace realtime
+{
+struct ThreadHandle
+{
+  bool valid{false};
+#if LIN || MAC
+  pthread_t thread{};
+#elif WIN
+  unsigned long threadId{0};
+#endif
+};
+ThreadHandle currentThread();
+
+// each returns false with what went wrong and how to fix it in problem
+bool lockMemory(std::string &problem);
+bool pinThread(const ThreadHandle &thread, const std::vector<uint32_t> &cpus, std::string &problem);
+bool setThreadPriority(const ThreadHandle &thread, int priority, std::string &problem);
+
+// writes to every page of the range
+void prefault(void *data, size_t bytes);
+}  // namespace realtime
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,1149 @@
+#include "standalone_render.h"
+#include "standalone_details.h"
+#include "standalone_settings.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "clap_proxy.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace render
+{
+namespace
+{
+bool readAll(const std::string &path, std::vector<uint8_t> &data)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return !in.bad();
+}
+
+uint16_t le16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+uint32_t le32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+uint64_t le64(const uint8_t *p)
+{
+  return (uint64_t)le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+uint16_t be16(const uint8_t *p)
+{
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+uint32_t be32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+void put16(std::vector<uint8_t> &d, uint16_t v)
+{
+  d.push_back(v & 0xFF);
+  d.push_back(v >> 8);
+}
+void put32(std::vector<uint8_t> &d, uint32_t v)
+{
+  for (int i = 0; i < 4; ++i) d.push_back((v >> (8 * i)) & 0xFF);
+}
+void putTag(std::vector<uint8_t> &d, const char *tag)
+{
+  d.insert(d.end(), tag, tag + 4);
+}
+}  // namespace
+
+bool readWav(const std::string &path, AudioFile &file, std::string &error)
+{
+  std::vector<uint8_t> d;
+  if (!readAll(path, d))
+  {
+    error = "Can't read '" + path + "'";
+    return false;
+  }
+  if (d.size() < 12 || memcmp(d.data(), "RIFF", 4) || memcmp(d.data() + 8, "WAVE", 4))
+  {
+    error = "'" + path + "' is not a WAV file";
+    return false;
+  }
+
+  uint16_t format{0}, channels{0}, bits{0};
+  uint32_t rate{0};
+  const uint8_t *data{nullptr};
+  uint64_t dataSize{0};
+  size_t pos = 12;
+  while (pos + 8 <= d.size())
+  {
+    auto chunk = d.data() + pos;
+    uint64_t size = le32(chunk + 4);
+    auto body = pos + 8;
+    // a truncated file keeps what is there
+    if (body + size > d.size()) size = d.size() - body;
+    if (!memcmp(chunk, "fmt ", 4) && size >= 16)
+    {
+      format = le16(chunk + 8);
+      channels = le16(chunk + 10);
+      rate = le32(chunk + 12);
+      bits = le16(chunk + 22);
+      // WAVE_FORMAT_EXTENSIBLE has the real format at the start of the sub format GUID
+      if (format == 0xFFFE && size >= 26) format = le16(chunk + 32);
+    }
+    else if (!memcmp(chunk, "data", 4))
+    {
+      data = d.data() + body;
+      dataSize = size;
+    }
+    pos = body + size + (size & 1);
+  }
+
+  bool pcm = format == 1 && (bits == 16 || bits == 24 || bits == 32);
+  bool flt = format == 3 && (bits == 32 || bits == 64);
+  if (!data || channels == 0 || rate == 0 || (!pcm && !flt))
+  {
+    error = "'" + path + "' has no audio in a supported format (" + std::to_string(bits) +
+            " bit, format " + std::to_string(format) + ")";
+    return false;
+  }
+
+  auto bytes = bits / 8U;
+  auto frames = dataSize / (bytes * channels);
+  file.sampleRate = (int32_t)rate;
+  file.channels.assign(channels, std::vector<float>(frames));
+  for (uint64_t f = 0; f < frames; ++f)
+  {
+    for (auto c = 0U; c < channels; ++c)
+    {
+      auto p = data + (f * channels + c) * bytes;
+      float v{0};
+      if (pcm && bits == 16)
+        v = (float)(int16_t)le16(p) / 32768.f;
+      else if (pcm && bits == 24)
+      {
+        // into the top of an int32, so the shift back extends the sign
+        auto u = ((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24);
+        v = (float)((int32_t)u >> 8) / 8388608.f;
+      }
+      else if (pcm)
+        v = (float)((double)(int32_t)le32(p) / 2147483648.0);
+      else if (bits == 32)
+      {
+        auto u = le32(p);
+        memcpy(&v, &u, sizeof(v));
+      }
+      else
+      {
+        auto u = le64(p);
+        double dv;
+        memcpy(&dv, &u, sizeof(dv));
+        v = (float)dv;
+      }
+      file.channels[c][f] = v;
+    }
+  }
+  return true;
+}
+
+bool writeWav(const std::string &path, const AudioFile &file, std::string &error)
+{
+  auto channels = (uint32_t)file.channels.size();
+  auto frames = file.frames();
+  auto dataSize = frames * channels * 4;
+  if (channels == 0 || dataSize > 0xFFFFFF00ULL)
+  {
+    error = "Can't write " + std::to_string(channels) + " channels of " + std::to_string(frames) +
+            " frames to a WAV file";
+    return false;
+  }
+
+  std::vector<uint8_t> d;
+  d.reserve(58 + dataSize);
+  putTag(d, "RIFF");
+  put32(d, (uint32_t)(50 + dataSize));
+  putTag(d, "WAVE");
+  putTag(d, "fmt ");
+  put32(d, 18);
+  put16(d, 3);  // IEEE float
+  put16(d, (uint16_t)channels);
+  put32(d, (uint32_t)file.sampleRate);
+  put32(d, (uint32_t)file.sampleRate * channels * 4);
+  put16(d, (uint16_t)(channels * 4));
+  put16(d, 32);
+  put16(d, 0);
+  // non PCM formats carry the frame count in a fact chunk
+  putTag(d, "fact");
+  put32(d, 4);
+  put32(d, (uint32_t)frames);
+  putTag(d, "data");
+  put32(d, (uint32_t)dataSize);
+  for (uint64_t f = 0; f < frames; ++f)
+  {
+    for (const auto &c : file.channels)
+    {
+      uint32_t u;
+      memcpy(&u, &c[f], sizeof(u));
+      put32(d, u);
+    }
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  out.write((const char *)d.data(), (std::streamsize)d.size());
+  if (!out)
+  {
+    error = "Can't write '" + path + "'";
+    return false;
+  }
+  return true;
+}
+
+bool readMidiFile(const std::string &path, MidiFile &file, std::string &error)
+{
+  std::vector<uint8_t> d;
+  if (!readAll(path, d))
+  {
+    error = "Can't read '" + path + "'";
+    return false;
+  }
+  if (d.size() < 14 || memcmp(d.data(), "MThd", 4))
+  {
+    error = "'" + path + "' is not a standard MIDI file";
+    return false;
+  }
+  auto headerSize = be32(d.data() + 4);
+  auto tracks = be16(d.data() + 10);
+  auto division = be16(d.data() + 12);
+  // SMPTE divisions count ticks per second instead of per quarter note
+  bool smpte = division & 0x8000;
+  double ticksPerUnit =
+      smpte ? (double)(-(int8_t)(division >> 8)) * (division & 0xFF) : (double)division;
+  if (ticksPerUnit <= 0)
+  {
+    error = "'" + path + "' has an invalid time division";
+    return false;
+  }
+
+  struct TickEvent
+  {
+    uint64_t tick;
+    std::vector<uint8_t> bytes;
+  };
+  std::vector<TickEvent> events;
+  std::vector<std::pair<uint64_t, uint32_t>> tempos;  // tick, microseconds per quarter
+
+  bool ok = true, timeSignatureSet = false;
+  size_t pos = 8 + (size_t)headerSize;
+  for (auto t = 0U; t < tracks && ok; ++t)
+  {
+    if (pos + 8 > d.size() || memcmp(d.data() + pos, "MTrk", 4))
+    {
+      ok = false;
+      break;
+    }
+    size_t p = pos + 8;
+    size_t end = std::min(d.size(), p + be32(d.data() + pos + 4));
+    pos = end;
+
+    auto varlen = [&](uint32_t &v)
+    {
+      v = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+        if (p >= end) return false;
+        auto b = d[p++];
+        v = (v << 7) | (b & 0x7F);
+        if (!(b & 0x80)) return true;
+      }
+      return false;
+    };
+
+    uint64_t tick{0};
+    uint8_t running{0};
+    while (p < end)
+    {
+      uint32_t delta;
+      if (!varlen(delta))
+      {
+        ok = false;
+        break;
+      }
+      tick += delta;
+      if (p >= end)
+      {
+        ok = false;
+        break;
+      }
+      uint8_t status = d[p];
+      if (status & 0x80)
+        p++;
+      else if (running)
+        status = running;
+      else
+      {
+        ok = false;
+        break;
+      }
+
+      if (status == 0xFF)
+      {
+        uint32_t len;
+        if (p >= end)
+        {
+          ok = false;
+          break;
+        }
+        auto type = d[p++];
+        if (!varlen(len) || p + len > end)
+        {
+          ok = false;
+          break;
+        }
+        auto meta = d.data() + p;
+        if (type == 0x51 && len == 3)
+          tempos.emplace_back(tick, ((uint32_t)meta[0] << 16) | ((uint32_t)meta[1] << 8) | meta[2]);
+        else if (type == 0x58 && len >= 2 && !timeSignatureSet)
+        {
+          file.timeSignatureNumerator = meta[0];
+          file.timeSignatureDenominator = (uint16_t)(1U << std::min<uint8_t>(meta[1], 6));
+          timeSignatureSet = true;
+        }
+        p += len;
+        continue;
+      }
+      if (status == 0xF0 || status == 0xF7)
+      {
+        uint32_t len;
+        if (!varlen(len) || p + len > end)
+        {
+          ok = false;
+          break;
+        }
+        TickEvent e{tick, {}};
+        // F7 escapes raw bytes, F0 starts a SysEx message whose F0 is not part of the data
+        if (status == 0xF0) e.bytes.push_back(0xF0);
+        e.bytes.insert(e.bytes.end(), d.begin() + (std::ptrdiff_t)p,
+                       d.begin() + (std::ptrdiff_t)(p + len));
+        events.push_back(std::move(e));
+        p += len;
+        running = 0;
+        continue;
+      }
+
+      running = (status < 0xF0) ? status : 0;
+      auto dataBytes = ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 1U : 2U;
+      if (p + dataBytes > end)
+      {
+        ok = false;
+        break;
+      }
+      TickEvent e{tick, {status}};
+      e.bytes.insert(e.bytes.end(), d.begin() + (std::ptrdiff_t)p,
+                     d.begin() + (std::ptrdiff_t)(p + dataBytes));
+      events.push_back(std::move(e));
+      p += dataBytes;
+    }
+  }
+  if (!ok)
+  {
+    error = "'" + path + "' is damaged";
+    return false;
+  }
+
+  // the tempo map in ticks, then every event placed on it
+  std::stable_sort(tempos.begin(), tempos.end(),
+                   [](const auto &a, const auto &b) { return a.first < b.first; });
+  std::vector<uint64_t> changeTicks{0};
+  file.tempoMap.assign(1, TempoChange());
+  if (!smpte)
+  {
+    for (const auto &[tick, usPerQuarter] : tempos)
+    {
+      if (usPerQuarter == 0) continue;
+      auto &last = file.tempoMap.back();
+      auto beats = (double)(tick - changeTicks.back()) / ticksPerUnit;
+      TempoChange c;
+      c.seconds = last.seconds + beats * 60.0 / last.beatsPerMinute;
+      c.beats = last.beats + beats;
+      c.beatsPerMinute = 60'000'000.0 / usPerQuarter;
+      if (tick == changeTicks.back())
+        last = c;
+      else
+      {
+        file.tempoMap.push_back(c);
+        changeTicks.push_back(tick);
+      }
+    }
+  }
+
+  std::stable_sort(events.begin(), events.end(),
+                   [](const auto &a, const auto &b) { return a.tick < b.tick; });
+  file.events.clear();
+  file.events.reserve(events.size());
+  size_t seg = 0;
+  for (auto &e : events)
+  {
+    MidiFileEvent m;
+    if (smpte)
+      m.seconds = (double)e.tick / ticksPerUnit;
+    else
+    {
+      while (seg + 1 < changeTicks.size() && changeTicks[seg + 1] <= e.tick) seg++;
+      const auto &c = file.tempoMap[seg];
+      auto beats = (double)(e.tick - changeTicks[seg]) / ticksPerUnit;
+      m.seconds = c.seconds + beats * 60.0 / c.beatsPerMinute;
+    }
+    m.bytes = std::move(e.bytes);
+    file.events.push_back(std::move(m));
+  }
+  return true;
+}
+
+bool readAutomation(const std::string &path, std::vector<AutomationPoint> &points, std::string &error)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    error = "Can't read '" + path + "'";
+    return false;
+  }
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line))
+  {
+    lineNumber++;
+    auto hash = line.find('#');
+    if (hash != std::string::npos) line.resize(hash);
+
+    std::istringstream iss(line);
+    std::vector<std::string> tokens{std::istream_iterator<std::string>(iss),
+                                    std::istream_iterator<std::string>()};
+    if (tokens.empty()) continue;
+
+    // names can have spaces, so the parameter is everything between the time and the value
+    AutomationPoint pt;
+    char *endTime{nullptr}, *endValue{nullptr};
+    if (tokens.size() >= 3)
+    {
+      pt.seconds = std::strtod(tokens.front().c_str(), &endTime);
+      pt.value = std::strtod(tokens.back().c_str(), &endValue);
+    }
+    if (tokens.size() < 3 || *endTime || *endValue || pt.seconds < 0)
+    {
+      error = path + ":" + std::to_string(lineNumber) + ": expected '<seconds> <parameter> <value>'";
+      return false;
+    }
+    for (auto i = 1U; i + 1 < tokens.size(); ++i) pt.param += (i > 1 ? " " : "") + tokens[i];
+    points.push_back(pt);
+  }
+  std::stable_sort(points.begin(), points.end(),
+                   [](const auto &a, const auto &b) { return a.seconds < b.seconds; });
+  return true;
+}
+}  // namespace render
+
+namespace
+{
+using namespace render;
+
+// the smallest host a plugin can run under, without a GUI, timers or a device
+class RenderHost : public Clap::IHost
+{
+ public:
+  std::vector<uint32_t> inputChannelByBus, outputChannelByBus;
+  uint32_t mainInput{0}, mainOutput{0};
+
+  void mark_dirty() override
+  {
+  }
+  void restartPlugin() override
+  {
+  }
+  void request_callback() override
+  {
+  }
+  void setupWrapperSpecifics(const clap_plugin_t *) override
+  {
+  }
+  void setupAudioBusses(const clap_plugin_t *plugin,
+                        const clap_plugin_audio_ports_t *audioports) override
+  {
+    clap_audio_port_info_t info;
+    for (auto i = 0U; i < audioports->count(plugin, true); ++i)
+    {
+      audioports->get(plugin, i, true, &info);
+      inputChannelByBus.push_back(info.channel_count);
+      if (info.flags & CLAP_AUDIO_PORT_IS_MAIN) mainInput = i;
+    }
+    for (auto i = 0U; i < audioports->count(plugin, false); ++i)
+    {
+      audioports->get(plugin, i, false, &info);
+      outputChannelByBus.push_back(info.channel_count);
+      if (info.flags & CLAP_AUDIO_PORT_IS_MAIN) mainOutput = i;
+    }
+  }
+  void setupMIDIBusses(const clap_plugin_t *, const clap_plugin_note_ports_t *) override
+  {
+  }
+  void setupParameters(const clap_plugin_t *, const clap_plugin_params_t *) override
+  {
+  }
+  void param_rescan(clap_param_rescan_flags) override
+  {
+  }
+  void param_clear(clap_id, clap_param_clear_flags) override
+  {
+  }
+  void param_request_flush() override
+  {
+  }
+  void latency_changed() override
+  {
+  }
+  void tail_changed() override
+  {
+  }
+  bool gui_can_resize() override
+  {
+    return false;
+  }
+  bool gui_request_resize(uint32_t, uint32_t) override
+  {
+    return false;
+  }
+  bool gui_request_show() override
+  {
+    return false;
+  }
+  bool gui_request_hide() override
+  {
+    return false;
+  }
+  bool register_timer(uint32_t, clap_id *) override
+  {
+    return false;
+  }
+  bool unregister_timer(clap_id) override
+  {
+    return false;
+  }
+  const char *host_get_name() override
+  {
+    return "CLAP-Wrapper-As-Standalone-Render";
+  }
+  bool supportsContextMenu() const override
+  {
+    return false;
+  }
+  bool context_menu_populate(const clap_context_menu_target_t *,
+                             const clap_context_menu_builder_t *) override
+  {
+    return false;
+  }
+  bool context_menu_perform(const clap_context_menu_target_t *, clap_id) override
+  {
+    return false;
+  }
+  bool context_menu_can_popup() override
+  {
+    return false;
+  }
+  bool context_menu_popup(const clap_context_menu_target_t *, int32_t, int32_t, int32_t) override
+  {
+    return false;
+  }
+#if LIN
+  bool register_fd(int, clap_posix_fd_flags_t) override
+  {
+    return false;
+  }
+  bool modify_fd(int, clap_posix_fd_flags_t) override
+  {
+    return false;
+  }
+  bool unregister_fd(int) override
+  {
+    return false;
+  }
+#endif
+};
+
+// the input events of one block, in time order
+struct BlockEvents
+{
+  std::vector<clap_event_midi> midi;
+  std::vector<clap_event_midi_sysex> sysex;
+  std::vector<clap_event_param_value> params;
+  std::vector<std::pair<char, size_t>> order;
+  std::vector<const clap_event_header_t *> headers;
+  clap_input_events events{this, size, get};
+
+  void clear()
+  {
+    midi.clear();
+    sysex.clear();
+    params.clear();
+    order.clear();
+    headers.clear();
+  }
+  // after everything is added, so the vectors don't move any more
+  void finish()
+  {
+    for (auto [kind, idx] : order)
+    {
+      if (kind == 'm')
+        headers.push_back(&midi[idx].header);
+      else if (kind == 's')
+        headers.push_back(&sysex[idx].header);
+      else
+        headers.push_back(&params[idx].header);
+    }
+  }
+  static uint32_t size(const clap_input_events *list)
+  {
+    return (uint32_t)((BlockEvents *)list->ctx)->headers.size();
+  }
+  static const clap_event_header_t *get(const clap_input_events *list, uint32_t index)
+  {
+    return ((BlockEvents *)list->ctx)->headers[index];
+  }
+};
+
+bool discardOutputEvent(const clap_output_events *, const clap_event_header_t *)
+{
+  return true;
+}
+
+struct ResolvedPoint
+{
+  uint64_t frame;
+  clap_id id;
+  void *cookie;
+  double value;
+};
+
+bool resolveAutomation(const Clap::Plugin &plugin, const std::vector<AutomationPoint> &points,
+                       int32_t sampleRate, std::vector<ResolvedPoint> &resolved, std::string &error)
+{
+  auto params = plugin._ext._params;
+  if (!points.empty() && !params)
+  {
+    error = "The plugin has no parameters to automate";
+    return false;
+  }
+
+  std::vector<clap_param_info_t> infos(params ? params->count(plugin._plugin) : 0);
+  for (auto i = 0U; i < infos.size(); ++i) params->get_info(plugin._plugin, i, &infos[i]);
+
+  for (const auto &pt : points)
+  {
+    char *end{nullptr};
+    auto id = std::strtoul(pt.param.c_str(), &end, 10);
+    bool byId = !pt.param.empty() && !*end;
+    auto it = std::find_if(infos.begin(), infos.end(),
+                           [&](const auto &info)
+                           { return byId ? info.id == id : pt.param == info.name; });
+    if (it == infos.end())
+    {
+      error = "The plugin has no parameter '" + pt.param + "'";
+      return false;
+    }
+    resolved.push_back({(uint64_t)std::llround(pt.seconds * sampleRate), it->id, it->cookie,
+                        std::clamp(pt.value, it->min_value, it->max_value)});
+  }
+  return true;
+}
+
+class Transport
+{
+ public:
+  Transport(const std::vector<TempoChange> &map, uint16_t num, uint16_t denom) : tempoMap(map)
+  {
+    memset(&event, 0, sizeof(event));
+    event.header.size = sizeof(clap_event_transport);
+    event.header.type = CLAP_EVENT_TRANSPORT;
+    event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    event.flags = CLAP_TRANSPORT_HAS_TEMPO | CLAP_TRANSPORT_HAS_BEATS_TIMELINE |
+                  CLAP_TRANSPORT_HAS_SECONDS_TIMELINE | CLAP_TRANSPORT_HAS_TIME_SIGNATURE |
+                  CLAP_TRANSPORT_IS_PLAYING;
+    event.tsig_num = num;
+    event.tsig_denom = denom;
+  }
+
+  // tempo changes take effect at the start of the block they fall in
+  const clap_event_transport *at(double seconds)
+  {
+    const auto &c = change(seconds);
+    auto beats = c.beats + (seconds - c.seconds) * c.beatsPerMinute / 60.0;
+    event.tempo = c.beatsPerMinute;
+    event.song_pos_beats = (clap_beattime)std::llround(beats * CLAP_BEATTIME_FACTOR);
+    event.song_pos_seconds = (clap_sectime)std::llround(seconds * CLAP_SECTIME_FACTOR);
+
+    auto beatsPerBar = event.tsig_num * 4.0 / event.tsig_denom;
+    auto bar = std::floor(beats / beatsPerBar + 1e-9);
+    event.bar_number = (int32_t)bar;
+    event.bar_start = (clap_beattime)std::llround(bar * beatsPerBar * CLAP_BEATTIME_FACTOR);
+    return &event;
+  }
+
+ private:
+  const TempoChange &change(double seconds) const
+  {
+    size_t i = 0;
+    while (i + 1 < tempoMap.size() && tempoMap[i + 1].seconds <= seconds) i++;
+    return tempoMap[i];
+  }
+
+  std::vector<TempoChange> tempoMap;
+  clap_event_transport event;
+};
+
+bool renderJob(const clap_plugin_factory *factory, const std::string &clapId, uint32_t clapIndex,
+               const RenderJob &job, std::string &result)
+{
+  AudioFile input;
+  MidiFile midi;
+  std::vector<AutomationPoint> points;
+  if (!job.inputWav.empty() && !readWav(job.inputWav, input, result)) return false;
+  if (!job.midiFile.empty() && !readMidiFile(job.midiFile, midi, result)) return false;
+  if (!job.automationFile.empty() && !readAutomation(job.automationFile, points, result)) return false;
+  if (job.midiFile.empty())
+  {
+    TempoChange c;
+    c.beatsPerMinute = job.tempo;
+    midi.tempoMap.assign(1, c);
+  }
+
+  auto sampleRate = job.sampleRate > 0 ? job.sampleRate : input.sampleRate;
+  if (sampleRate <= 0) sampleRate = 48000;
+  if (input.sampleRate > 0 && input.sampleRate != sampleRate)
+  {
+    result = "'" + job.inputWav + "' is at " + std::to_string(input.sampleRate) + "Hz, the render at " +
+             std::to_string(sampleRate) + "Hz";
+    return false;
+  }
+
+  RenderHost host;
+  auto plugin = clapId.empty() ? Clap::Plugin::createInstance(factory, clapIndex, &host)
+                               : Clap::Plugin::createInstance(factory, clapId, &host);
+  if (!plugin)
+  {
+    result = "Unable to create the plugin";
+    return false;
+  }
+  plugin->initialize();
+
+  if (!job.stateFile.empty())
+  {
+    MappedSettingsFile file;
+    if (!file.open(fs::path(job.stateFile)) || !plugin->load(file.pluginState()))
+    {
+      result = "Can't load the plugin state from '" + job.stateFile + "'";
+      return false;
+    }
+  }
+
+  std::vector<ResolvedPoint> automation;
+  if (!resolveAutomation(*plugin, points, sampleRate, automation, result)) return false;
+
+  if (host.outputChannelByBus.empty() || host.outputChannelByBus[host.mainOutput] == 0)
+  {
+    result = "The plugin has no audio output to render";
+    return false;
+  }
+
+  uint64_t frames;
+  if (job.length >= 0)
+    frames = (uint64_t)std::llround(job.length * sampleRate);
+  else
+  {
+    auto end = (double)input.frames() / sampleRate;
+    if (!midi.events.empty()) end = std::max(end, midi.events.back().seconds);
+    if (!points.empty()) end = std::max(end, points.back().seconds);
+    frames = (uint64_t)std::llround((end + job.tail) * sampleRate);
+  }
+
+  // one block of audio for every bus
+  auto block = job.blockSize;
+  auto makeBuffers = [block](const std::vector<uint32_t> &channelsByBus,
+                             std::vector<std::vector<float>> &data,
+                             std::vector<std::vector<float *>> &ptrs,
+                             std::vector<clap_audio_buffer> &buffers)
+  {
+    data.resize(channelsByBus.size());
+    ptrs.resize(channelsByBus.size());
+    buffers.resize(channelsByBus.size());
+    for (auto b = 0U; b < channelsByBus.size(); ++b)
+    {
+      data[b].assign((size_t)channelsByBus[b] * block, 0.f);
+      for (auto c = 0U; c < channelsByBus[b]; ++c) ptrs[b].push_back(data[b].data() + (size_t)c * block);
+      memset(&buffers[b], 0, sizeof(clap_audio_buffer));
+      buffers[b].channel_count = channelsByBus[b];
+      buffers[b].data32 = ptrs[b].data();
+    }
+  };
+  std::vector<std::vector<float>> inData, outData;
+  std::vector<std::vector<float *>> inPtrs, outPtrs;
+  std::vector<clap_audio_buffer> inBuffers, outBuffers;
+  makeBuffers(host.inputChannelByBus, inData, inPtrs, inBuffers);
+  makeBuffers(host.outputChannelByBus, outData, outPtrs, outBuffers);
+
+  AudioFile output;
+  output.sampleRate = sampleRate;
+  output.channels.assign(host.outputChannelByBus[host.mainOutput], std::vector<float>(frames));
+
+  if (plugin->_ext._render) plugin->_ext._render->set(plugin->_plugin, CLAP_RENDER_OFFLINE);
+  plugin->setSampleRate(sampleRate);
+  plugin->setBlockSizes(1, block);
+  if (!plugin->activate())
+  {
+    result = "The plugin did not activate";
+    return false;
+  }
+
+  // the thread creating the plugin is its main thread, so processing runs on another one
+  bool processed = true;
+  double elapsed = 0;
+  std::thread audio(
+      [&]()
+      {
+        BlockEvents events;
+        Transport transport(midi.tempoMap, midi.timeSignatureNumerator, midi.timeSignatureDenominator);
+        clap_output_events outEvents{nullptr, discardOutputEvent};
+        clap_process process;
+        memset(&process, 0, sizeof(process));
+        process.audio_inputs = inBuffers.data();
+        process.audio_inputs_count = (uint32_t)inBuffers.size();
+        process.audio_outputs = outBuffers.data();
+        process.audio_outputs_count = (uint32_t)outBuffers.size();
+        process.in_events = &events.events;
+        process.out_events = &outEvents;
+
+        auto midiFrame = [&](size_t i)
+        { return (uint64_t)std::llround(midi.events[i].seconds * sampleRate); };
+        size_t nextMidi = 0, nextPoint = 0;
+
+        plugin->start_processing();
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t pos = 0; pos < frames; pos += block)
+        {
+          auto n = (uint32_t)std::min<uint64_t>(block, frames - pos);
+
+          for (auto b = 0U; b < inPtrs.size(); ++b)
+          {
+            for (auto c = 0U; c < inPtrs[b].size(); ++c)
+            {
+              auto dst = inPtrs[b][c];
+              uint64_t avail = 0;
+              if (b == host.mainInput && !input.channels.empty() && pos < input.frames())
+              {
+                // a mono file feeds every channel of the main input
+                avail = std::min<uint64_t>(n, input.frames() - pos);
+                auto src = input.channels[c % input.channels.size()].data() + pos;
+                memcpy(dst, src, avail * sizeof(float));
+              }
+              memset(dst + avail, 0, (n - avail) * sizeof(float));
+            }
+          }
+
+          events.clear();
+          while (true)
+          {
+            bool hasMidi = nextMidi < midi.events.size() && midiFrame(nextMidi) < pos + n;
+            bool hasPoint = nextPoint < automation.size() && automation[nextPoint].frame < pos + n;
+            if (!hasMidi && !hasPoint) break;
+
+            if (hasPoint && (!hasMidi || automation[nextPoint].frame <= midiFrame(nextMidi)))
+            {
+              const auto &pt = automation[nextPoint++];
+              clap_event_param_value ev;
+              ev.header.size = sizeof(clap_event_param_value);
+              ev.header.time = (uint32_t)(pt.frame - pos);
+              ev.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+              ev.header.type = CLAP_EVENT_PARAM_VALUE;
+              ev.header.flags = 0;
+              ev.param_id = pt.id;
+              ev.cookie = pt.cookie;
+              ev.note_id = -1;
+              ev.port_index = -1;
+              ev.channel = -1;
+              ev.key = -1;
+              ev.value = pt.value;
+              events.order.emplace_back('p', events.params.size());
+              events.params.push_back(ev);
+              continue;
+            }
+
+            auto time = (uint32_t)(midiFrame(nextMidi) - pos);
+            const auto &bytes = midi.events[nextMidi++].bytes;
+            if (bytes[0] == 0xF0)
+            {
+              clap_event_midi_sysex ev;
+              ev.header.size = sizeof(clap_event_midi_sysex);
+              ev.header.time = time;
+              ev.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+              ev.header.type = CLAP_EVENT_MIDI_SYSEX;
+              ev.header.flags = 0;
+              ev.port_index = 0;
+              ev.buffer = bytes.data();
+              ev.size = (uint32_t)bytes.size();
+              events.order.emplace_back('s', events.sysex.size());
+              events.sysex.push_back(ev);
+            }
+            else if (bytes.size() <= 3 && (bytes[0] & 0x80))
+            {
+              clap_event_midi ev;
+              ev.header.size = sizeof(clap_event_midi);
+              ev.header.time = time;
+              ev.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+              ev.header.type = CLAP_EVENT_MIDI;
+              ev.header.flags = 0;
+              ev.port_index = 0;
+              memset(ev.data, 0, sizeof(ev.data));
+              memcpy(ev.data, bytes.data(), bytes.size());
+              events.order.emplace_back('m', events.midi.size());
+              events.midi.push_back(ev);
+            }
+          }
+          events.finish();
+
+          process.frames_count = n;
+          process.steady_time = (int64_t)pos;
+          process.transport = transport.at((double)pos / sampleRate);
+          if (plugin->_plugin->process(plugin->_plugin, &process) == CLAP_PROCESS_ERROR)
+          {
+            processed = false;
+            break;
+          }
+
+          for (auto c = 0U; c < output.channels.size(); ++c)
+            memcpy(output.channels[c].data() + pos, outPtrs[host.mainOutput][c], n * sizeof(float));
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        plugin->stop_processing();
+      });
+  audio.join();
+  plugin->deactivate();
+
+  if (!processed)
+  {
+    result = "The plugin returned an error while rendering '" + job.outputWav + "'";
+    return false;
+  }
+  if (!writeWav(job.outputWav, output, result)) return false;
+
+  auto audioSeconds = (double)frames / sampleRate;
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%.3fs of audio in %.3fs (%.1fx realtime)", audioSeconds, elapsed,
+           elapsed > 0 ? audioSeconds / elapsed : 0.0);
+  result = "Rendered '" + job.outputWav + "': " + buf;
+  return true;
+}
+
+bool parseNumber(const std::string &s, double &v)
+{
+  char *end{nullptr};
+  v = std::strtod(s.c_str(), &end);
+  return !s.empty() && !*end;
+}
+
+bool parseJob(const std::vector<std::string> &args, RenderJob &job, std::string &error)
+{
+  for (size_t i = 0; i < args.size(); ++i)
+  {
+    const auto &arg = args[i];
+    if (arg == "--render") continue;
+    if (i + 1 >= args.size())
+    {
+      error = "Unknown render option, or one without a value: '" + arg + "'";
+      return false;
+    }
+    const auto &value = args[++i];
+
+    double number{0};
+    if (arg == "--input")
+      job.inputWav = value;
+    else if (arg == "--midi")
+      job.midiFile = value;
+    else if (arg == "--automation")
+      job.automationFile = value;
+    else if (arg == "--state")
+      job.stateFile = value;
+    else if (arg == "--output")
+      job.outputWav = value;
+    else if (!parseNumber(value, number))
+    {
+      error = "'" + value + "' is not a number, for " + arg;
+      return false;
+    }
+    else if (arg == "--sample-rate" && number > 0)
+      job.sampleRate = (int32_t)number;
+    else if (arg == "--block-size" && number >= 1 && number <= 65536)
+      job.blockSize = (uint32_t)number;
+    else if (arg == "--tempo" && number > 0)
+      job.tempo = number;
+    else if (arg == "--length" && number >= 0)
+      job.length = number;
+    else if (arg == "--tail" && number >= 0)
+      job.tail = number;
+    else
+    {
+      error = "Unknown render option, or a value out of range: '" + arg + " " + value + "'";
+      return false;
+    }
+  }
+  if (job.outputWav.empty())
+  {
+    error = "A render needs an --output file";
+    return false;
+  }
+  return true;
+}
+
+// whitespace separated, with double quotes around arguments containing spaces
+std::vector<std::string> splitArguments(const std::string &line)
+{
+  std::vector<std::string> res;
+  std::string current;
+  bool quoted{false}, has{false};
+  for (auto ch : line)
+  {
+    if (ch == '"')
+    {
+      quoted = !quoted;
+      has = true;
+    }
+    else if (!quoted && std::isspace((unsigned char)ch))
+    {
+      if (has) res.push_back(current);
+      current.clear();
+      has = false;
+    }
+    else
+    {
+      current += ch;
+      has = true;
+    }
+  }
+  if (has) res.push_back(current);
+  return res;
+}
+}  // namespace
+
+bool isRenderCommandLine(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--render") return true;
+  }
+  return false;
+}
+
+int mainRender(const clap_plugin_entry *entry, const std::string &clapId, uint32_t clapIndex, int argc,
+               char **argv)
+{
+  std::string batch, error;
+  unsigned int workers{0};
+  std::vector<std::string> common;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if ((arg == "--batch" || arg == "--jobs") && i + 1 < argc)
+    {
+      if (arg == "--batch")
+        batch = argv[++i];
+      else
+        workers = (unsigned int)std::max(1L, std::strtol(argv[++i], nullptr, 10));
+    }
+    else
+      common.push_back(arg);
+  }
+
+  std::vector<RenderJob> jobs;
+  if (batch.empty())
+  {
+    RenderJob job;
+    if (!parseJob(common, job, error))
+    {
+      std::cerr << error << std::endl;
+      return 2;
+    }
+    jobs.push_back(job);
+  }
+  else
+  {
+    // the options on the command line are the defaults for every job in the batch
+    std::ifstream in(batch);
+    if (!in)
+    {
+      std::cerr << "Can't read the batch file '" << batch << "'" << std::endl;
+      return 2;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line))
+    {
+      lineNumber++;
+      auto args = splitArguments(line);
+      if (args.empty() || args[0][0] == '#') continue;
+      args.insert(args.begin(), common.begin(), common.end());
+      RenderJob job;
+      if (!parseJob(args, job, error))
+      {
+        std::cerr << batch << ":" << lineNumber << ": " << error << std::endl;
+        return 2;
+      }
+      jobs.push_back(job);
+    }
+  }
+  if (jobs.empty()) return 0;
+
+  entry->init(argv[0]);
+  auto factory = (const clap_plugin_factory *)entry->get_factory(CLAP_PLUGIN_FACTORY_ID);
+  if (!factory)
+  {
+    std::cerr << "The CLAP has no plugin factory" << std::endl;
+    entry->deinit();
+    return 3;
+  }
+
+  if (workers == 0) workers = std::max(1U, std::thread::hardware_concurrency());
+  workers = std::min<unsigned int>(workers, (unsigned int)jobs.size());
+  LOGDETAIL("Rendering {} jobs on {} threads", jobs.size(), workers);
+
+  std::atomic<size_t> next{0};
+  std::atomic<uint32_t> failed{0};
+  std::mutex reportMutex;
+  std::vector<std::thread> threads;
+  for (auto w = 0U; w < workers; ++w)
+  {
+    threads.emplace_back(
+        [&]()
+        {
+          for (auto i = next++; i < jobs.size(); i = next++)
+          {
+            std::string result;
+            auto ok = renderJob(factory, clapId, clapIndex, jobs[i], result);
+            if (!ok) failed++;
+            std::lock_guard<std::mutex> g(reportMutex);
+            (ok ? std::cout : std::cerr) << result << std::endl;
+          }
+        });
+  }
+  for (auto &t : threads) t.join();
+
+  entry->deinit();
+  return failed ? 1 : 0;
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+ * Offline rendering with the standalone executable, without an audio device or a GUI.
+ *
+ *   <standalone> --render --output out.wav [--input in.wav] [--midi in.mid]
+ *                [--automation params.txt] [--state settings.clapwrapper] [--sample-rate 48000]
+ *                [--block-size 256] [--tempo 120] [--length seconds] [--tail seconds]
+ *   <standalone> --render --batch jobs.txt [--jobs N]
+ *
+ * A batch file has one job per line, written as the options of a single render. The jobs
+ * are spread over N worker threads (all cores by default), each with its own plugin
+ * instance. Every job starts from a fresh instance so renders don't depend on each other.
+ *
+ * The plugin runs with CLAP_RENDER_OFFLINE as fast as it can, with a playing transport
+ * following the tempo map of the MIDI file, or --tempo without one.
+ *
+ * The automation file has one point per line: `<seconds> <param id or name> <value>`, with
+ * `#` starting a comment. Each point sets the plain parameter value at that time.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <clap/clap.h>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct RenderJob
+{
+  std::string inputWav, midiFile, automationFile, stateFile, outputWav;
+  int32_t sampleRate{0};  // 0 takes the input file rate, or 48000
+  uint32_t blockSize{256};
+  double tempo{120.0};
+  double length{-1.0};  // seconds, < 0 for until the inputs end plus the tail
+  double tail{1.0};
+};
+
+// true if argv asks for --render, before any GUI sees the command line
+bool isRenderCommandLine(int argc, char **argv);
+
+// runs the render or batch given on the command line, returns the process exit code
+int mainRender(const clap_plugin_entry *entry, const std::string &clapId, uint32_t clapIndex, int argc,
+               char **argv);
+
+// the file formats a render reads and writes
+namespace render
+{
+struct AudioFile
+{
+  int32_t sampleRate{0};
+  std::vector<std::vector<float>> channels;
+  uint64_t frames() const
+  {
+    return channels.empty() ? 0 : channels[0].size();
+  }
+};
+// PCM in 16, 24 or 32 bits, or float in 32 or 64 bits
+bool readWav(const std::string &path, AudioFile &file, std::string &error);
+// always 32 bit float
+bool writeWav(const std::string &path, const AudioFile &file, std::string &error);
+
+struct MidiFileEvent
+{
+  double seconds{0};
+  std::vector<uint8_t> bytes;  // a complete message, SysEx including the F0
+};
+struct TempoChange
+{
+  double seconds{0}, beats{0};
+  double beatsPerMinute{120};
+};
+struct MidiFile
+{
+  std::vector<MidiFileEvent> events;  // in time order
+  std::vector<TempoChange> tempoMap;  // never empty once read, the first change is at 0
+  uint16_t timeSignatureNumerator{4}, timeSignatureDenominator{4};
+};
+bool readMidiFile(const std::string &path, MidiFile &file, std::string &error);
+
+struct AutomationPoint
+{
+  double seconds{0};
+  std::string param;  // an id, or a name resolved once the plugin is loaded
+  double value{0};
+};
+bool readAutomation(const std::string &path, std::vector<AutomationPoint> &points,
+                    std::string &error);
+}  // namespace render
+}  // namespace freeaudio::clap_wrapper::standalone
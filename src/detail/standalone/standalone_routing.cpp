@@ -0,0 +1,158 @@
+#include "standalone_routing.h"
+#include "standalone_details.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+std::string routeToString(const AudioRoute &route)
+{
+  return std::to_string(route.deviceChannel) + ":" + std::to_string(route.bus) + ":" +
+         std::to_string(route.channel);
+}
+
+bool routeFromString(const std::string &s, AudioRoute &route)
+{
+  unsigned int d, b, c;
+  if (sscanf(s.c_str(), "%u:%u:%u", &d, &b, &c) != 3) return false;
+  route.deviceChannel = d;
+  route.bus = b;
+  route.channel = c;
+  return true;
+}
+
+namespace
+{
+// main bus first, then the others in index order
+std::vector<uint32_t> busOrder(size_t busCount, uint32_t mainBus)
+{
+  std::vector<uint32_t> res;
+  if (mainBus < busCount) res.push_back(mainBus);
+  for (auto b = 0U; b < busCount; ++b)
+  {
+    if (b != mainBus) res.push_back(b);
+  }
+  return res;
+}
+}  // namespace
+
+std::vector<AudioRoute> defaultInputRoutes(const std::vector<uint32_t> &channelsByBus, uint32_t mainBus,
+                                           uint32_t deviceChannels)
+{
+  std::vector<AudioRoute> res;
+  if (deviceChannels == 0) return res;
+
+  uint32_t next = 0;
+  for (auto b : busOrder(channelsByBus.size(), mainBus))
+  {
+    if (b == mainBus)
+    {
+      // a mono interface still feeds both sides of a stereo main input
+      for (auto c = 0U; c < channelsByBus[b]; ++c) res.push_back({c % deviceChannels, b, c});
+      next = std::min(channelsByBus[b], deviceChannels);
+      continue;
+    }
+    for (auto c = 0U; c < channelsByBus[b] && next < deviceChannels; ++c) res.push_back({next++, b, c});
+  }
+  return res;
+}
+
+std::vector<AudioRoute> defaultOutputRoutes(const std::vector<uint32_t> &channelsByBus, uint32_t mainBus,
+                                            uint32_t deviceChannels)
+{
+  std::vector<AudioRoute> res;
+  uint32_t next = 0;
+  for (auto b : busOrder(channelsByBus.size(), mainBus))
+  {
+    if (b == mainBus && channelsByBus[b] == 1 && deviceChannels >= 2)
+    {
+      res.push_back({0, b, 0});
+      res.push_back({1, b, 0});
+      next = 2;
+      continue;
+    }
+    for (auto c = 0U; c < channelsByBus[b] && next < deviceChannels; ++c) res.push_back({next++, b, c});
+  }
+  return res;
+}
+
+void AudioRouting::build(const std::vector<uint32_t> &inputChannelsByBus,
+                         const std::vector<uint32_t> &outputChannelsByBus, uint32_t mainInputBus,
+                         uint32_t mainOutputBus, std::vector<AudioRoute> inputRoutes,
+                         std::vector<AudioRoute> outputRoutes, uint32_t deviceIns, uint32_t deviceOuts,
+                         bool deviceNonInterleaved)
+{
+  nonInterleaved = deviceNonInterleaved;
+  deviceInputChannels = deviceIns;
+  deviceOutputChannels = deviceOuts;
+
+  inputBusOffset.clear();
+  pluginInputChannels = 0;
+  for (auto c : inputChannelsByBus)
+  {
+    inputBusOffset.push_back(pluginInputChannels);
+    pluginInputChannels += c;
+  }
+  outputBusOffset.clear();
+  pluginOutputChannels = 0;
+  for (auto c : outputChannelsByBus)
+  {
+    outputBusOffset.push_back(pluginOutputChannels);
+    pluginOutputChannels += c;
+  }
+
+  if (inputRoutes.empty()) inputRoutes = defaultInputRoutes(inputChannelsByBus, mainInputBus, deviceIns);
+  if (outputRoutes.empty())
+    outputRoutes = defaultOutputRoutes(outputChannelsByBus, mainOutputBus, deviceOuts);
+
+  inputSource.assign(pluginInputChannels, -1);
+  for (const auto &r : inputRoutes)
+  {
+    if (r.bus >= inputChannelsByBus.size() || r.channel >= inputChannelsByBus[r.bus] ||
+        r.deviceChannel >= deviceIns)
+    {
+      LOGDETAIL("Dropping input route {}, not available", routeToString(r));
+      continue;
+    }
+    inputSource[inputBusOffset[r.bus] + r.channel] = (int32_t)r.deviceChannel;
+  }
+
+  outputTarget.assign(pluginOutputChannels, -1);
+  outputCopies.clear();
+  std::vector<bool> deviceUsed(deviceOuts, false);
+  for (const auto &r : outputRoutes)
+  {
+    if (r.bus >= outputChannelsByBus.size() || r.channel >= outputChannelsByBus[r.bus] ||
+        r.deviceChannel >= deviceOuts)
+    {
+      LOGDETAIL("Dropping output route {}, not available", routeToString(r));
+      continue;
+    }
+    if (deviceUsed[r.deviceChannel])
+    {
+      LOGINFO("[WARNING] Device output {} is already routed, dropping {}", r.deviceChannel,
+              routeToString(r));
+      continue;
+    }
+    deviceUsed[r.deviceChannel] = true;
+
+    auto flat = outputBusOffset[r.bus] + r.channel;
+    if (outputTarget[flat] < 0)
+      outputTarget[flat] = (int32_t)r.deviceChannel;
+    else
+      outputCopies.emplace_back(flat, r.deviceChannel);
+  }
+
+  silentOutputs.clear();
+  for (auto d = 0U; d < deviceOuts; ++d)
+  {
+    if (!deviceUsed[d]) silentOutputs.push_back(d);
+  }
+
+  LOGDETAIL("Audio routing: {} plugin inputs from {} device inputs, {} plugin outputs to {} device "
+            "outputs{}",
+            pluginInputChannels, deviceIns, pluginOutputChannels, deviceOuts,
+            nonInterleaved ? " (non interleaved)" : "");
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+ * Audio routing of the standalone: which device channel feeds which channel of which
+ * CLAP input bus, and which CLAP output channel goes to which device channel.
+ *
+ * The table is resolved once when the stream opens, the audio callback only walks the
+ * flat arrays of AudioRouting. Plugin channels are numbered bus after bus ("flat"), in
+ * bus index order. A device input can feed any number of plugin inputs and a plugin output
+ * can go to any number of device outputs, but each device output has at most one source.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct AudioRoute
+{
+  uint32_t deviceChannel{0};
+  uint32_t bus{0};
+  uint32_t channel{0};
+
+  bool operator==(const AudioRoute &other) const
+  {
+    return deviceChannel == other.deviceChannel && bus == other.bus && channel == other.channel;
+  }
+};
+
+// "device:bus:channel", as stored in the settings file
+std::string routeToString(const AudioRoute &route);
+bool routeFromString(const std::string &s, AudioRoute &route);
+
+/*
+ * The main bus goes to the first device channels, the other busses follow in index order
+ * until the device runs out of channels. A mono main output is sent to the first two
+ * device outputs and a main input wider than the device repeats the device channels.
+ */
+std::vector<AudioRoute> defaultInputRoutes(const std::vector<uint32_t> &channelsByBus, uint32_t mainBus,
+                                           uint32_t deviceChannels);
+std::vector<AudioRoute> defaultOutputRoutes(const std::vector<uint32_t> &channelsByBus, uint32_t mainBus,
+                                            uint32_t deviceChannels);
+
+struct AudioRouting
+{
+  // the device buffers are one block per channel (RTAUDIO_NONINTERLEAVED) rather than frames
+  bool nonInterleaved{false};
+  uint32_t deviceInputChannels{0}, deviceOutputChannels{0};
+
+  // the first flat channel of each bus
+  std::vector<uint32_t> inputBusOffset, outputBusOffset;
+  uint32_t pluginInputChannels{0}, pluginOutputChannels{0};
+
+  // per flat plugin input: the device channel feeding it, -1 for silence
+  std::vector<int32_t> inputSource;
+  // per flat plugin output: the device channel it renders into, -1 if it goes nowhere
+  std::vector<int32_t> outputTarget;
+  // further device channels a plugin output is copied to after processing, as (flat, device)
+  std::vector<std::pair<uint32_t, uint32_t>> outputCopies;
+  // device outputs nothing is routed to
+  std::vector<uint32_t> silentOutputs;
+
+  /*
+   * Resolves the routes against the busses and the device. Routes which point at a bus,
+   * channel or device channel which does not exist are dropped, as is a second route into
+   * the same device output. Empty routes mean the defaults.
+   */
+  void build(const std::vector<uint32_t> &inputChannelsByBus,
+             const std::vector<uint32_t> &outputChannelsByBus, uint32_t mainInputBus,
+             uint32_t mainOutputBus, std::vector<AudioRoute> inputRoutes,
+             std::vector<AudioRoute> outputRoutes, uint32_t deviceIns, uint32_t deviceOuts,
+             bool deviceNonInterleaved);
+};
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,431 @@
+#include "standalone_settings.h"
+#include "standalone_details.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace
+{
+const char magic[8] = {'C', 'L', 'A', 'P', 'W', 'R', 'A', 'P'};
+const uint32_t formatVersion = 1;
+
+void put32(std::ostream &os, uint32_t v)
+{
+  char b[4];
+  for (int i = 0; i < 4; ++i) b[i] = (char)((v >> (8 * i)) & 0xFF);
+  os.write(b, sizeof(b));
+}
+
+void put64(std::ostream &os, uint64_t v)
+{
+  char b[8];
+  for (int i = 0; i < 8; ++i) b[i] = (char)((v >> (8 * i)) & 0xFF);
+  os.write(b, sizeof(b));
+}
+
+void putString(std::ostream &os, const std::string &s)
+{
+  put32(os, (uint32_t)s.size());
+  os.write(s.data(), s.size());
+}
+
+// line breaks would end the value early, nothing we store should have them anyway
+std::string lineValue(const std::string &s)
+{
+  auto res = s;
+  for (auto &c : res)
+  {
+    if (c == '\n' || c == '\r') c = ' ';
+  }
+  return res;
+}
+
+std::string standaloneSection(const StandaloneSettings &s)
+{
+  std::ostringstream oss;
+  if (s.hasAudio)
+  {
+    oss << "audio-api=" << lineValue(s.audioApi) << "\n"
+        << "audio-input=" << lineValue(s.audioInputDevice) << "\n"
+        << "audio-output=" << lineValue(s.audioOutputDevice) << "\n"
+        << "audio-input-used=" << (s.audioInputUsed ? 1 : 0) << "\n"
+        << "audio-output-used=" << (s.audioOutputUsed ? 1 : 0) << "\n"
+        << "sample-rate=" << s.sampleRate << "\n"
+        << "buffer-size=" << s.bufferSize << "\n";
+    for (const auto &r : s.inputRoutes) oss << "audio-input-route=" << routeToString(r) << "\n";
+    for (const auto &r : s.outputRoutes) oss << "audio-output-route=" << routeToString(r) << "\n";
+  }
+  if (s.hasMidi)
+  {
+    if (s.midiInputsSelected)
+    {
+      oss << "midi-input-count=" << s.midiInputs.size() << "\n";
+      for (const auto &m : s.midiInputs) oss << "midi-input=" << lineValue(m) << "\n";
+    }
+    else
+    {
+      oss << "midi-inputs=all\n";
+    }
+    for (const auto &m : s.midiOutputs) oss << "midi-output=" << lineValue(m) << "\n";
+  }
+  return oss.str();
+}
+
+void parseStandaloneSection(const std::string &section, StandaloneSettings &s)
+{
+  std::istringstream iss(section);
+  std::string line;
+  while (std::getline(iss, line))
+  {
+    auto eq = line.find('=');
+    if (eq == std::string::npos) continue;
+    auto key = line.substr(0, eq);
+    auto value = line.substr(eq + 1);
+
+    if (key == "audio-api")
+    {
+      s.hasAudio = true;
+      s.audioApi = value;
+    }
+    else if (key == "audio-input")
+      s.audioInputDevice = value;
+    else if (key == "audio-output")
+      s.audioOutputDevice = value;
+    else if (key == "audio-input-used")
+      s.audioInputUsed = value == "1";
+    else if (key == "audio-output-used")
+      s.audioOutputUsed = value == "1";
+    else if (key == "sample-rate")
+      s.sampleRate = (int32_t)std::strtol(value.c_str(), nullptr, 10);
+    else if (key == "buffer-size")
+      s.bufferSize = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+    else if (key == "audio-input-route" || key == "audio-output-route")
+    {
+      AudioRoute r;
+      if (routeFromString(value, r))
+        (key == "audio-input-route" ? s.inputRoutes : s.outputRoutes).push_back(r);
+    }
+    else if (key == "midi-input-count")
+    {
+      s.hasMidi = true;
+      s.midiInputsSelected = true;
+    }
+    else if (key == "midi-inputs")
+      s.hasMidi = true;
+    else if (key == "midi-input")
+      s.midiInputs.push_back(value);
+    else if (key == "midi-output")
+      s.midiOutputs.push_back(value);
+    // unknown keys are from newer versions and skipped
+  }
+}
+
+struct Reader
+{
+  const uint8_t *p;
+  uint64_t remaining;
+
+  bool get32(uint32_t &v)
+  {
+    if (remaining < 4) return false;
+    v = 0;
+    for (int i = 0; i < 4; ++i) v |= (uint32_t)p[i] << (8 * i);
+    p += 4;
+    remaining -= 4;
+    return true;
+  }
+  bool get64(uint64_t &v)
+  {
+    if (remaining < 8) return false;
+    v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)p[i] << (8 * i);
+    p += 8;
+    remaining -= 8;
+    return true;
+  }
+  bool getBytes(uint64_t n, const uint8_t *&out)
+  {
+    if (remaining < n) return false;
+    out = p;
+    p += n;
+    remaining -= n;
+    return true;
+  }
+  bool getString(std::string &s)
+  {
+    uint32_t n;
+    const uint8_t *b;
+    if (!get32(n) || !getBytes(n, b)) return false;
+    s.assign((const char *)b, n);
+    return true;
+  }
+};
+
+int64_t ofstreamWrite(const clap_ostream *s, const void *buffer, uint64_t size)
+{
+  auto ofs = static_cast<std::ofstream *>(s->ctx);
+  ofs->write((const char *)buffer, (std::streamsize)size);
+  if (!ofs->good()) return -1;
+  return (int64_t)size;
+}
+
+// the data of a closed file to the disk, so the rename can't outlive it on a power loss
+bool syncFile(const fs::path &path)
+{
+#if WIN
+  auto file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  auto ok = FlushFileBuffers(file) != 0;
+  CloseHandle(file);
+  return ok;
+#else
+  auto fd = open(path.c_str(), O_RDWR);
+  if (fd < 0) return false;
+#ifdef F_FULLFSYNC
+  // fsync on macOS leaves the data in the drive cache
+  auto ok = fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0;
+#else
+  auto ok = fsync(fd) == 0;
+#endif
+  close(fd);
+  return ok;
+#endif
+}
+
+// the rename itself, where the directory entry lives
+void syncDirectory(const fs::path &dir)
+{
+#if !WIN
+  auto fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  fsync(fd);
+  close(fd);
+#else
+  (void)dir;
+#endif
+}
+}  // namespace
+
+bool writeSettingsFile(const fs::path &path, const StandaloneSettings &standalone,
+                       const std::string &pluginId, const std::string &pluginVersion,
+                       const std::function<bool(const clap_ostream_t *)> &saveState)
+{
+  auto tmp = path;
+  tmp += ".tmp";
+
+  {
+    std::ofstream ofs(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open())
+    {
+      LOGINFO("[ERROR] Unable to open for writing '{}'", tmp.u8string());
+      return false;
+    }
+
+    ofs.write(magic, sizeof(magic));
+    put32(ofs, formatVersion);
+    put32(ofs, 0);  // flags, none yet
+
+    auto section = standaloneSection(standalone);
+    put64(ofs, section.size());
+    ofs.write(section.data(), section.size());
+
+    putString(ofs, pluginId);
+    putString(ofs, pluginVersion);
+
+    // the state size is only known once the plugin streamed it, so patch it in afterwards
+    auto sizePos = ofs.tellp();
+    put64(ofs, 0);
+    auto statePos = ofs.tellp();
+
+    clap_ostream cos{};
+    cos.ctx = &ofs;
+    cos.write = ofstreamWrite;
+    if (!saveState(&cos) || !ofs.good())
+    {
+      LOGINFO("[ERROR] Plugin did not save its state into '{}'", path.u8string());
+      ofs.close();
+      std::error_code ec;
+      fs::remove(tmp, ec);
+      return false;
+    }
+
+    auto endPos = ofs.tellp();
+    ofs.seekp(sizePos);
+    put64(ofs, (uint64_t)(endPos - statePos));
+    ofs.close();
+    if (ofs.fail() || !syncFile(tmp))
+    {
+      LOGINFO("[ERROR] Unable to write '{}'", tmp.u8string());
+      std::error_code ec;
+      fs::remove(tmp, ec);
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec)
+  {
+    LOGINFO("[ERROR] Unable to replace '{}' : {}", path.u8string(), ec.message());
+    fs::remove(tmp, ec);
+    return false;
+  }
+  syncDirectory(path.parent_path());
+  return true;
+}
+
+MappedSettingsFile::~MappedSettingsFile()
+{
+  unmap();
+}
+
+bool MappedSettingsFile::open(const fs::path &path)
+{
+  unmap();
+  if (!map(path)) return false;
+  if (!parse())
+  {
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+bool MappedSettingsFile::map(const fs::path &path)
+{
+#if WIN
+  auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  fileHandle = file;
+  mappingHandle = mapping;
+  data = static_cast<const uint8_t *>(view);
+  size = (uint64_t)fileSize.QuadPart;
+  return true;
+#else
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  auto view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // the mapping keeps the file alive
+  if (view == MAP_FAILED) return false;
+
+  data = static_cast<const uint8_t *>(view);
+  size = (uint64_t)st.st_size;
+  return true;
+#endif
+}
+
+void MappedSettingsFile::unmap()
+{
+  if (data)
+  {
+#if WIN
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(data), (size_t)size);
+#endif
+  }
+  data = nullptr;
+  size = 0;
+  state = nullptr;
+  stateSize = 0;
+  statePos = 0;
+  legacy = false;
+  standalone = StandaloneSettings();
+  id.clear();
+  version.clear();
+}
+
+bool MappedSettingsFile::parse()
+{
+  if (size < sizeof(magic) || memcmp(data, magic, sizeof(magic)) != 0)
+  {
+    // no envelope, the whole file is the plugin state
+    legacy = true;
+    state = data;
+    stateSize = size;
+    return true;
+  }
+
+  Reader r{data + sizeof(magic), size - sizeof(magic)};
+  uint32_t fileVersion, flags;
+  if (!r.get32(fileVersion) || !r.get32(flags)) return false;
+  if (fileVersion > formatVersion)
+  {
+    LOGINFO("[ERROR] Settings file version {} is newer than this standalone", fileVersion);
+    return false;
+  }
+
+  uint64_t sectionSize;
+  const uint8_t *section;
+  if (!r.get64(sectionSize) || !r.getBytes(sectionSize, section)) return false;
+  parseStandaloneSection(std::string((const char *)section, (size_t)sectionSize), standalone);
+
+  if (!r.getString(id) || !r.getString(version)) return false;
+  if (!r.get64(stateSize) || !r.getBytes(stateSize, state)) return false;
+  return true;
+}
+
+const clap_istream_t *MappedSettingsFile::pluginState()
+{
+  statePos = 0;
+  return &istream;
+}
+
+int64_t MappedSettingsFile::read(const struct clap_istream *stream, void *buffer, uint64_t size)
+{
+  auto self = static_cast<MappedSettingsFile *>(stream->ctx);
+  auto n = std::min<uint64_t>(size, self->stateSize - self->statePos);
+  if (n > 0) memcpy(buffer, self->state + self->statePos, n);
+  self->statePos += n;
+  return (int64_t)n;
+}
+
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ * The .clapwrapper settings file of the standalone.
+ *
+ * A file is an envelope around the streamed plugin state:
+ *
+ *   - the magic "CLAPWRAP", a format version and a flags word
+ *   - the standalone section: length prefixed "key=value" lines with the audio and MIDI setup
+ *   - the id and version of the plugin which wrote the state, each length prefixed
+ *   - the length prefixed plugin state
+ *
+ * All numbers are little endian. Files are written next to their destination, flushed to
+ * the disk and renamed into place, so a crash or power loss while saving never leaves a
+ * truncated settings file behind. They are read through a memory mapping and the plugin
+ * streams its state straight out of it.
+ *
+ * Files written before the envelope existed are the raw plugin state and still load.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <clap/clap.h>
+
+#include "detail/os/fs.h"
+#include "standalone_routing.h"
+
+namespace freeaudio::clap_wrapper::standalone
+{
+struct StandaloneSettings
+{
+  // a file might only carry the plugin state, like the defaults written at first launch
+  bool hasAudio{false};
+  std::string audioApi;
+  std::string audioInputDevice, audioOutputDevice;
+  bool audioInputUsed{true}, audioOutputUsed{true};
+  int32_t sampleRate{0};
+  uint32_t bufferSize{0};
+  // empty for the default routing
+  std::vector<AudioRoute> inputRoutes, outputRoutes;
+
+  bool hasMidi{false};
+  // only a selection the user made is stored, without one every input is bound
+  bool midiInputsSelected{false};
+  std::vector<std::string> midiInputs;
+  // empty for a virtual output port
+  std::vector<std::string> midiOutputs;
+};
+
+bool writeSettingsFile(const fs::path &path, const StandaloneSettings &standalone,
+                       const std::string &pluginId, const std::string &pluginVersion,
+                       const std::function<bool(const clap_ostream_t *)> &saveState);
+
+class MappedSettingsFile
+{
+ public:
+  MappedSettingsFile() = default;
+  ~MappedSettingsFile();
+  MappedSettingsFile(const MappedSettingsFile &) = delete;
+  MappedSettingsFile &operator=(const MappedSettingsFile &) = delete;
+
+  // maps the file and parses the envelope. Returns false if it can't be read.
+  bool open(const fs::path &path);
+
+  bool isLegacy() const
+  {
+    return legacy;
+  }
+  const StandaloneSettings &standaloneSettings() const
+  {
+    return standalone;
+  }
+  const std::string &pluginId() const
+  {
+    return id;
+  }
+  const std::string &pluginVersion() const
+  {
+    return version;
+  }
+
+  // a stream over the plugin state inside the mapping, rewound on every call
+  const clap_istream_t *pluginState();
+
+ private:
+  static int64_t read(const struct clap_istream *stream, void *buffer, uint64_t size);
+  bool map(const fs::path &path);
+  void unmap();
+  bool parse();
+
+  const uint8_t *data{nullptr};
+  uint64_t size{0};
+#if WIN
+  void *fileHandle{nullptr};
+  void *mappingHandle{nullptr};
+#endif
+
+  bool legacy{false};
+  StandaloneSettings standalone;
+  std::string id, version;
+  const uint8_t *state{nullptr};
+  uint64_t stateSize{0}, statePos{0};
+  clap_istream_t istream{this, read};
+};
+
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,222 @@
+#include "standalone_telemetry.h"
+#include "standalone_details.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace
+{
+void relaxedMax(std::atomic<double> &a, double v)
+{
+  auto cur = a.load(std::memory_order_relaxed);
+  while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+  {
+  }
+}
+}  // namespace
+
+AudioTelemetry::~AudioTelemetry()
+{
+  stop();
+}
+
+int64_t AudioTelemetry::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void AudioTelemetry::start(int32_t sr, uint32_t bs, uint32_t logSeconds)
+{
+  stop();
+
+  sampleRate = sr;
+  blockSize = bs;
+  startNs = now();
+  for (auto *c : {&callbacks, &overruns, &totalNs, &deadlineNs, &inputOverflows, &outputUnderflows,
+                  &reportedXruns, &xrunCount})
+  {
+    c->store(0);
+  }
+  maxCallbackNs = 0;
+  maxLoad = recentLoad = peakLoad = 0;
+  for (auto &h : histogram) h.store(0);
+
+  if (logSeconds == 0) return;
+  reporterRunning = true;
+  reporter = std::thread([this, logSeconds]() { reportLoop(logSeconds); });
+}
+
+void AudioTelemetry::stop()
+{
+  {
+    std::lock_guard<std::mutex> g(reporterMutex);
+    reporterRunning = false;
+  }
+  reporterWake.notify_all();
+  if (reporter.joinable()) reporter.join();
+}
+
+void AudioTelemetry::callbackDone(int64_t started, uint32_t frames, uint8_t xrunKind)
+{
+  auto sr = sampleRate.load(std::memory_order_relaxed);
+  if (sr <= 0 || frames == 0) return;
+
+  auto ended = now();
+  auto took = std::max<int64_t>(0, ended - started);
+  auto deadline = (int64_t)frames * 1'000'000'000 / sr;
+  auto load = (double)took / (double)deadline;
+
+  // one writer, so plain loads and stores are enough
+  auto add = [](std::atomic<uint64_t> &a, uint64_t v)
+  { a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed); };
+  add(callbacks, 1);
+  add(totalNs, (uint64_t)took);
+  add(deadlineNs, (uint64_t)deadline);
+  if (took > deadline) add(overruns, 1);
+  if (took > maxCallbackNs.load(std::memory_order_relaxed))
+    maxCallbackNs.store(took, std::memory_order_relaxed);
+  auto bucket = std::min<uint32_t>(loadBuckets - 1, (uint32_t)(load * 100.0 / bucketPercent));
+  add(histogram[bucket], 1);
+
+  relaxedMax(maxLoad, load);
+  relaxedMax(peakLoad, load);
+  auto recent = recentLoad.load(std::memory_order_relaxed);
+  recentLoad.store(recent + (load - recent) * 0.05, std::memory_order_relaxed);
+
+  if (xrunKind)
+  {
+    if (xrunKind & INPUT_OVERFLOW) add(inputOverflows, 1);
+    if (xrunKind & OUTPUT_UNDERFLOW) add(outputUnderflows, 1);
+    auto n = xrunCount.load(std::memory_order_relaxed);
+    xrunTimes[n % xrunHistory].store(started - startNs.load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+    xrunKinds[n % xrunHistory].store(xrunKind, std::memory_order_relaxed);
+    xrunCount.store(n + 1, std::memory_order_release);
+  }
+}
+
+AudioTelemetry::Snapshot AudioTelemetry::snapshot() const
+{
+  Snapshot s;
+  s.sampleRate = sampleRate;
+  s.blockSize = blockSize;
+  s.seconds = (double)(now() - startNs) * 1e-9;
+  s.callbacks = callbacks;
+  s.overruns = overruns;
+  s.inputOverflows = inputOverflows;
+  s.outputUnderflows = outputUnderflows;
+  s.reportedXruns = reportedXruns;
+  auto deadlines = deadlineNs.load();
+  s.meanLoad = deadlines ? (double)totalNs / (double)deadlines : 0;
+  s.maxLoad = maxLoad;
+  s.recentLoad = recentLoad;
+  s.maxCallbackNs = maxCallbackNs;
+  for (auto i = 0U; i < loadBuckets; ++i) s.histogram[i] = histogram[i];
+
+  // entries being overwritten while this runs may be off, which a readout can live with
+  auto n = xrunCount.load(std::memory_order_acquire);
+  for (auto i = n > xrunHistory ? n - xrunHistory : 0; i < n; ++i)
+  {
+    s.xruns.push_back({(double)xrunTimes[i % xrunHistory] * 1e-9, xrunKinds[i % xrunHistory]});
+  }
+  return s;
+}
+
+double AudioTelemetry::takePeakLoad()
+{
+  return peakLoad.exchange(0);
+}
+
+double AudioTelemetry::Snapshot::loadPercentile(double fraction) const
+{
+  if (callbacks == 0) return 0;
+  uint64_t seen = 0;
+  for (auto i = 0U; i < loadBuckets; ++i)
+  {
+    seen += histogram[i];
+    if ((double)seen >= fraction * (double)callbacks) return (i + 1) * bucketPercent / 100.0;
+  }
+  return maxLoad;
+}
+
+std::string AudioTelemetry::summary(const Snapshot &s)
+{
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "Audio: DSP load %.1f%% (mean %.1f%%, 99%% below %.0f%%, max %.1f%%), %llu callbacks, "
+           "%llu over their deadline, xruns %llu in %llu out %llu reported",
+           s.recentLoad * 100, s.meanLoad * 100, s.loadPercentile(0.99) * 100, s.maxLoad * 100,
+           (unsigned long long)s.callbacks, (unsigned long long)s.overruns,
+           (unsigned long long)s.inputOverflows, (unsigned long long)s.outputUnderflows,
+           (unsigned long long)s.reportedXruns);
+  return buf;
+}
+
+std::string AudioTelemetry::toJson(const Snapshot &s)
+{
+  std::ostringstream oss;
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "{\n  \"sampleRate\": %d, \"blockSize\": %u, \"seconds\": %.3f, \"callbacks\": %llu,\n"
+           "  \"load\": {\"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"p999\": %.4f, \"max\": %.4f},\n"
+           "  \"maxCallbackNs\": %lld, \"deadlineNs\": %lld, \"overruns\": %llu,\n"
+           "  \"xruns\": {\"inputOverflows\": %llu, \"outputUnderflows\": %llu, \"reported\": %llu, "
+           "\"events\": [",
+           s.sampleRate, s.blockSize, s.seconds, (unsigned long long)s.callbacks, s.meanLoad,
+           s.loadPercentile(0.5), s.loadPercentile(0.99), s.loadPercentile(0.999), s.maxLoad,
+           (long long)s.maxCallbackNs,
+           s.sampleRate > 0 ? (long long)s.blockSize * 1'000'000'000 / s.sampleRate : 0LL,
+           (unsigned long long)s.overruns, (unsigned long long)s.inputOverflows,
+           (unsigned long long)s.outputUnderflows, (unsigned long long)s.reportedXruns);
+  oss << buf;
+  for (auto i = 0U; i < s.xruns.size(); ++i)
+  {
+    const auto &x = s.xruns[i];
+    snprintf(buf, sizeof(buf), "%s{\"seconds\": %.6f, \"input\": %s, \"output\": %s}", i ? ", " : "",
+             x.seconds, (x.kinds & INPUT_OVERFLOW) ? "true" : "false",
+             (x.kinds & OUTPUT_UNDERFLOW) ? "true" : "false");
+    oss << buf;
+  }
+  oss << "]},\n  \"loadHistogram\": {\"bucketPercent\": " << bucketPercent << ", \"counts\": [";
+  for (auto i = 0U; i < loadBuckets; ++i) oss << (i ? ", " : "") << s.histogram[i];
+  oss << "]}\n}\n";
+  return oss.str();
+}
+
+bool AudioTelemetry::writeJson(const std::string &path, const std::vector<Snapshot> &streams)
+{
+  std::ofstream out(path);
+  out << "{\"streams\": [\n";
+  for (auto i = 0U; i < streams.size(); ++i)
+  {
+    auto record = toJson(streams[i]);
+    record.pop_back();  // the newline, the comma goes before it
+    out << record << (i + 1 < streams.size() ? ",\n" : "\n");
+  }
+  out << "]}\n";
+  if (!out)
+  {
+    LOGINFO("[ERROR] Can't write the audio telemetry to '{}'", path);
+    return false;
+  }
+  LOGDETAIL("Audio telemetry of {} streams written to '{}'", streams.size(), path);
+  return true;
+}
+
+void AudioTelemetry::reportLoop(uint32_t logSeconds)
+{
+  std::unique_lock<std::mutex> lock(reporterMutex);
+  auto stopped = [this]() { return !reporterRunning; };
+  while (!reporterWake.wait_for(lock, std::chrono::seconds(logSeconds), stopped))
+  {
+    LOGINFO("{}", summary(snapshot()));
+  }
+}
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,113 @@
+#pragma once
+
+/*
+ * How the audio callbacks of the standalone keep up with the device.
+ *
+ * Every callback is timed against its deadline, the block period, and counted into a
+ * histogram of the DSP load (time taken / period) in 2% buckets. Callbacks over their
+ * deadline are overruns. Xruns the driver flags on a callback are counted and kept, with
+ * when they happened, in a short history; the ones only reported through the error
+ * callback are counted apart.
+ *
+ * The audio thread writes with relaxed atomics only. Any other thread can take a Snapshot
+ * at any time, which is how the GTK title and the periodic log line get at them. The host
+ * keeps the snapshot of every stream it stopped and writes them all to the JSON on exit, so a
+ * device or sample rate switch doesn't lose the xruns of the streams before it.
+ */
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+class AudioTelemetry
+{
+ public:
+  static constexpr uint32_t loadBuckets{100};
+  static constexpr double bucketPercent{2.0};  // the last bucket holds everything above
+  static constexpr uint32_t xrunHistory{256};
+
+  enum XrunKind : uint8_t
+  {
+    INPUT_OVERFLOW = 1,
+    OUTPUT_UNDERFLOW = 2
+  };
+
+  struct Xrun
+  {
+    double seconds;  // since the stream started
+    uint8_t kinds;
+  };
+
+  struct Snapshot
+  {
+    int32_t sampleRate{0};
+    uint32_t blockSize{0};
+    double seconds{0};
+    uint64_t callbacks{0}, overruns{0};
+    uint64_t inputOverflows{0}, outputUnderflows{0}, reportedXruns{0};
+    double meanLoad{0}, maxLoad{0}, recentLoad{0};
+    int64_t maxCallbackNs{0};
+    std::array<uint64_t, loadBuckets> histogram{};
+    std::vector<Xrun> xruns;
+
+    // the load at or below which the given fraction of callbacks stayed, from the histogram
+    double loadPercentile(double fraction) const;
+  };
+
+  AudioTelemetry() = default;
+  ~AudioTelemetry();
+  AudioTelemetry(const AudioTelemetry &) = delete;
+  AudioTelemetry &operator=(const AudioTelemetry &) = delete;
+
+  // main thread, around a stream. logSeconds 0 logs no periodic line.
+  void start(int32_t sampleRate, uint32_t blockSize, uint32_t logSeconds);
+  void stop();
+
+  // audio thread, around the processing of every callback
+  static int64_t now();
+  void callbackDone(int64_t started, uint32_t frames, uint8_t xrunKind);
+
+  // any thread
+  void reportedXrun()
+  {
+    reportedXruns.fetch_add(1, std::memory_order_relaxed);
+  }
+  Snapshot snapshot() const;
+  // the highest load since the last call, for a readout updated now and then
+  double takePeakLoad();
+
+  static std::string summary(const Snapshot &s);
+  static std::string toJson(const Snapshot &s);
+  // {"streams": [...]} with one record per stream, in the order they ran
+  static bool writeJson(const std::string &path, const std::vector<Snapshot> &streams);
+
+ private:
+  void reportLoop(uint32_t logSeconds);
+
+  std::atomic<int32_t> sampleRate{0};
+  std::atomic<uint32_t> blockSize{0};
+  std::atomic<int64_t> startNs{0};
+
+  std::atomic<uint64_t> callbacks{0}, overruns{0}, totalNs{0}, deadlineNs{0};
+  std::atomic<uint64_t> inputOverflows{0}, outputUnderflows{0}, reportedXruns{0};
+  std::atomic<int64_t> maxCallbackNs{0};
+  std::atomic<double> maxLoad{0}, recentLoad{0}, peakLoad{0};
+  std::array<std::atomic<uint64_t>, loadBuckets> histogram{};
+
+  std::array<std::atomic<int64_t>, xrunHistory> xrunTimes{};
+  std::array<std::atomic<uint8_t>, xrunHistory> xrunKinds{};
+  std::atomic<uint64_t> xrunCount{0};
+
+  std::thread reporter;
+  std::mutex reporterMutex;
+  std::condition_variable reporterWake;
+  bool reporterRunning{false};
+};
+}  // namespace freeaudio::clap_wrapper::standalone
@@ -0,0 +1,280 @@
+#include "standalone_transport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+namespace
+{
+constexpr double ticksPerBeat{24.0};
+// how much of each new tick interval goes into the tick period
+constexpr double tickSmoothing{1.0 / 8.0};
+// how much of the distance to the clock is made up within one block
+constexpr double catchUp{0.1};
+// further than this from the clock and the position jumps instead of ramping
+constexpr double maxDriftBeats{0.25};
+}  // namespace
+
+TransportEngine::TransportEngine()
+{
+  for (auto e : {&event, &wrapEvent})
+  {
+    memset(e, 0, sizeof(clap_event_transport));
+    e->header.size = sizeof(clap_event_transport);
+    e->header.type = CLAP_EVENT_TRANSPORT;
+    e->header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+  }
+}
+
+void TransportEngine::setTempo(double bpm)
+{
+  requestedTempo = std::clamp(bpm, minTempo, maxTempo);
+}
+
+void TransportEngine::setTimeSignature(uint16_t numerator, uint16_t denominator)
+{
+  if (numerator == 0 || denominator == 0) return;
+  requestedSignature = ((uint32_t)numerator << 16) | denominator;
+}
+
+void TransportEngine::setPlaying(bool play)
+{
+  requestedPlaying = play;
+}
+
+void TransportEngine::setLoop(bool enabled, double startBeats, double endBeats)
+{
+  loopStart = std::max(0.0, startBeats);
+  loopEnd = std::max(0.0, endBeats);
+  loopEnabled = enabled && endBeats > startBeats;
+}
+
+void TransportEngine::locate(double beats)
+{
+  locateBeats = std::max(0.0, beats);
+  locateRequests++;
+}
+
+void TransportEngine::setSyncToMidiClock(bool sync)
+{
+  syncToMidiClock = sync;
+}
+
+bool TransportEngine::isTransportMessage(const uint8_t *data, uint32_t size)
+{
+  if (size == 0) return false;
+  switch (data[0])
+  {
+    case 0xF1:  // time code quarter frame
+    case 0xF2:  // song position pointer
+    case 0xF8:  // clock
+    case 0xFA:  // start
+    case 0xFB:  // continue
+    case 0xFC:  // stop
+      return true;
+    default:
+      return false;
+  }
+}
+
+void TransportEngine::midiMessage(int64_t timeNs, const uint8_t *data, uint32_t size)
+{
+  switch (data[0])
+  {
+    case 0xF8:
+    {
+      auto interval = (double)(timeNs - lastTickNs);
+      if (lastTickNs != 0 && interval > 0)
+      {
+        // a gap, from a stopped clock or a stall, says nothing about the tempo
+        if (tickPeriodNs <= 0)
+          tickPeriodNs = interval;
+        else if (interval < 2.0 * tickPeriodNs)
+          tickPeriodNs += (interval - tickPeriodNs) * tickSmoothing;
+      }
+      lastTickNs = timeNs;
+
+      if (clockArmed)
+      {
+        tickBeats = songPositionBeats;
+        clockArmed = false;
+      }
+      else if (clockPlaying)
+      {
+        tickBeats += 1.0 / ticksPerBeat;
+      }
+      break;
+    }
+    case 0xFA:
+      songPositionBeats = 0;
+      clockPlaying = clockArmed = true;
+      break;
+    case 0xFB:
+      clockPlaying = clockArmed = true;
+      break;
+    case 0xFC:
+      // a continue without a song position pointer resumes from here
+      songPositionBeats = tickBeats;
+      clockPlaying = clockArmed = false;
+      break;
+    case 0xF2:
+      if (size < 3) break;
+      // counted in sixteenth notes
+      songPositionBeats = (double)((data[2] << 7) | data[1]) / 4.0;
+      if (!clockPlaying)
+      {
+        tickBeats = songPositionBeats;
+        if (synced) beats = songPositionBeats;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+double TransportEngine::clockBeatsAt(int64_t timeNs) const
+{
+  if (tickPeriodNs <= 0 || lastTickNs == 0) return tickBeats;
+  // past the last tick the clock is assumed to carry on, for at most one tick
+  auto ticks = std::min(1.0, (double)(timeNs - lastTickNs) / tickPeriodNs);
+  return tickBeats + ticks / ticksPerBeat;
+}
+
+const clap_event_transport *TransportEngine::startBlock(uint32_t frames, double sampleRate,
+                                                        int64_t blockStartNs, int64_t blockEndNs)
+{
+  hasWrap = false;
+
+  auto signature = requestedSignature.load();
+  signatureNumerator = (uint16_t)(signature >> 16);
+  signatureDenominator = (uint16_t)(signature & 0xFFFF);
+
+  auto locates = locateRequests.load();
+  if (locates != locatesSeen)
+  {
+    locatesSeen = locates;
+    beats = locateBeats;
+    seconds = beats * 60.0 / tempoNow;
+  }
+
+  if (frames == 0 || sampleRate <= 0)
+  {
+    fill(event, beats, seconds, 0);
+    return &event;
+  }
+
+  synced = syncToMidiClock;
+  if (synced)
+    startBlockSynced(frames, sampleRate, blockStartNs, blockEndNs);
+  else
+    startBlockFree(frames, sampleRate);
+  return &event;
+}
+
+void TransportEngine::startBlockFree(uint32_t frames, double sampleRate)
+{
+  tempoNow = requestedTempo;
+  playing = requestedPlaying;
+  fill(event, beats, seconds, 0);
+  if (!playing) return;
+
+  auto beatsPerFrame = tempoNow / (60.0 * sampleRate);
+  auto advance = beatsPerFrame * frames;
+  double ls = loopStart, le = loopEnd;
+  if (loopEnabled && ls < le && beats < le && beats + advance >= le)
+  {
+    auto offset = (uint32_t)std::ceil((le - beats) / beatsPerFrame);
+    auto wrapped = ls + (beats + offset * beatsPerFrame - le);
+    seconds = wrapped * 60.0 / tempoNow;
+    if (offset < frames)
+    {
+      fill(wrapEvent, wrapped, seconds, 0);
+      wrapEvent.header.time = offset;
+      hasWrap = true;
+    }
+    beats = wrapped + (frames - offset) * beatsPerFrame;
+    seconds += (frames - offset) / sampleRate;
+    return;
+  }
+  beats += advance;
+  seconds += frames / sampleRate;
+}
+
+void TransportEngine::startBlockSynced(uint32_t frames, double sampleRate, int64_t blockStartNs,
+                                       int64_t blockEndNs)
+{
+  auto clockTempo = tempoNow;
+  if (tickPeriodNs > 0)
+  {
+    clockTempo = std::clamp(60e9 / (ticksPerBeat * tickPeriodNs), minTempo, maxTempo);
+  }
+
+  auto wasPlaying = playing;
+  playing = clockPlaying && !clockArmed;
+  if (!playing)
+  {
+    tempoNow = clockTempo;
+    fill(event, beats, seconds, 0);
+    return;
+  }
+
+  auto startClock = clockBeatsAt(blockStartNs);
+  if (!wasPlaying || std::fabs(startClock - beats) > maxDriftBeats)
+  {
+    beats = startClock;
+    seconds = beats * 60.0 / clockTempo;
+    tempoNow = clockTempo;
+  }
+
+  // aim for the tempo which closes part of the distance to where the clock will be at the
+  // end of the block, and ramp to it over the block
+  auto tempoToBeatsPerBlock = frames / (60.0 * sampleRate);
+  auto error = clockBeatsAt(blockEndNs) - (beats + clockTempo * tempoToBeatsPerBlock);
+  auto target = clockTempo + catchUp * error / tempoToBeatsPerBlock;
+  target = std::clamp(target, clockTempo * (1 - maxCorrection), clockTempo * (1 + maxCorrection));
+
+  fill(event, beats, seconds, (target - tempoNow) / frames);
+  beats += (tempoNow + target) * 0.5 * tempoToBeatsPerBlock;
+  seconds += frames / sampleRate;
+  tempoNow = target;
+}
+
+void TransportEngine::fill(clap_event_transport &e, double atBeats, double atSeconds,
+                           double tempoInc) const
+{
+  e.header.time = 0;
+  e.flags = CLAP_TRANSPORT_HAS_TEMPO | CLAP_TRANSPORT_HAS_BEATS_TIMELINE |
+            CLAP_TRANSPORT_HAS_SECONDS_TIMELINE | CLAP_TRANSPORT_HAS_TIME_SIGNATURE;
+  if (playing) e.flags |= CLAP_TRANSPORT_IS_PLAYING;
+
+  e.tempo = tempoNow;
+  e.tempo_inc = tempoInc;
+  e.song_pos_beats = (clap_beattime)std::llround(atBeats * CLAP_BEATTIME_FACTOR);
+  e.song_pos_seconds = (clap_sectime)std::llround(atSeconds * CLAP_SECTIME_FACTOR);
+
+  e.tsig_num = signatureNumerator;
+  e.tsig_denom = signatureDenominator;
+  auto beatsPerBar = signatureNumerator * 4.0 / signatureDenominator;
+  auto bar = std::floor(atBeats / beatsPerBar + 1e-9);
+  e.bar_number = (int32_t)bar;
+  e.bar_start = (clap_beattime)std::llround(bar * beatsPerBar * CLAP_BEATTIME_FACTOR);
+
+  // a clock master loops by moving the song position, so only the own loop is reported
+  double ls = loopStart, le = loopEnd;
+  if (loopEnabled && !synced)
+  {
+    e.flags |= CLAP_TRANSPORT_IS_LOOP_ACTIVE;
+    e.loop_start_beats = (clap_beattime)std::llround(ls * CLAP_BEATTIME_FACTOR);
+    e.loop_end_beats = (clap_beattime)std::llround(le * CLAP_BEATTIME_FACTOR);
+    e.loop_start_seconds = (clap_sectime)std::llround(ls * 60.0 / tempoNow * CLAP_SECTIME_FACTOR);
+    e.loop_end_seconds = (clap_sectime)std::llround(le * 60.0 / tempoNow * CLAP_SECTIME_FACTOR);
+  }
+  else
+  {
+    e.loop_start_beats = e.loop_end_beats = 0;
+    e.loop_start_seconds = e.loop_end_seconds = 0;
+  }
+}
+}  // namespace freeaudio::clap_wrapper::standalone
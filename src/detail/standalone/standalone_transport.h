@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+ * The transport of the standalone: tempo, time signature, play/stop, a loop, and the song
+ * position they move. Without it the plugin gets no transport at all and tempo synced
+ * effects have nothing to follow.
+ *
+ * The controls can be set from any thread and take effect at the start of the next block.
+ * Everything else runs on the audio thread, which asks for the transport of each block and
+ * never allocates.
+ *
+ * When slaved to MIDI clock the tempo comes from the spacing of the clock ticks, start,
+ * continue and stop come from the clock master, and song position pointer messages place the
+ * song position. The position advanced by the audio is steered back onto the clock by a
+ * tempo ramp over the block, reported as tempo_inc, rather than by jumping.
+ */
+
+#include <atomic>
+#include <cstdint>
+
+#include <clap/clap.h>
+
+namespace freeaudio::clap_wrapper::standalone
+{
+class TransportEngine
+{
+ public:
+  TransportEngine();
+
+  // any thread
+  void setTempo(double bpm);
+  void setTimeSignature(uint16_t numerator, uint16_t denominator);
+  void setPlaying(bool play);
+  void setLoop(bool enabled, double startBeats, double endBeats);
+  void locate(double beats);
+  void setSyncToMidiClock(bool sync);
+  double tempo() const
+  {
+    return requestedTempo;
+  }
+  bool isPlaying() const
+  {
+    return requestedPlaying;
+  }
+  bool syncsToMidiClock() const
+  {
+    return syncToMidiClock;
+  }
+
+  // clock, start, continue, stop, song position and time code messages are the transports
+  static bool isTransportMessage(const uint8_t *data, uint32_t size);
+  // audio thread, with the time the message arrived on midiClockNow()
+  void midiMessage(int64_t timeNs, const uint8_t *data, uint32_t size);
+
+  /*
+   * Audio thread, once per block after the MIDI of the block was taken in. The block plays
+   * what arrived from blockStartNs to blockEndNs, see BlockClock. Returns the transport at
+   * the first sample; if the loop wraps inside the block, loopWrap() then has the transport
+   * from the wrap on, with its sample in header.time.
+   */
+  const clap_event_transport *startBlock(uint32_t frames, double sampleRate, int64_t blockStartNs,
+                                         int64_t blockEndNs);
+  clap_event_transport *loopWrap()
+  {
+    return hasWrap ? &wrapEvent : nullptr;
+  }
+
+  static constexpr double minTempo{20.0}, maxTempo{999.0};
+  // how far the tempo may be pulled off the clock tempo to catch up with the clock
+  static constexpr double maxCorrection{0.1};
+
+ private:
+  void fill(clap_event_transport &event, double beats, double seconds, double tempoInc) const;
+  double clockBeatsAt(int64_t timeNs) const;
+  void startBlockFree(uint32_t frames, double sampleRate);
+  void startBlockSynced(uint32_t frames, double sampleRate, int64_t blockStartNs, int64_t blockEndNs);
+
+  std::atomic<double> requestedTempo{120.0};
+  std::atomic<uint32_t> requestedSignature{(4 << 16) | 4};
+  std::atomic<bool> requestedPlaying{false};
+  std::atomic<bool> loopEnabled{false};
+  std::atomic<double> loopStart{0.0}, loopEnd{4.0};
+  std::atomic<double> locateBeats{0.0};
+  std::atomic<uint32_t> locateRequests{0};
+  std::atomic<bool> syncToMidiClock{false};
+
+  // audio thread from here on
+  double beats{0}, seconds{0}, tempoNow{120.0};
+  bool playing{false}, synced{false};
+  uint16_t signatureNumerator{4}, signatureDenominator{4};
+  uint32_t locatesSeen{0};
+
+  // the clock as last heard. A start or continue waits for the next tick to play.
+  int64_t lastTickNs{0};
+  double tickPeriodNs{0};
+  double tickBeats{0}, songPositionBeats{0};
+  bool clockPlaying{false}, clockArmed{false};
+
+  clap_event_transport event{}, wrapEvent{};
+  bool hasWrap{false};
+};
+}  // namespace freeaudio::clap_wrapper::standalone
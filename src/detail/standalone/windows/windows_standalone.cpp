@@ -707,6 +707,7 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
                {
                  case Menu::Identifier::AudioMidiSettings:
                  {
+                   if (!settings.isVisible() && sah->devicesChanged) refreshDevices();
                    settings.isVisible() ? settings.hide() : settings.show();
 
                    return 0;
@@ -840,8 +841,9 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
             refreshOutputs();
             refreshInputs();
 
-            settings.output.set(sah->rtaDac->getDeviceInfo(sah->audioOutputDeviceID).name);
-            settings.input.set(sah->rtaDac->getDeviceInfo(sah->audioInputDeviceID).name);
+            if (auto device{sah->audioDevice(sah->audioOutputDeviceID)})
+              settings.output.set(device->name);
+            if (auto device{sah->audioDevice(sah->audioInputDeviceID)}) settings.input.set(device->name);
 
             refreshSampleRates();
             refreshBufferSizes();
@@ -857,9 +859,6 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
           {
             sah->audioOutputDeviceID = sah->getOutputAudioDevices()[settings.output.get()].ID;
 
-            sah->totalOutputChannels =
-                sah->getOutputAudioDevices()[settings.output.get()].outputChannels;
-
             refreshSampleRates();
             refreshBufferSizes();
 
@@ -871,8 +870,6 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
           {
             sah->audioInputDeviceID = sah->getInputAudioDevices()[settings.input.get()].ID;
 
-            sah->totalInputChannels = sah->getInputAudioDevices()[settings.input.get()].inputChannels;
-
             refreshSampleRates();
             refreshBufferSizes();
 
@@ -898,7 +895,7 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
 
             auto bufferSize{bufferSizes[settings.bufferSize.get()]};
 
-            sah->currentBufferSize = bufferSize;
+            sah->requestedBufferSize = bufferSize;
 
             saveSettings();
             startAudio();
@@ -912,35 +909,16 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
             std::vector<int> ports;
             settings.midiIn.getItems(ports);
 
-            for (auto& midiIn : sah->midiIns)
-            {
-              midiIn.reset();
-            }
-            sah->midiIns.clear();
-            sah->currentMidiPorts.clear();
+            sah->closeMIDIInputs();
 
             for (auto port : ports)
             {
-              if (ports.size() != 0)
+              if (!sah->openMIDIInput(port))
               {
-                try
-                {
-                  auto midiIn{std::make_unique<RtMidiIn>()};
-                  midiIn->openPort(port);
-                  midiIn->setCallback(sah->midiCallback, sah);
-                  sah->midiIns.push_back(std::move(midiIn));
-                  sah->currentMidiPorts.push_back(port);
-                }
-                catch (RtMidiError& error)
-                {
-                  log("{}", error.getMessage());
-                };
-              }
-              else
-              {
-                sah->stopMIDIThread();
+                log("Unable to open MIDI input {}", port);
               }
             }
+            sah->midiInputSelection = sah->currentMidiPortNames;
 
             saveSettings();
           }
@@ -963,12 +941,23 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
                return 0;
              });
 
+  // sent to top level windows when a device comes or goes, the lists are probed again the
+  // next time the settings open
+  message.on(WM_DEVICECHANGE,
+             [this](Message msg)
+             {
+               sah->invalidateDevices();
+
+               return TRUE;
+             });
+
   message.on(WM_DESTROY,
              [this](Message msg)
              {
                saveSettings();
 
                sah->onRequestResize = nullptr;
+               sah->onPluginReplaced = nullptr;
                sah->displayAudioError = nullptr;
 
                if (plugin.gui)
@@ -1056,6 +1045,66 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
     saveSettings();
   }
 
+  createGui();
+
+  sah->onRequestResize = [this](uint32_t width, uint32_t height)
+  {
+    if (placement.showCmd != SW_MAXIMIZE)
+    {
+      adjustSize(width, height);
+    }
+
+    return true;
+  };
+
+  // a sample rate change hands the audio to a second instance, whose editor replaces this one
+  sah->onPluginReplaced = [this](const auto& previous, const auto& current)
+  {
+    if (plugin.gui)
+    {
+      plugin.gui->destroy(plugin.plugin);
+    }
+
+    plugin.clap = current;
+    plugin.plugin = current->_plugin;
+    plugin.gui = current->_ext._gui;
+    plugin.state = current->_ext._state;
+
+    // the window is shown already, so no SWP_SHOWWINDOW comes for the new editor
+    if (plugin.gui)
+    {
+      createGui();
+      plugin.gui->show(plugin.plugin);
+    }
+  };
+
+  startMIDI();
+  refreshMIDIInputs();
+
+  sah->displayAudioError = [this](auto& errorText)
+  { message.error("Unable to configure audio: {}", errorText); };
+
+  refreshApis();
+  refreshOutputs();
+  refreshInputs();
+  refreshSampleRates();
+  refreshBufferSizes();
+
+  settings.api.set(sah->audioApiDisplayName);
+  if (auto device{sah->audioDevice(sah->audioOutputDeviceID)}) settings.output.set(device->name);
+  if (auto device{sah->audioDevice(sah->audioInputDeviceID)}) settings.input.set(device->name);
+  settings.sampleRate.set(std::to_string(sah->currentSampleRate));
+  settings.bufferSize.set(std::to_string(sah->currentBufferSize));
+
+  refreshLayout();
+
+  startAudio();
+
+  activate();
+}
+
+void Plugin::createGui()
+{
   if (plugin.gui)
   {
     if (plugin.gui->is_api_supported(plugin.plugin, CLAP_WINDOW_API_WIN32, false))
@@ -1099,40 +1148,6 @@ Plugin::Plugin(const clap_plugin_entry* entry, int argc, char** argv)
     adjustSize(static_cast<uint32_t>(500 * scale), 0);
     toggleCentered(true);
   }
-
-  sah->onRequestResize = [this](uint32_t width, uint32_t height)
-  {
-    if (placement.showCmd != SW_MAXIMIZE)
-    {
-      adjustSize(width, height);
-    }
-
-    return true;
-  };
-
-  startMIDI();
-  refreshMIDIInputs();
-
-  sah->displayAudioError = [this](auto& errorText)
-  { message.error("Unable to configure audio: {}", errorText); };
-
-  refreshApis();
-  refreshOutputs();
-  refreshInputs();
-  refreshSampleRates();
-  refreshBufferSizes();
-
-  settings.api.set(sah->audioApiDisplayName);
-  settings.output.set(sah->rtaDac->getDeviceInfo(sah->audioOutputDeviceID).name);
-  settings.input.set(sah->rtaDac->getDeviceInfo(sah->audioInputDeviceID).name);
-  settings.sampleRate.set(std::to_string(sah->currentSampleRate));
-  settings.bufferSize.set(std::to_string(sah->currentBufferSize));
-
-  refreshLayout();
-
-  startAudio();
-
-  activate();
 }
 
 std::optional<clap_gui_resize_hints> Plugin::getResizeHints()
@@ -1261,14 +1276,22 @@ void Plugin::refreshMIDIInputs()
 {
   settings.midiIn.reset();
 
-  auto midiIn{std::make_unique<RtMidiIn>()};
-
-  for (uint32_t port{0}; port < sah->numMidiPorts; port++)
+  for (auto& name : sah->midiInputPorts())
   {
-    settings.midiIn.add(midiIn->getPortName(port));
+    settings.midiIn.add(name);
   }
 }
 
+void Plugin::refreshDevices()
+{
+  refreshOutputs();
+  refreshInputs();
+  refreshMIDIInputs();
+
+  if (auto device{sah->audioDevice(sah->audioOutputDeviceID)}) settings.output.set(device->name);
+  if (auto device{sah->audioDevice(sah->audioInputDeviceID)}) settings.input.set(device->name);
+}
+
 bool Plugin::saveSettings()
 {
   auto settingsPath{getStandaloneSettingsPath()};
@@ -1283,7 +1306,7 @@ bool Plugin::saveSettings()
     settings.set<bool>("audioInputUsed", sah->audioInputUsed);
     settings.set<bool>("audioOutputUsed", sah->audioOutputUsed);
     settings.set<double>("currentSampleRate", sah->currentSampleRate);
-    settings.set<double>("currentBufferSize", sah->currentBufferSize);
+    settings.set<double>("currentBufferSize", sah->requestedBufferSize);
     settings.set<Position>("position", position);
 
     auto settingsFilePath{settingsPath.value() / plugin.plugin->desc->id / "settings.json"};
@@ -1329,7 +1352,7 @@ bool Plugin::loadSettings()
         sah->audioInputUsed = settings.get<bool>("audioInputUsed");
         sah->audioOutputUsed = settings.get<bool>("audioOutputUsed");
         sah->currentSampleRate = static_cast<unsigned int>(settings.get<double>("currentSampleRate"));
-        sah->currentBufferSize = static_cast<unsigned int>(settings.get<double>("currentBufferSize"));
+        sah->requestedBufferSize = static_cast<unsigned int>(settings.get<double>("currentBufferSize"));
         position = settings.get<Position>("position");
 
         return parsed;
@@ -1342,8 +1365,6 @@ bool Plugin::loadSettings()
 
 void Plugin::initializeMIDI()
 {
-  auto midiIn{std::make_unique<RtMidiIn>()};
-
   sah->currentMidiPorts.clear();
 
   for (uint32_t port{0}; port < sah->numMidiPorts; port++)
@@ -1364,21 +1385,21 @@ void Plugin::initializeAudio(RtAudio::Api api)
   auto [input, output, sampleRate]{sah->getDefaultAudioInOutSampleRate()};
 
   sah->audioInputDeviceID = input;
-  sah->totalInputChannels = sah->rtaDac->getDeviceInfo(input).inputChannels;
   sah->audioInputUsed = true;
 
   sah->audioOutputDeviceID = output;
-  sah->totalOutputChannels = sah->rtaDac->getDeviceInfo(output).outputChannels;
   sah->audioOutputUsed = true;
 
   sah->currentSampleRate = sampleRate;
-  sah->currentBufferSize = sah->getBufferSizes()[0];
+  sah->requestedBufferSize = 0;
 }
 
 void Plugin::startAudio()
 {
-  sah->startAudioThreadOn(sah->audioInputDeviceID, sah->totalInputChannels, sah->audioInputUsed,
-                          sah->audioOutputDeviceID, sah->totalOutputChannels, sah->audioOutputUsed,
+  // all channels of the devices, the audio routing picks the ones the plugin uses
+  auto channels = (uint32_t)StandaloneHost::utilityBufferMaxChannels;
+  sah->startAudioThreadOn(sah->audioInputDeviceID, channels, sah->audioInputUsed,
+                          sah->audioOutputDeviceID, channels, sah->audioOutputUsed,
                           sah->currentSampleRate);
 }
 }  // namespace freeaudio::clap_wrapper::standalone::windows_standalone
@@ -374,6 +374,7 @@ struct Plugin final : public Window
 
   explicit Plugin(const clap_plugin_entry* entry, int argc, char** argv);
 
+  void createGui();
   std::optional<clap_gui_resize_hints> getResizeHints();
   void refreshLayout();
   void refreshApis();
@@ -382,6 +383,7 @@ struct Plugin final : public Window
   void refreshSampleRates();
   void refreshBufferSizes();
   void refreshMIDIInputs();
+  void refreshDevices();
 
   bool saveSettings();
   bool loadSettings();
@@ -0,0 +1,270 @@
+/*
+ * The vst3 build helper loads the CLAP a VST3 wrapper is built for and runs the factory
+ * logic of the wrapper once, at build time. It writes
+ *
+ *   - moduleinfo.json, which goes into the bundles Contents/Resources so hosts supporting
+ *     it can scan the plugin without loading the binary
+ *   - generated_vst3_classinfo.hxx, the class ids and sub categories as a table the factory
+ *     uses instead of hashing the plugin ids again on every scan
+ *
+ * into the current directory.
+ *
+ * usage: build-helper --fromclap <clapfile> <bundle-name> <bundle-version> [single-plugin-tuid]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+
+#include "detail/clap/fsutil.h"
+#include "detail/os/fs.h"
+#include "detail/vst3/classinfo.h"
+
+#include "pluginterfaces/vst/vsttypes.h"
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+
+using ClapWrapper::detail::vst3::FactoryInfo;
+
+static std::string jsonEscape(const std::string &s)
+{
+  std::string res;
+  for (auto c : s)
+  {
+    switch (c)
+    {
+      case '"':
+        res += "\\\"";
+        break;
+      case '\\':
+        res += "\\\\";
+        break;
+      case '\n':
+        res += "\\n";
+        break;
+      case '\t':
+        res += "\\t";
+        break;
+      default:
+        if ((unsigned char)c < 0x20)
+        {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", (unsigned int)(unsigned char)c);
+          res += buf;
+        }
+        else
+        {
+          res += c;
+        }
+    }
+  }
+  return res;
+}
+
+// json and c++ string literals escape the same things for our purposes, except
+// that c++ has no \u escapes for control characters
+static std::string cppEscape(const std::string &s)
+{
+  std::string res;
+  for (auto c : s)
+  {
+    if (c == '"' || c == '\\')
+    {
+      res += '\\';
+      res += c;
+    }
+    else if ((unsigned char)c < 0x20)
+    {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\%03o", (unsigned int)(unsigned char)c);
+      res += buf;
+    }
+    else
+    {
+      res += c;
+    }
+  }
+  return res;
+}
+
+// the moduleinfo CID format: the 16 bytes of the class id in memory order as upper case hex
+static std::string cidString(const Steinberg::TUID &cid)
+{
+  std::string res;
+  char buf[4];
+  for (auto i = 0U; i < sizeof(Steinberg::TUID); ++i)
+  {
+    snprintf(buf, sizeof(buf), "%02X", (unsigned int)(uint8_t)cid[i]);
+    res += buf;
+  }
+  return res;
+}
+
+static void writeModuleInfo(std::ostream &of, const FactoryInfo &info, const std::string &name,
+                            const std::string &version)
+{
+  of << "{\n"
+     << "  \"Name\": \"" << jsonEscape(name) << "\",\n"
+     << "  \"Version\": \"" << jsonEscape(version) << "\",\n"
+     << "  \"Factory Info\": {\n"
+     << "    \"Vendor\": \"" << jsonEscape(info.vendor) << "\",\n"
+     << "    \"URL\": \"" << jsonEscape(info.url) << "\",\n"
+     << "    \"E-Mail\": \"" << jsonEscape(info.email) << "\",\n"
+     << "    \"Flags\": {\n"
+     << "      \"Unicode\": true,\n"
+     << "      \"Classes Discardable\": false,\n"
+     << "      \"License Check\": false,\n"
+     << "      \"Component Non Discardable\": false\n"
+     << "    }\n"
+     << "  },\n"
+     << "  \"Compatibility\": [],\n"
+     << "  \"Classes\": [\n";
+
+  for (auto i = 0U; i < info.classes.size(); ++i)
+  {
+    const auto &c = info.classes[i];
+    of << "    {\n"
+       << "      \"CID\": \"" << cidString(c.cid) << "\",\n"
+       << "      \"Category\": \"" << jsonEscape(c.category) << "\",\n"
+       << "      \"Name\": \"" << jsonEscape(c.name) << "\",\n"
+       << "      \"Vendor\": \"" << jsonEscape(c.vendor) << "\",\n"
+       << "      \"Version\": \"" << jsonEscape(c.version) << "\",\n"
+       << "      \"SDKVersion\": \"" << kVstVersionString << "\",\n"
+       << "      \"Sub Categories\": [";
+
+    // sub categories are '|' separated in the factory and an array in the moduleinfo
+    std::stringstream ss(c.subCategories);
+    std::string item;
+    bool first = true;
+    while (std::getline(ss, item, '|'))
+    {
+      if (item.empty()) continue;
+      of << (first ? "\n" : ",\n") << "        \"" << jsonEscape(item) << "\"";
+      first = false;
+    }
+    of << (first ? "],\n" : "\n      ],\n");
+
+    of << "      \"Class Flags\": 0,\n"
+       << "      \"Cardinality\": 2147483647,\n"
+       << "      \"Snapshots\": []\n"
+       << "    }" << (i + 1 < info.classes.size() ? "," : "") << "\n";
+  }
+  of << "  ]\n}\n";
+}
+
+static void writeClassTable(std::ostream &of, const FactoryInfo &info)
+{
+  of << "// generated by the clap-wrapper vst3 build helper. do not edit\n"
+     << "#pragma once\n\n"
+     << "#include \"detail/vst3/classinfo.h\"\n\n"
+     << "namespace ClapWrapper::detail::vst3::generated\n{\n"
+     << "static const GeneratedClassInfo classes[] = {\n";
+  for (const auto &c : info.classes)
+  {
+    of << "    {\"" << cppEscape(c.clapId) << "\", " << c.index << ", {";
+    for (auto i = 0U; i < sizeof(Steinberg::TUID); ++i)
+    {
+      of << (i ? ", " : "") << (unsigned int)(uint8_t)c.cid[i];
+    }
+    of << "}, \"" << cppEscape(c.category) << "\", \"" << cppEscape(c.name) << "\", \""
+       << cppEscape(c.vendor) << "\", \"" << cppEscape(c.version) << "\", \""
+       << cppEscape(c.subCategories) << "\"},\n";
+  }
+  of << "};\n\n"
+     << "static const GeneratedFactoryInfo factoryInfo = {\"" << cppEscape(info.vendor) << "\", \""
+     << cppEscape(info.url) << "\", \"" << cppEscape(info.email) << "\", classes, "
+     << info.classes.size() << "};\n"
+     << "}  // namespace ClapWrapper::detail::vst3::generated\n";
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) return 1;
+
+  std::cout << "clap-wrapper: vst3 configuration tool starting\n";
+
+  if (std::string(argv[1]) != "--fromclap")
+  {
+    std::cout << "[ERROR] Unknown Mode : " << argv[1] << std::endl;
+    return 2;
+  }
+
+  if (argc < 5)
+  {
+    std::cout << "[ERROR] Configuration incorrect. Got " << argc << " arguments in fromclap"
+              << std::endl;
+    return 6;
+  }
+
+  int idx = 2;
+  auto clapfile = std::string(argv[idx++]);
+  auto bundlename = std::string(argv[idx++]);
+  auto bundlev = std::string(argv[idx++]);
+  const char *singlePluginTUID = (idx < argc && argv[idx][0] != 0) ? argv[idx] : nullptr;
+
+#if MAC
+  try
+  {
+    auto p = fs::path{clapfile};
+    if (!fs::is_directory(p))
+    {
+      // This is a hack for now - we get to the dll
+      std::cout << "  - CLAP is a regular file. Assuming dll in bundle\n";
+      clapfile = p.parent_path().parent_path().parent_path().u8string();
+    }
+  }
+  catch (const fs::filesystem_error &e)
+  {
+    std::cout << "[ERROR] cant get path " << e.what() << std::endl;
+    return 3;
+  }
+#endif
+
+  std::cout << "  - building information from CLAP directly\n"
+            << "  - source clap: '" << clapfile << "'" << std::endl;
+
+  Clap::Library loader;
+  if (!loader.load(clapfile))
+  {
+    std::cout << "[ERROR] library did not load" << std::endl;
+    return 4;
+  }
+
+  FactoryInfo info;
+  if (!ClapWrapper::detail::vst3::buildFactoryInfo(loader, singlePluginTUID, info) || info.classes.empty())
+  {
+    std::cout << "[ERROR] No classes from clap file\n";
+    return 5;
+  }
+
+  for (const auto &c : info.classes)
+  {
+    std::cout << "    + " << c.name << " (" << c.category << ") " << cidString(c.cid) << " ["
+              << c.subCategories << "]" << std::endl;
+  }
+
+  std::cout << "  - generating moduleinfo.json" << std::endl;
+  {
+    std::ofstream of("moduleinfo.json");
+    if (!of.is_open())
+    {
+      std::cerr << "[ERROR] Unable to open output file moduleinfo.json" << std::endl;
+      return 1;
+    }
+    writeModuleInfo(of, info, bundlename, bundlev);
+  }
+
+  std::cout << "  - generating generated_vst3_classinfo.hxx" << std::endl;
+  {
+    std::ofstream of("generated_vst3_classinfo.hxx");
+    if (!of.is_open())
+    {
+      std::cerr << "[ERROR] Unable to open output file generated_vst3_classinfo.hxx" << std::endl;
+      return 1;
+    }
+    writeClassTable(of, info);
+  }
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+/*
+    VST3 class information for the plugins of a CLAP library
+
+    Copyright (c) 2022 Timo Kaluza (defiantnerd)
+
+    This file is part of the clap-wrappers project which is released under MIT License.
+    See file LICENSE or go to https://github.com/free-audio/clap-wrapper for full license details.
+*/
+
+#include "classinfo.h"
+
+#include <cstring>
+#include <utility>
+
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+#include "pluginterfaces/base/funknown.h"
+
+#include "detail/clap/fsutil.h"
+#include "detail/ara/ara.h"
+#include "detail/shared/sha1.h"
+#include "detail/vst3/categories.h"
+#include "detail/os/log.h"
+
+namespace ClapWrapper::detail::vst3
+{
+
+static const GeneratedClassInfo* findGenerated(const GeneratedFactoryInfo* generated, const char* clapId,
+                                               const char* category)
+{
+  if (!generated) return nullptr;
+  for (uint32_t i = 0; i < generated->classCount; ++i)
+  {
+    auto& g = generated->classes[i];
+    if (!strcmp(g.clapId, clapId) && !strcmp(g.category, category)) return &g;
+  }
+  return nullptr;
+}
+
+static std::string displayName(const char* name)
+{
+  std::string n(name);
+#ifdef _DEBUG
+  n.append(" (CLAP->VST3)");
+#endif
+  return n;
+}
+
+bool buildFactoryInfo(const Clap::Library& lib, const char* singlePluginTUID, FactoryInfo& info,
+                      const GeneratedFactoryInfo* generated)
+{
+  info = FactoryInfo();
+  if (lib.plugins.empty()) return false;
+
+  // we need at least one plugin to obtain vendor/name etc.
+  info.vendor = lib.plugins[0]->vendor ? lib.plugins[0]->vendor : "";
+  info.url = lib.plugins[0]->url ? lib.plugins[0]->url : "";
+  // TODO: extract the domain and prefix with info@
+  info.email = "info@";
+
+  // override for VST3 specifics
+  if (lib._pluginFactoryVst3Info)
+  {
+    LOGDETAIL("detected extension `{}`", CLAP_PLUGIN_FACTORY_INFO_VST3);
+    auto& v3 = lib._pluginFactoryVst3Info;
+    if (v3->vendor) info.vendor = v3->vendor;
+    if (v3->vendor_url) info.url = v3->vendor_url;
+    if (v3->email_contact) info.email = v3->email_contact;
+  }
+
+  int numPlugins = static_cast<int>(lib.plugins.size());
+  LOGDETAIL("number of plugins in factory: {}", numPlugins);
+  for (int ctr = 0; ctr < numPlugins; ++ctr)
+  {
+    auto& clapdescr = lib.plugins[ctr];
+    auto vst3info = lib.get_vst3_info(ctr);
+
+    LOGDETAIL("  plugin #{}: '{}'", ctr, clapdescr->name);
+
+    ClassInfo ci;
+    ci.clapId = clapdescr->id;
+    ci.index = ctr;
+    ci.category = kVstAudioEffectClass;
+    ci.name = displayName(clapdescr->name);
+    ci.version = clapdescr->version ? clapdescr->version : "";
+
+    // get vendor -------------------------------------
+    auto pluginvendor = clapdescr->vendor;
+    if (pluginvendor == nullptr || *pluginvendor == 0) pluginvendor = "Unspecified Vendor";
+    if (vst3info && vst3info->vendor)
+    {
+      LOGDETAIL("  plugin supports extension '{}'", CLAP_PLUGIN_AS_VST3);
+      pluginvendor = vst3info->vendor;
+    }
+    ci.vendor = pluginvendor;
+
+    if (auto gen = findGenerated(generated, clapdescr->id, kVstAudioEffectClass))
+    {
+      LOGDETAIL("  using the build time class id and categories");
+      memcpy(ci.cid, gen->cid, sizeof(Steinberg::TUID));
+      ci.subCategories = gen->subCategories;
+      info.classes.push_back(std::move(ci));
+      continue;
+    }
+
+    Crypto::uuid_object g;
+    bool haveTUID = false;
+
+    if (singlePluginTUID)
+    {
+      Steinberg::FUID f;
+      if (f.fromString(singlePluginTUID))
+      {
+        memcpy(&g, f.toTUID(), sizeof(Steinberg::TUID));
+        memcpy(ci.cid, &g, sizeof(Steinberg::TUID));
+        haveTUID = true;
+      }
+    }
+
+    if (!haveTUID)
+    {
+      // make id or take it from vst3 info --------------
+      std::string id(clapdescr->id);
+      if (vst3info && vst3info->componentId)
+      {
+        memcpy(&g, vst3info->componentId, sizeof(g));
+      }
+      else
+      {
+        g = Crypto::create_sha1_guid_from_name(id.c_str(), id.size());
+      }
+
+      memcpy(ci.cid, &g, sizeof(Steinberg::TUID));
+
+#if !COM_COMPATIBLE
+      /*
+       * The steinberg APIs retain 'com compatability' by flipping the first pair of ints
+       * in the UID. That results in CID which are not compatbile across platforms and so
+       * mac won't load a win session etc.
+       *
+       * We apply that flip on MAC and LIN also in the wrapper here. The flip is: The first
+       * 8 bits endian, and then the pair of 4 bit endians
+       */
+
+      std::swap(ci.cid[0], ci.cid[3]);
+      std::swap(ci.cid[1], ci.cid[2]);
+
+      std::swap(ci.cid[4], ci.cid[5]);
+      std::swap(ci.cid[6], ci.cid[7]);
+#endif
+    }
+
+    // features ----------------------------------------
+    if (vst3info && vst3info->features)
+    {
+      ci.subCategories = vst3info->features;
+    }
+    else
+    {
+      ci.subCategories = clapCategoriesToVST3(clapdescr->features);
+    }
+
+#if CLAP_WRAPPER_LOGLEVEL > 1
+    {
+      const auto* v = reinterpret_cast<const uint8_t*>(&g);
+      char x[sizeof(g) * 2 + 8];
+      char* o = x;
+      constexpr char hexchar[] = "0123456789ABCDEF";
+      for (auto i = 0U; i < sizeof(g); i++)
+      {
+        auto n = v[i];
+        *o++ = hexchar[(n >> 4) & 0xF];
+        *o++ = hexchar[n & 0xF];
+        if (!(i % 4)) *o++ = 32;
+      }
+      *o++ = 0;
+      LOGDETAIL("plugin id: {} -> {}", clapdescr->id, x);
+    }
+#endif
+    info.classes.push_back(std::move(ci));
+  }
+
+  if (lib._pluginFactoryARAInfo)
+  {
+    LOGINFO("creating ARA companion factories");
+    auto factory = lib._pluginFactoryARAInfo;
+    auto count = factory->get_factory_count(factory);
+    for (decltype(count) i = 0; i < count; ++i)
+    {
+      auto matching_plugin = factory->get_plugin_id(factory, i);
+      LOGDETAIL("number of ARA plugins: {}", numPlugins);
+      for (int ctr = 0; ctr < numPlugins; ++ctr)
+      {
+        auto& clapdescr = lib.plugins[ctr];
+        if (!strcmp(clapdescr->id, matching_plugin))
+        {
+          ClassInfo ci;
+          ci.clapId = clapdescr->id;
+          ci.index = (int32_t)i;
+          ci.category = kARAMainFactoryClass;
+          ci.name = displayName(clapdescr->name);
+          ci.version = clapdescr->version ? clapdescr->version : "";
+          // vendor and sub categories are not used in this context
+
+          if (auto gen = findGenerated(generated, clapdescr->id, kARAMainFactoryClass))
+          {
+            memcpy(ci.cid, gen->cid, sizeof(Steinberg::TUID));
+          }
+          else
+          {
+            std::string extended_id(matching_plugin);
+            extended_id.append("-ARA");
+            auto g = Crypto::create_sha1_guid_from_name(extended_id.c_str(), extended_id.size());
+            memcpy(ci.cid, &g, sizeof(Steinberg::TUID));
+          }
+          info.classes.push_back(std::move(ci));
+          break;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+bool factoryInfoFromGenerated(const GeneratedFactoryInfo& generated, FactoryInfo& info)
+{
+  info = FactoryInfo();
+  if (generated.classCount == 0) return false;
+
+  info.vendor = generated.vendor;
+  info.url = generated.url;
+  info.email = generated.email;
+  for (uint32_t i = 0; i < generated.classCount; ++i)
+  {
+    auto& gen = generated.classes[i];
+    ClassInfo ci;
+    ci.clapId = gen.clapId;
+    ci.index = gen.index;
+    memcpy(ci.cid, gen.cid, sizeof(Steinberg::TUID));
+    ci.category = gen.category;
+    ci.name = gen.name;
+    ci.vendor = gen.vendor;
+    ci.version = gen.version;
+    ci.subCategories = gen.subCategories;
+    info.classes.push_back(std::move(ci));
+  }
+  return true;
+}
+
+}  // namespace ClapWrapper::detail::vst3
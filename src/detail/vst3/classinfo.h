@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+    VST3 class information for the plugins of a CLAP library
+
+    Copyright (c) 2022 Timo Kaluza (defiantnerd)
+
+    This file is part of the clap-wrappers project which is released under MIT License.
+    See file LICENSE or go to https://github.com/free-audio/clap-wrapper for full license details.
+
+    The factory in wrapasvst3_entry.cpp registers one class per CLAP plugin (plus the ARA
+    companion classes). The same information is computed at build time by the vst3 build
+    helper, which writes it to the bundles moduleinfo.json and to a generated table so the
+    factory can look class ids and sub categories up instead of computing them again.
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pluginterfaces/base/funknown.h"
+
+namespace Clap
+{
+class Library;
+}
+
+namespace ClapWrapper::detail::vst3
+{
+
+struct ClassInfo
+{
+  std::string clapId;    // the id of the CLAP plugin this class creates
+  int32_t index = 0;     // the plugin index or, for the ARA companion classes, the ARA factory index
+  Steinberg::TUID cid = {};
+  std::string category;  // kVstAudioEffectClass or kARAMainFactoryClass
+  std::string name;
+  std::string vendor;
+  std::string version;
+  std::string subCategories;
+};
+
+struct FactoryInfo
+{
+  std::string vendor;
+  std::string url;
+  std::string email;
+  std::vector<ClassInfo> classes;
+};
+
+// one entry of the table emitted by the build helper into generated_vst3_classinfo.hxx
+struct GeneratedClassInfo
+{
+  const char* clapId;
+  int32_t index;
+  uint8_t cid[16];
+  const char* category;
+  const char* name;
+  const char* vendor;
+  const char* version;
+  const char* subCategories;
+};
+
+struct GeneratedFactoryInfo
+{
+  const char* vendor;
+  const char* url;
+  const char* email;
+  const GeneratedClassInfo* classes;
+  uint32_t classCount;
+};
+
+/*
+ * fills `info` from the plugins of the library. `singlePluginTUID` is the optional
+ * CLAP_VST3_TUID_STRING override. If `generated` is given, class ids and sub categories
+ * of matching plugins are taken from the build time table instead of being computed.
+ */
+bool buildFactoryInfo(const Clap::Library& lib, const char* singlePluginTUID, FactoryInfo& info,
+                      const GeneratedFactoryInfo* generated = nullptr);
+
+/*
+ * fills `info` from the build time table alone, without the CLAP being loaded. Used by the
+ * deferred loading mode of the factory. Returns false if the table has no classes.
+ */
+bool factoryInfoFromGenerated(const GeneratedFactoryInfo& generated, FactoryInfo& info);
+
+}  // namespace ClapWrapper::detail::vst3
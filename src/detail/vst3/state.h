@@ -6,14 +6,44 @@
     This file is part of the clap-wrappers project which is released under MIT License.
     See file LICENSE or go to https://github.com/free-audio/clap-wrapper for full license details.
 
+    CLAPVST3StreamAdapter presents a VST3 IBStream as clap_istream/clap_ostream.
+
+    Plugins often (de)serialize their state field by field, so the adapter collects writes
+    into a buffer and reads ahead, instead of making a virtual call into the host for
+    every few bytes. Transfers larger than the buffer go straight to the host stream, split
+    into chunks IBStream can express, so states beyond 2GB work, too. If the host stream
+    is an ISizeableStream, it is grown ahead of the writes in large steps and trimmed once
+    the state is complete.
+
+    finish() has to be called once the CLAP is done with the stream: it writes what is
+    still buffered and gives back read-ahead the CLAP did not consume. The destructor does
+    that too, but can not report an error.
 */
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "pluginterfaces/base/ibstream.h"
+
 class CLAPVST3StreamAdapter
 {
  public:
+  static constexpr uint64_t bufferSize = 1024 * 1024;
+  static constexpr uint64_t maxChunkSize = INT32_MAX;
+
   CLAPVST3StreamAdapter(Steinberg::IBStream* stream) : vst_stream(stream)
   {
   }
+  ~CLAPVST3StreamAdapter()
+  {
+    finish();
+    if (sizeable) sizeable->release();
+  }
+  CLAPVST3StreamAdapter(const CLAPVST3StreamAdapter&) = delete;
+  CLAPVST3StreamAdapter& operator=(const CLAPVST3StreamAdapter&) = delete;
+
   operator const clap_istream_t*() const
   {
     return &in;
@@ -23,24 +53,197 @@ class CLAPVST3StreamAdapter
     return &out;
   }
 
+  // grows a sizeable host stream to hold `size` more bytes before anything is written
+  void reserve(uint64_t size)
+  {
+    growFor(size);
+  }
+
+  bool finish()
+  {
+    if (finished) return !failed;
+    finished = true;
+
+    if (writeFill > 0 && !flushWrites()) failed = true;
+
+    if (readPos < readFill)
+    {
+      // rewind the read-ahead, the host might read what follows the CLAP state
+      auto unread = static_cast<Steinberg::int64>(readFill - readPos);
+      vst_stream->seek(-unread, Steinberg::IBStream::kIBSeekCur, nullptr);
+      readPos = readFill = 0;
+    }
+
+    if (grown)
+    {
+      // drop what has been reserved but not written
+      Steinberg::int64 pos = 0;
+      if (vst_stream->tell(&pos) == Steinberg::kResultOk)
+      {
+        sizeable->setStreamSize(std::max(pos, initialSize));
+      }
+    }
+    return !failed;
+  }
+
   static int64_t read(const struct clap_istream* stream, void* buffer, uint64_t size)
   {
     auto self = static_cast<CLAPVST3StreamAdapter*>(stream->ctx);
-    Steinberg::int32 bytesRead = 0;
-    if (kResultOk == self->vst_stream->read(buffer, (int32)size, &bytesRead)) return bytesRead;
-    return -1;
+    return self->readBuffered(static_cast<uint8_t*>(buffer), size);
   }
   static int64_t write(const struct clap_ostream* stream, const void* buffer, uint64_t size)
   {
     auto self = static_cast<CLAPVST3StreamAdapter*>(stream->ctx);
-    Steinberg::int32 bytesWritten = 0;
-    if (kResultOk == self->vst_stream->write(const_cast<void*>(buffer), (int32)size, &bytesWritten))
-      return bytesWritten;
-    return -1;
+    return self->writeBuffered(static_cast<const uint8_t*>(buffer), size);
   }
 
  private:
+  int64_t readBuffered(uint8_t* dest, uint64_t size)
+  {
+    if (size == 0) return 0;
+
+    uint64_t done = 0;
+    if (readPos < readFill)
+    {
+      done = std::min(size, readFill - readPos);
+      memcpy(dest, buffer.data() + readPos, done);
+      readPos += done;
+      if (done == size) return static_cast<int64_t>(done);
+    }
+
+    auto remaining = size - done;
+    if (remaining >= bufferSize)
+    {
+      auto r = readDirect(dest + done, remaining);
+      if (r < 0) return done ? static_cast<int64_t>(done) : -1;
+      return static_cast<int64_t>(done + r);
+    }
+
+    buffer.resize(bufferSize);
+    auto r = readDirect(buffer.data(), bufferSize);
+    if (r < 0) return done ? static_cast<int64_t>(done) : -1;
+    readFill = static_cast<uint64_t>(r);
+    readPos = std::min(remaining, readFill);
+    memcpy(dest + done, buffer.data(), readPos);
+    return static_cast<int64_t>(done + readPos);
+  }
+
+  int64_t readDirect(uint8_t* dest, uint64_t size)
+  {
+    uint64_t total = 0;
+    while (total < size)
+    {
+      auto chunk = static_cast<Steinberg::int32>(std::min(size - total, maxChunkSize));
+      Steinberg::int32 bytesRead = 0;
+      if (vst_stream->read(dest + total, chunk, &bytesRead) != Steinberg::kResultOk)
+      {
+        return total ? static_cast<int64_t>(total) : -1;
+      }
+      if (bytesRead <= 0) break;
+      total += static_cast<uint64_t>(bytesRead);
+      if (bytesRead < chunk) break;
+    }
+    return static_cast<int64_t>(total);
+  }
+
+  int64_t writeBuffered(const uint8_t* src, uint64_t size)
+  {
+    if (failed) return -1;
+    if (writeFill + size <= bufferSize)
+    {
+      buffer.resize(bufferSize);
+      memcpy(buffer.data() + writeFill, src, size);
+      writeFill += size;
+      return static_cast<int64_t>(size);
+    }
+
+    if (!flushWrites()) return -1;
+
+    if (size >= bufferSize)
+    {
+      return writeDirect(src, size) ? static_cast<int64_t>(size) : -1;
+    }
+
+    buffer.resize(bufferSize);
+    memcpy(buffer.data(), src, size);
+    writeFill = size;
+    return static_cast<int64_t>(size);
+  }
+
+  bool flushWrites()
+  {
+    auto ok = writeDirect(buffer.data(), writeFill);
+    writeFill = 0;
+    if (!ok) failed = true;
+    return ok;
+  }
+
+  bool writeDirect(const uint8_t* src, uint64_t size)
+  {
+    growFor(size);
+    uint64_t total = 0;
+    while (total < size)
+    {
+      auto chunk = static_cast<Steinberg::int32>(std::min(size - total, maxChunkSize));
+      Steinberg::int32 bytesWritten = 0;
+      if (vst_stream->write(const_cast<uint8_t*>(src + total), chunk, &bytesWritten) !=
+              Steinberg::kResultOk ||
+          bytesWritten <= 0)
+      {
+        return false;
+      }
+      total += static_cast<uint64_t>(bytesWritten);
+    }
+    return true;
+  }
+
+  // streams like the SDKs MemoryStream grow in small steps, copying everything each time
+  void growFor(uint64_t size)
+  {
+    if (!sizeableQueried)
+    {
+      sizeableQueried = true;
+      if (vst_stream->queryInterface(Steinberg::ISizeableStream::iid, (void**)&sizeable) !=
+              Steinberg::kResultOk ||
+          sizeable->getStreamSize(initialSize) != Steinberg::kResultOk)
+      {
+        if (sizeable) sizeable->release();
+        sizeable = nullptr;
+      }
+      else
+      {
+        currentSize = initialSize;
+      }
+    }
+    if (!sizeable) return;
+
+    Steinberg::int64 pos = 0;
+    if (vst_stream->tell(&pos) != Steinberg::kResultOk) return;
+    auto needed = pos + static_cast<Steinberg::int64>(size);
+    if (needed <= currentSize) return;
+
+    auto newSize = std::max(needed, currentSize * 2);
+    if (sizeable->setStreamSize(newSize) == Steinberg::kResultOk)
+    {
+      currentSize = newSize;
+      grown = true;
+    }
+  }
+
   Steinberg::IBStream* vst_stream = nullptr;
+  Steinberg::ISizeableStream* sizeable = nullptr;
+  bool sizeableQueried = false;
+  bool grown = false;
+  Steinberg::int64 initialSize = 0;
+  Steinberg::int64 currentSize = 0;
+
+  std::vector<uint8_t> buffer;
+  uint64_t writeFill = 0;
+  uint64_t readPos = 0;
+  uint64_t readFill = 0;
+  bool failed = false;
+  bool finished = false;
+
   clap_istream_t in = {this, read};
   clap_ostream_t out = {this, write};
 };
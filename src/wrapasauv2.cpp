@@ -61,17 +61,11 @@ bool WrapAsAUV2::initializeClapDesc()
                 << std::endl;
     }
 
-    auto csp = Clap::getValidCLAPSearchPaths();
-    auto it = std::find_if(csp.begin(), csp.end(),
-                           [this](const auto& cs)
-                           {
-                             auto fp = cs / (_clapname + ".clap");
-                             return fs::is_directory(fp) && _library.load(fp);
-                           });
-
-    if (it != csp.end())
+    auto fp = Clap::findCLAPInSearchPaths(_clapname + ".clap");
+
+    if (fs::is_directory(fp) && _library.load(fp))
     {
-      std::cout << "[clap-wrapper] auv2 loaded clap from " << it->u8string() << std::endl;
+      std::cout << "[clap-wrapper] auv2 loaded clap from " << fp.parent_path().u8string() << std::endl;
     }
     else
     {
@@ -2,6 +2,8 @@
 
 #include "detail/standalone/standalone_details.h"
 #include "detail/standalone/entry.h"
+#include "detail/standalone/standalone_render.h"
+#include "detail/standalone/standalone_bench.h"
 
 #if LIN
 #if CLAP_WRAPPER_HAS_GTK3
@@ -22,23 +24,27 @@ int main(int argc, char **argv)
   std::string clapName{HOSTED_CLAP_NAME};
   LOGINFO("Loading '{}'", clapName);
 
-  auto pts = Clap::getValidCLAPSearchPaths();
-
   auto lib = Clap::Library();
 
-  for (const auto &searchPaths : pts)
+  auto clapPath = Clap::findCLAPInSearchPaths(clapName + ".clap");
+  if (!clapPath.empty())
   {
-    auto clapPath = searchPaths / (clapName + ".clap");
-
-    if (fs::exists(clapPath) && !entry)
-    {
-      lib.load(clapPath);
-      entry = lib._pluginEntry;
-    }
+    lib.load(clapPath);
+    entry = lib._pluginEntry;
   }
 
 #endif
 
+  // offline rendering and benchmarking need no GUI and no audio device
+  if (entry && freeaudio::clap_wrapper::standalone::isRenderCommandLine(argc, argv))
+  {
+    return freeaudio::clap_wrapper::standalone::mainRender(entry, PLUGIN_ID, PLUGIN_INDEX, argc, argv);
+  }
+  if (entry && freeaudio::clap_wrapper::standalone::isBenchCommandLine(argc, argv))
+  {
+    return freeaudio::clap_wrapper::standalone::mainBench(entry, PLUGIN_ID, PLUGIN_INDEX, argc, argv);
+  }
+
 #if LIN
 #if CLAP_WRAPPER_HAS_GTK3
   freeaudio::clap_wrapper::standalone::linux_standalone::GtkGui gtkGui{};
@@ -1,4 +1,6 @@
 #include "detail/standalone/windows/windows_standalone.h"
+#include "detail/standalone/standalone_render.h"
+#include "detail/standalone/standalone_bench.h"
 
 int main(int argc, char** argv)
 {
@@ -14,15 +16,12 @@ int main(int argc, char** argv)
 
   auto lib{Clap::Library()};
 
-  for (const auto& searchPaths : Clap::getValidCLAPSearchPaths())
-  {
-    auto clapPath{searchPaths / (clapName + ".clap")};
+  auto clapPath{Clap::findCLAPInSearchPaths(clapName + ".clap")};
 
-    if (fs::exists(clapPath) && !entry)
-    {
-      lib.load(clapPath);
-      entry = lib._pluginEntry;
-    }
+  if (!clapPath.empty())
+  {
+    lib.load(clapPath);
+    entry = lib._pluginEntry;
   }
 #endif
 
@@ -33,6 +32,15 @@ int main(int argc, char** argv)
     return 3;
   }
 
+  if (freeaudio::clap_wrapper::standalone::isRenderCommandLine(argc, argv))
+  {
+    return freeaudio::clap_wrapper::standalone::mainRender(entry, PLUGIN_ID, PLUGIN_INDEX, argc, argv);
+  }
+  if (freeaudio::clap_wrapper::standalone::isBenchCommandLine(argc, argv))
+  {
+    return freeaudio::clap_wrapper::standalone::mainBench(entry, PLUGIN_ID, PLUGIN_INDEX, argc, argv);
+  }
+
   freeaudio::clap_wrapper::standalone::windows_standalone::Plugin plugin{entry, argc, argv};
 
   return freeaudio::clap_wrapper::standalone::windows_standalone::run();
@@ -3,6 +3,8 @@
 #include <pluginterfaces/base/ustring.h>
 #include <pluginterfaces/vst/ivstevents.h>
 #include <pluginterfaces/vst/ivstnoteexpression.h>
+#include <pluginterfaces/vst/ivstattributes.h>
+#include <pluginterfaces/vst/vstpresetkeys.h>
 #include <public.sdk/source/vst/utility/stringconvert.h>
 #include <base/source/fstring.h>
 #include "detail/vst3/state.h"
@@ -214,6 +216,10 @@ tresult PLUGIN_API ClapAsVst3::process(Vst::ProcessData& data)
 
   // FIXME: At this transition we probably need to be careful that we aren't in a flush
   _processEverCalled = true;
+  if (data.inputParameterChanges && data.inputParameterChanges->getParameterCount() > 0)
+  {
+    _stateDirty = true;
+  }
   this->_processAdapter->process(data);
   return kResultOk;
 }
@@ -227,14 +233,84 @@ tresult PLUGIN_API ClapAsVst3::canProcessSampleSize(int32 symbolicSampleSize)
   return kResultOk;
 }
 
+// hosts tell what a state is for through IStreamAttributes. With the CLAP state context
+// extension a plugin can then leave out what only a project needs when saving a preset.
+static uint32_t stateContextFromStream(IBStream* state)
+{
+  FUnknownPtr<Vst::IStreamAttributes> attributes(state);
+  if (!attributes) return 0;
+  auto list = attributes->getAttributes();
+  if (!list) return 0;
+
+  Vst::String128 value = {};
+  if (list->getString(Vst::PresetAttributes::kStateType, value, sizeof(value)) == kResultTrue)
+  {
+    auto type = VST3::StringConvert::convert(value);
+    if (type == Vst::StateType::kProject) return CLAP_STATE_CONTEXT_FOR_PROJECT;
+    if (type == Vst::StateType::kDefault) return CLAP_STATE_CONTEXT_FOR_PRESET;
+  }
+
+  // no state type, but the attributes of a preset file
+  if (list->getString(Vst::PresetAttributes::kFilePathStringType, value, sizeof(value)) == kResultTrue)
+  {
+    return CLAP_STATE_CONTEXT_FOR_PRESET;
+  }
+  return 0;
+}
+
 tresult PLUGIN_API ClapAsVst3::setState(IBStream* state)
 {
-  return (_plugin->load(CLAPVST3StreamAdapter(state)) ? Steinberg::kResultOk : Steinberg::kResultFalse);
+  _stateDirty = true;
+  auto context = stateContextFromStream(state);
+  CLAPVST3StreamAdapter stream(state);
+  auto result = _plugin->load(stream, context);
+  stream.finish();
+  return (result ? Steinberg::kResultOk : Steinberg::kResultFalse);
 }
 
 tresult PLUGIN_API ClapAsVst3::getState(IBStream* state)
 {
-  return (_plugin->save(CLAPVST3StreamAdapter(state)) ? Steinberg::kResultOk : Steinberg::kResultFalse);
+  auto context = stateContextFromStream(state);
+
+  if (_stateTooLargeToCache)
+  {
+    CLAPVST3StreamAdapter stream(state);
+    auto result = _plugin->save(stream, context) && stream.finish();
+    return (result ? Steinberg::kResultOk : Steinberg::kResultFalse);
+  }
+
+  // clear the flag before saving, so a change during the save invalidates the new cache
+  if (_stateDirty.exchange(false) || !_stateCacheValid || _stateCacheContext != context)
+  {
+    _stateCache.clear();
+    _stateCacheContext = context;
+    _stateCacheValid = _plugin->save(_stateCache, context);
+    if (!_stateCacheValid)
+    {
+      _stateCache.clear();
+      return Steinberg::kResultFalse;
+    }
+  }
+  else
+  {
+    LOGDETAIL("serving the state from the cache ({} bytes)", _stateCache.size());
+  }
+
+  CLAPVST3StreamAdapter stream(state);
+  stream.reserve(_stateCache.size());
+  const clap_ostream_t* out = stream;
+  auto size = static_cast<int64_t>(_stateCache.size());
+  auto result = (size == 0 || out->write(out, _stateCache.data(), size) == size) && stream.finish();
+
+  // a second copy of a state this large would double the memory of the instance
+  if (_stateCache.size() > maxCachedStateSize)
+  {
+    LOGDETAIL("not caching the state, {} bytes is over {}", _stateCache.size(), maxCachedStateSize);
+    _stateTooLargeToCache = true;
+    _stateCacheValid = false;
+    _stateCache.release();
+  }
+  return (result ? Steinberg::kResultOk : Steinberg::kResultFalse);
 }
 
 uint32 PLUGIN_API ClapAsVst3::getLatencySamples()
@@ -1037,6 +1113,7 @@ void ClapAsVst3::setupParameters(const clap_plugin_t* plugin, const clap_plugin_
 
 void ClapAsVst3::param_rescan(clap_param_rescan_flags flags)
 {
+  _stateDirty = true;
   auto vstflags = 0u;
   if (flags & CLAP_PARAM_RESCAN_ALL)
   {
@@ -1151,6 +1228,7 @@ void ClapAsVst3::tail_changed()
 
 void ClapAsVst3::mark_dirty()
 {
+  _stateDirty = true;
   if (componentHandler2) componentHandler2->setDirty(true);
 }
 
@@ -1174,6 +1252,7 @@ void ClapAsVst3::onBeginEdit(clap_id id)
 void ClapAsVst3::onPerformEdit(const clap_event_param_value_t* value)
 {
   // receive a value change and pass it to the internal queue
+  _stateDirty = true;
   _queueToUI.push(valueEvent(value));
 }
 void ClapAsVst3::onEndEdit(clap_id id)
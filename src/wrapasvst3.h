@@ -388,6 +388,18 @@ class ClapAsVst3 : public Steinberg::Vst::SingleComponentEffect,
   std::atomic_bool _requestUICallback = false;
   bool _missedLatencyRequest = false;
 
+  // the state the last getState serialized. It is handed out again as long as the CLAP did
+  // not mark itself dirty and no parameter changed - hosts call getState for every autosave
+  // and undo step. _stateDirty is set from the audio thread, too. The cache holds one
+  // state context only, a preset save after a project save serializes again. A state larger
+  // than maxCachedStateSize isn't kept, and from then on goes straight to the host stream.
+  static constexpr size_t maxCachedStateSize = 16 * 1024 * 1024;
+  Clap::StateMemento _stateCache;
+  bool _stateCacheValid = false;
+  bool _stateTooLargeToCache = false;
+  uint32_t _stateCacheContext = 0;
+  std::atomic_bool _stateDirty = true;
+
   std::thread::id _main_thread_id{};
   static const uint32_t _gui_invalid_size = 0xffffffff;
   std::atomic<uint32_t> _gui_resize_request = _gui_invalid_size;
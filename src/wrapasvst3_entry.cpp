@@ -16,7 +16,13 @@
        a) checks each CLAP search path for a matching .clap
          b) checks it's own parent folder name and tries to add it to the .clap path. This allows a vst3 wrapper placed in
                 {any VST3 Folder}/mevendor/myplugin.vst3 to match {any CLAP folder}/mevendor/myplugin.clap
-         c) checks all subfolders in the CLAP folders for a matching .clap.
+         c) checks all subfolders in the CLAP folders for a matching .clap. The result of that walk is kept
+            in an index in the user cache folder, which is only rebuilt when the folders change.
+
+    If the wrapper is built with DEFER_CLAP_LOADING (see target_add_vst3_wrapper), the factory is
+    built from the class table generated at build time instead, and the search above and the
+    initialization of the CLAP happen on the first createInstance. If there is no table, the
+    factory falls back to loading the CLAP right away.
 
     Valid CLAP search paths are also documented in clap/include/clap/entry.h:
 
@@ -44,10 +50,11 @@
 
 */
 
-#include "detail/shared/sha1.h"
 #include "wrapasvst3.h"
 #include "public.sdk/source/main/pluginfactory.h"
 #include <array>
+#include <memory>
+#include <mutex>
 
 using namespace Steinberg::Vst;
 
@@ -59,25 +66,30 @@ using namespace Steinberg::Vst;
 //------------------------------------------------------------------------
 
 #include "detail/clap/fsutil.h"
-#include "detail/vst3/categories.h"
+#include "detail/vst3/classinfo.h"
 #include "clap_proxy.h"
 
+#if CLAP_WRAPPER_VST3_GENERATED_CLASSINFO
+// written by the vst3 build helper, see src/detail/vst3/build-helper/build-helper.cpp
+#include "generated_vst3_classinfo.hxx"
+#endif
+
 struct CreationContext
 {
   Clap::Library* lib = nullptr;
   int index = 0;
   PClassInfo2 classinfo;
+  std::string clapId;
 };
 
 bool findPlugin(Clap::Library& lib, const std::string& pluginfilename)
 {
   auto parentfolder = os::getParentFolderName();
-  auto paths = Clap::getValidCLAPSearchPaths();
+  auto paths = Clap::getCLAPSearchRoots();
 
   // Strategy 1: look for a clap with the same name as this binary
   for (auto& i : paths)
   {
-    if (!fs::exists(i)) continue;
     // try to find it the CLAP folder immediately
     auto k1 = i / pluginfilename;
     LOGDETAIL("scanning for binary: {}", k1.u8string().c_str());
@@ -100,254 +112,202 @@ bool findPlugin(Clap::Library& lib, const std::string& pluginfilename)
         return true;
       }
     }
+  }
 
-    // Strategy 3: enumerate folders in CLAP folder and try to locate the plugin in any sub folder (only one level)
-    for (const auto& subdir : fs::directory_iterator(i))
+  // Strategy 3: locate the plugin anywhere below the CLAP folders through the search index
+  auto k3 = Clap::findCLAPInSearchPaths(pluginfilename);
+  if (!k3.empty())
+  {
+    LOGDETAIL("scanning for binary: {}", k3.u8string().c_str());
+    if (lib.load(k3))
     {
-      auto k3 = i / subdir / pluginfilename;
-      LOGDETAIL("scanning for binary: {}", k3.u8string().c_str());
-      if (fs::exists(k3))
-      {
-        if (lib.load(k3))
-        {
-          return true;
-        }
-      }
+      return true;
     }
   }
 
   return false;
 }
 
-IPluginFactory* GetPluginFactoryEntryPoint()
-{
-#if _DEBUG
-  // MessageBoxA(NULL,"halt","me",MB_OK); // <- enable this on Windows to get a debug attachment to vstscanner.exe (subprocess of cbse)
-#endif
-
-#if SMTG_OS_WINDOWS
-// #pragma comment(linker, "/EXPORT:" __FUNCTION__ "=" __FUNCDNAME__)
-#endif
+// the CLAP library behind the factory. Constructing it initializes a CLAP linked into this
+// binary, and finding and loading a CLAP from the search paths is slow, so it is created on
+// first use only: by the factory itself or, in the deferred loading mode, by the first
+// createInstance.
+static std::unique_ptr<Clap::Library> gClapLibrary;
+static std::mutex gClapLibraryMutex;
 
-  // static IPtr<Steinberg::CPluginFactory> gPluginFactory = nullptr;
-  static Clap::Library gClapLibrary;
+// must be called with gClapLibraryMutex locked
+static Clap::Library* loadClapLibrary()
+{
+  if (gClapLibrary) return gClapLibrary.get();
 
-  static std::vector<std::shared_ptr<CreationContext>> gCreationContexts;
+  auto lib = std::make_unique<Clap::Library>();
 
-  // if there is no ClapLibrary yet
-  if (!gClapLibrary._pluginFactory)
+  // if this binary does not already contain a CLAP entrypoint
+  if (!lib->hasEntryPoint())
   {
-    // if this binary does not already contain a CLAP entrypoint
-    if (!gClapLibrary.hasEntryPoint())
-    {
-      // try to find a clap which filename stem matches our own
-      auto kx = os::getParentFolderName();
-      auto plugname = os::getBinaryName();
-      plugname.append(".clap");
+    // try to find a clap which filename stem matches our own
+    auto plugname = os::getBinaryName();
+    plugname.append(".clap");
 
-      if (!findPlugin(gClapLibrary, plugname))
-      {
-        return nullptr;
-      }
-    }
-    else
+    if (!findPlugin(*lib, plugname))
     {
-      LOGDETAIL("detected entrypoint in this binary");
+      return nullptr;
     }
   }
-  if (gClapLibrary.plugins.empty())
+  else
+  {
+    LOGDETAIL("detected entrypoint in this binary");
+  }
+
+  if (lib->plugins.empty())
   {
     // with no plugins there is nothing to do..
     LOGINFO("no plugin has been found");
     return nullptr;
   }
 
-  if (!clap_version_is_compatible(gClapLibrary.plugins[0]->clap_version))
+  if (!clap_version_is_compatible(lib->plugins[0]->clap_version))
   {
     // CLAP version is not compatible -> eject
     LOGINFO("CLAP version is not compatible");
     return nullptr;
   }
 
-  if (!gPluginFactory)
-  {
-    // we need at least one plugin to obtain vendor/name etc.
-    auto* factoryvendor = gClapLibrary.plugins[0]->vendor;
-    auto* vendor_url = gClapLibrary.plugins[0]->url;
-    // TODO: extract the domain and prefix with info@
-    auto* contact = "info@";
-
-    // override for VST3 specifics
-    if (gClapLibrary._pluginFactoryVst3Info)
-    {
-      LOGDETAIL("detected extension `{}`", CLAP_PLUGIN_FACTORY_INFO_VST3);
-      auto& v3 = gClapLibrary._pluginFactoryVst3Info;
-      if (v3->vendor) factoryvendor = v3->vendor;
-      if (v3->vendor_url) vendor_url = v3->vendor_url;
-      if (v3->email_contact) contact = v3->email_contact;
-    }
+  gClapLibrary = std::move(lib);
+  return gClapLibrary.get();
+}
 
-    static PFactoryInfo factoryInfo(factoryvendor, vendor_url, contact, Vst::kDefaultFactoryFlags);
+IPluginFactory* GetPluginFactoryEntryPoint()
+{
+#if _DEBUG
+  // MessageBoxA(NULL,"halt","me",MB_OK); // <- enable this on Windows to get a debug attachment to vstscanner.exe (subprocess of cbse)
+#endif
 
-    LOGDETAIL("created factory for vendor '{}'", factoryvendor);
+#if SMTG_OS_WINDOWS
+// #pragma comment(linker, "/EXPORT:" __FUNCTION__ "=" __FUNCDNAME__)
+#endif
 
-    gPluginFactory = new Steinberg::CPluginFactory(factoryInfo);
-    // resize the classInfo vector
-    gCreationContexts.clear();
-    gCreationContexts.reserve(gClapLibrary.plugins.size());
-    int numPlugins = static_cast<int>(gClapLibrary.plugins.size());
-    LOGDETAIL("number of plugins in factory: {}", numPlugins);
-    for (int ctr = 0; ctr < numPlugins; ++ctr)
-    {
-      auto& clapdescr = gClapLibrary.plugins[ctr];
-      auto vst3info = gClapLibrary.get_vst3_info(ctr);
+  static std::vector<std::shared_ptr<CreationContext>> gCreationContexts;
 
-      LOGDETAIL("  plugin #{}: '{}'", ctr, clapdescr->name);
+  // hosts ask for the factory rarely, so it is only ever looked at under the lock. Threads
+  // racing here would otherwise both build one, the second freeing the contexts of the first.
+  std::lock_guard<std::mutex> lock(gClapLibraryMutex);
 
-      std::string n(clapdescr->name);
+  if (gPluginFactory)
+  {
+    gPluginFactory->addRef();
+    return gPluginFactory;
+  }
 
-#ifdef _DEBUG
-      n.append(" (CLAP->VST3)");
-#endif
-      auto plugname = n.c_str();  //  clapdescr->name;
+  ClapWrapper::detail::vst3::FactoryInfo info;
+  Clap::Library* lib = gClapLibrary.get();
+  bool deferred = false;
 
-      // get vendor -------------------------------------
-      auto pluginvendor = clapdescr->vendor;
-      if (pluginvendor == nullptr || *pluginvendor == 0) pluginvendor = "Unspecified Vendor";
-      if (vst3info && vst3info->vendor)
-      {
-        LOGDETAIL("  plugin supports extension '{}'", CLAP_PLUGIN_AS_VST3);
-        pluginvendor = vst3info->vendor;
-      }
+#if CLAP_WRAPPER_VST3_DEFER_LOADING && CLAP_WRAPPER_VST3_GENERATED_CLASSINFO
+  // answer the class queries of the host from the build time table. The CLAP is loaded
+  // by the first createInstance, hosts only scanning the plugin never load it at all.
+  if (!lib)
+  {
+    deferred = ClapWrapper::detail::vst3::factoryInfoFromGenerated(
+        ClapWrapper::detail::vst3::generated::factoryInfo, info);
+    if (deferred) LOGDETAIL("deferring loading the CLAP to the first instance");
+  }
+#endif
 
-      TUID lcid;
-      Crypto::uuid_object g;
+  if (!deferred)
+  {
+    lib = loadClapLibrary();
+    if (!lib)
+    {
+      return nullptr;
+    }
 
+    const char* singlePluginTUID = nullptr;
 #ifdef CLAP_VST3_TUID_STRING
-      Steinberg::FUID f;
-      if (f.fromString(CLAP_VST3_TUID_STRING))
-      {
-        memcpy(&g, f.toTUID(), sizeof(TUID));
-        memcpy(&lcid, &g, sizeof(TUID));
-      }
-      else
+    singlePluginTUID = CLAP_VST3_TUID_STRING;
 #endif
-      {
-        // make id or take it from vst3 info --------------
-        std::string id(clapdescr->id);
-        if (vst3info && vst3info->componentId)
-        {
-          memcpy(&g, vst3info->componentId, sizeof(g));
-        }
-        else
-        {
-          g = Crypto::create_sha1_guid_from_name(id.c_str(), id.size());
-        }
-
-        memcpy(&lcid, &g, sizeof(TUID));
-
-#if !COM_COMPATIBLE
-        /*
-         * The steinberg APIs retain 'com compatability' by flipping the first pair of ints
-         * in the UID. That results in CID which are not compatbile across platforms and so
-         * mac won't load a win session etc.
-         *
-         * We apply that flip on MAC and LIN also in the wrapper here. The flip is: The first
-         * 8 bits endian, and then the pair of 4 bit endians
-         */
-
-        std::swap(lcid[0], lcid[3]);
-        std::swap(lcid[1], lcid[2]);
-
-        std::swap(lcid[4], lcid[5]);
-        std::swap(lcid[6], lcid[7]);
+    const ClapWrapper::detail::vst3::GeneratedFactoryInfo* generated = nullptr;
+#if CLAP_WRAPPER_VST3_GENERATED_CLASSINFO
+    generated = &ClapWrapper::detail::vst3::generated::factoryInfo;
 #endif
-      }
+    if (!ClapWrapper::detail::vst3::buildFactoryInfo(*lib, singlePluginTUID, info, generated))
+    {
+      return nullptr;
+    }
+  }
 
-      // features ----------------------------------------
-      std::string features;
-      if (vst3info && vst3info->features)
-      {
-        features = vst3info->features;
-      }
-      else
-      {
-        features = clapCategoriesToVST3(clapdescr->features);
-      }
+  static PFactoryInfo factoryInfo(info.vendor.c_str(), info.url.c_str(), info.email.c_str(),
+                                  Vst::kDefaultFactoryFlags);
+
+  LOGDETAIL("created factory for vendor '{}'", info.vendor);
+
+  gPluginFactory = new Steinberg::CPluginFactory(factoryInfo);
+  // resize the classInfo vector
+  gCreationContexts.clear();
+  gCreationContexts.reserve(info.classes.size());
+  for (const auto& ci : info.classes)
+  {
+    auto ptr = std::make_shared<CreationContext>();
+    *ptr = {lib, ci.index,
+            PClassInfo2(ci.cid, PClassInfo::kManyInstances, ci.category.c_str(), ci.name.c_str(),
+                        0 /* the only flag is usually Vst:kDistributable, but CLAPs aren't distributable */,
+                        ci.subCategories.c_str(), ci.vendor.c_str(), ci.version.c_str(), kVstVersionString),
+            ci.clapId};
+    gCreationContexts.push_back(ptr);
+    gPluginFactory->registerClass(&gCreationContexts.back()->classinfo, ClapAsVst3::createInstance,
+                                  gCreationContexts.back().get());
+  }
+
+  return gPluginFactory;
+}
 
-#if CLAP_WRAPPER_LOGLEVEL > 1
+/*
+    in the deferred loading mode the contexts are created without a library. This loads it and
+    looks the plugin up by its id, the index in the build time table might not be the one of
+    a CLAP that has been replaced since.
+*/
+static bool resolveCreationContext(CreationContext* ctx)
+{
+  std::lock_guard<std::mutex> lock(gClapLibraryMutex);
+  if (ctx->lib) return true;
+
+  auto lib = loadClapLibrary();
+  if (!lib)
+  {
+    LOGINFO("unable to load the CLAP for {}", ctx->classinfo.name);
+    return false;
+  }
+
+  if (!strcmp(ctx->classinfo.category, kVstAudioEffectClass))
+  {
+    for (size_t i = 0; i < lib->plugins.size(); ++i)
+    {
+      if (ctx->clapId == lib->plugins[i]->id)
       {
-        const auto* v = reinterpret_cast<const uint8_t*>(&g);
-        char x[sizeof(g) * 2 + 8];
-        char* o = x;
-        constexpr char hexchar[] = "0123456789ABCDEF";
-        for (auto i = 0U; i < sizeof(g); i++)
-        {
-          auto n = v[i];
-          *o++ = hexchar[(n >> 4) & 0xF];
-          *o++ = hexchar[n & 0xF];
-          if (!(i % 4)) *o++ = 32;
-        }
-        *o++ = 0;
-        LOGDETAIL("plugin id: {} -> {}", clapdescr->id, x);
+        ctx->index = static_cast<int>(i);
+        ctx->lib = lib;
+        return true;
       }
-#endif
-      auto ptr = std::make_shared<CreationContext>();
-      *ptr = {&gClapLibrary, ctr,
-              PClassInfo2(
-                  lcid, PClassInfo::kManyInstances, kVstAudioEffectClass, plugname,
-                  0 /* the only flag is usually Vst:kDistributable, but CLAPs aren't distributable */,
-                  features.c_str(), pluginvendor, clapdescr->version, kVstVersionString)};
-      gCreationContexts.push_back(ptr);
-      gPluginFactory->registerClass(&gCreationContexts.back()->classinfo, ClapAsVst3::createInstance,
-                                    gCreationContexts.back().get());
     }
+  }
 
-    if (gClapLibrary._pluginFactoryARAInfo)
+  if (!strcmp(ctx->classinfo.category, kARAMainFactoryClass) && lib->_pluginFactoryARAInfo)
+  {
+    auto factory = lib->_pluginFactoryARAInfo;
+    auto count = factory->get_factory_count(factory);
+    for (decltype(count) i = 0; i < count; ++i)
     {
-      LOGINFO("creating ARA companion factories");
-      auto factory = gClapLibrary._pluginFactoryARAInfo;
-      auto count = factory->get_factory_count(factory);
-      for (decltype(count) i = 0; i < count; ++i)
+      if (ctx->clapId == factory->get_plugin_id(factory, i))
       {
-        auto matching_plugin = factory->get_plugin_id(factory, i);
-        LOGDETAIL("number of ARA plugins: {}", numPlugins);
-        for (int ctr = 0; ctr < numPlugins; ++ctr)
-        {
-          auto& clapdescr = gClapLibrary.plugins[ctr];
-          if (!strcmp(clapdescr->id, matching_plugin))
-          {
-            std::string extended_id(matching_plugin);
-            extended_id.append("-ARA");
-            auto g = Crypto::create_sha1_guid_from_name(extended_id.c_str(), extended_id.size());
-            TUID lcid;
-            memcpy(&lcid, &g, sizeof(TUID));
-
-            std::string n(clapdescr->name);
-#ifdef _DEBUG
-            n.append(" (CLAP->VST3)");
-#endif
-            auto plugname = n.c_str();  //  clapdescr->name;
-            auto ptr = std::make_shared<CreationContext>();
-            *ptr = {&gClapLibrary, (int)i,
-                    PClassInfo2(lcid, PClassInfo::kManyInstances, kARAMainFactoryClass, plugname, 0,
-                                "", /* not used in this context */
-                                "", /* not used in this context */
-                                clapdescr->version, kVstVersionString)};
-            gCreationContexts.push_back(ptr);
-            gPluginFactory->registerClass(&gCreationContexts.back()->classinfo,
-                                          ClapAsVst3::createInstance, gCreationContexts.back().get());
-
-            break;
-          }
-        }
+        ctx->index = static_cast<int>(i);
+        ctx->lib = lib;
+        return true;
       }
     }
   }
-  else
-    gPluginFactory->addRef();
 
-  return gPluginFactory;
+  LOGINFO("the CLAP does not provide {} anymore", ctx->clapId);
+  return false;
 }
 
 class ARAMainFactory : public ARA::IMainFactory
@@ -380,12 +340,18 @@ DEF_CLASS_IID(ARA::IMainFactory)
 
 /*
     creates an Instance from the creationContext.
-    actually, there is always a valid entrypoint, otherwise no factory would have been provided.
+    actually, there is always a valid entrypoint, otherwise no factory would have been provided -
+    unless the factory has been created from the build time table and loading the CLAP fails now.
 */
 FUnknown* ClapAsVst3::createInstance(void* context)
 {
   auto ctx = static_cast<CreationContext*>(context);
 
+  if (!resolveCreationContext(ctx))
+  {
+    return nullptr;
+  }
+
   if (!strcmp(ctx->classinfo.category, kVstAudioEffectClass))
   {
     LOGINFO("creating plugin {} (#{})", ctx->classinfo.name, ctx->index);
@@ -0,0 +1,451 @@
+/*
+ * This implements a synthetic CLAP with a very large parameter set and creates the
+ * appropriate factory methods and entry as a static library, which are then consumed by the
+ * various plugins via large_params_clap_entry.
+ *
+ * The factory exposes one plugin per parameter count (100 up to 100k) so a single build
+ * covers the whole range. Parameters are spread over LARGE_PARAMS_MODULE_COUNT modules
+ * (nested two levels deep, to exercise unit building in the VST3 wrapper) and every
+ * LARGE_PARAMS_STEPPED_EVERY-th parameter is stepped.
+ *
+ * There is no DSP. The plugin outputs silence and just keeps its parameter values.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <clap/clap.h>
+#include "large_params_clap_entry.h"
+
+#ifndef LARGE_PARAMS_MODULE_COUNT
+#define LARGE_PARAMS_MODULE_COUNT 64
+#endif
+
+#ifndef LARGE_PARAMS_STEPPED_EVERY
+#define LARGE_PARAMS_STEPPED_EVERY 4
+#endif
+
+// modules are grouped in folders of this many, giving "Group x/Module y" paths
+static const uint32_t modulesPerGroup = 8;
+
+// keep the ids sparse and away from zero so the id mapping in the wrappers gets exercised
+static const clap_id paramIdBase = 0x10000;
+static const clap_id paramIdStride = 3;
+
+static const char *features[] = {CLAP_PLUGIN_FEATURE_INSTRUMENT, CLAP_PLUGIN_FEATURE_SYNTHESIZER,
+                                 CLAP_PLUGIN_FEATURE_STEREO, nullptr};
+
+#define LARGE_PARAMS_DESC(count)                                                                   \
+  {CLAP_VERSION_INIT,                                                                              \
+   "org.free-audio.clap-first-large-params." #count,                                              \
+   "ClapFirstLargeParams" #count,                                                                  \
+   "Free Audio",                                                                                   \
+   "https://github.com/free-audio/clap-wrapper",                                                   \
+   "",                                                                                             \
+   "",                                                                                             \
+   "1.0.0",                                                                                        \
+   "A synthetic plugin with " #count " parameters for benchmarking the wrappers",                  \
+   &features[0]}
+
+static const clap_plugin_descriptor_t s_largeParams_desc[] = {
+    LARGE_PARAMS_DESC(100), LARGE_PARAMS_DESC(1000), LARGE_PARAMS_DESC(10000), LARGE_PARAMS_DESC(100000)};
+static const uint32_t s_largeParams_counts[] = {100, 1000, 10000, 100000};
+static const uint32_t s_largeParams_numDescs = sizeof(s_largeParams_counts) / sizeof(uint32_t);
+
+typedef struct
+{
+  clap_plugin_t plugin;
+  const clap_host_t *host;
+  uint32_t paramCount;
+  double *values;
+} large_params_plug;
+
+static bool largeParams_isStepped(uint32_t index)
+{
+  return (index % LARGE_PARAMS_STEPPED_EVERY) == 0;
+}
+
+static double largeParams_maxValue(uint32_t index)
+{
+  return largeParams_isStepped(index) ? (double)(1 + index % 7) : 1.0;
+}
+
+static bool largeParams_indexForId(const large_params_plug *plug, clap_id param_id, uint32_t *index)
+{
+  if (param_id < paramIdBase || (param_id - paramIdBase) % paramIdStride != 0) return false;
+  uint32_t idx = (param_id - paramIdBase) / paramIdStride;
+  if (idx >= plug->paramCount) return false;
+  *index = idx;
+  return true;
+}
+
+static void largeParams_process_event(large_params_plug *plug, const clap_event_header_t *hdr)
+{
+  if (hdr->space_id != CLAP_CORE_EVENT_SPACE_ID || hdr->type != CLAP_EVENT_PARAM_VALUE) return;
+
+  const clap_event_param_value_t *ev = (const clap_event_param_value_t *)hdr;
+  uint32_t index;
+  if (largeParams_indexForId(plug, ev->param_id, &index))
+  {
+    plug->values[index] = ev->value;
+  }
+}
+
+/////////////////////////////
+// clap_plugin_audio_ports //
+/////////////////////////////
+
+static uint32_t largeParams_audio_ports_count(const clap_plugin_t *plugin, bool is_input)
+{
+  return is_input ? 0 : 1;
+}
+
+static bool largeParams_audio_ports_get(const clap_plugin_t *plugin, uint32_t index, bool is_input,
+                                        clap_audio_port_info_t *info)
+{
+  if (is_input || index > 0) return false;
+  info->id = 0;
+  snprintf(info->name, sizeof(info->name), "%s", "Main Output");
+  info->channel_count = 2;
+  info->flags = CLAP_AUDIO_PORT_IS_MAIN;
+  info->port_type = CLAP_PORT_STEREO;
+  info->in_place_pair = CLAP_INVALID_ID;
+  return true;
+}
+
+static const clap_plugin_audio_ports_t s_largeParams_audio_ports = {
+    largeParams_audio_ports_count,
+    largeParams_audio_ports_get,
+};
+
+////////////////////////////
+// clap_plugin_note_ports //
+////////////////////////////
+
+static uint32_t largeParams_note_ports_count(const clap_plugin_t *plugin, bool is_input)
+{
+  return 1;
+}
+
+static bool largeParams_note_ports_get(const clap_plugin_t *plugin, uint32_t index, bool is_input,
+                                       clap_note_port_info_t *info)
+{
+  if (index > 0) return false;
+  info->id = 0;
+  snprintf(info->name, sizeof(info->name), "%s", is_input ? "Note In" : "Note Out");
+  info->supported_dialects = CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI;
+  info->preferred_dialect = CLAP_NOTE_DIALECT_CLAP;
+  return true;
+}
+
+static const clap_plugin_note_ports_t s_largeParams_note_ports = {
+    largeParams_note_ports_count,
+    largeParams_note_ports_get,
+};
+
+/////////////////
+// clap_params //
+/////////////////
+
+uint32_t largeParams_param_count(const clap_plugin_t *plugin)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+  return plug->paramCount;
+}
+
+bool largeParams_param_get_info(const clap_plugin_t *plugin, uint32_t param_index,
+                                clap_param_info_t *param_info)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+  if (param_index >= plug->paramCount) return false;
+
+  // spread the parameters evenly and contiguously over the modules
+  uint32_t module = (uint32_t)(((uint64_t)param_index * LARGE_PARAMS_MODULE_COUNT) / plug->paramCount);
+
+  param_info->id = paramIdBase + param_index * paramIdStride;
+  snprintf(param_info->name, CLAP_NAME_SIZE, "Param %u", param_index);
+  snprintf(param_info->module, CLAP_PATH_SIZE, "Group %u/Module %u", module / modulesPerGroup, module);
+  param_info->min_value = 0;
+  param_info->max_value = largeParams_maxValue(param_index);
+  param_info->default_value = largeParams_isStepped(param_index) ? 0 : 0.5;
+  param_info->flags = CLAP_PARAM_IS_AUTOMATABLE;
+  if (largeParams_isStepped(param_index)) param_info->flags |= CLAP_PARAM_IS_STEPPED;
+  param_info->cookie = NULL;
+  return true;
+}
+
+bool largeParams_param_get_value(const clap_plugin_t *plugin, clap_id param_id, double *value)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+  uint32_t index;
+  if (!largeParams_indexForId(plug, param_id, &index)) return false;
+  *value = plug->values[index];
+  return true;
+}
+
+bool largeParams_param_value_to_text(const clap_plugin_t *plugin, clap_id param_id, double value,
+                                     char *display, uint32_t size)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+  uint32_t index;
+  if (!largeParams_indexForId(plug, param_id, &index)) return false;
+
+  if (largeParams_isStepped(index))
+    snprintf(display, size, "Step %d", (int)value);
+  else
+    snprintf(display, size, "%.3f", value);
+  return true;
+}
+
+bool largeParams_text_to_value(const clap_plugin_t *plugin, clap_id param_id, const char *display,
+                               double *value)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+  uint32_t index;
+  if (!largeParams_indexForId(plug, param_id, &index)) return false;
+
+  const char *start = display;
+  if (largeParams_isStepped(index) && !strncmp(start, "Step ", 5)) start += 5;
+  char *end = NULL;
+  double v = strtod(start, &end);
+  if (end == start) return false;
+  *value = v;
+  return true;
+}
+
+void largeParams_flush(const clap_plugin_t *plugin, const clap_input_events_t *in,
+                       const clap_output_events_t *out)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+
+  uint32_t s = in->size(in);
+  for (uint32_t q = 0; q < s; ++q)
+  {
+    largeParams_process_event(plug, in->get(in, q));
+  }
+}
+
+static const clap_plugin_params_t s_largeParams_params = {
+    largeParams_param_count,         largeParams_param_get_info, largeParams_param_get_value,
+    largeParams_param_value_to_text, largeParams_text_to_value,  largeParams_flush};
+
+////////////////
+// clap_state //
+////////////////
+
+static bool largeParams_write_all(const clap_ostream_t *stream, const void *data, size_t size)
+{
+  const char *curr = (const char *)data;
+  while (size > 0)
+  {
+    int64_t thiswrite = stream->write(stream, curr, size);
+    if (thiswrite <= 0) return false;
+    curr += thiswrite;
+    size -= (size_t)thiswrite;
+  }
+  return true;
+}
+
+static bool largeParams_read_all(const clap_istream_t *stream, void *data, size_t size)
+{
+  char *curr = (char *)data;
+  while (size > 0)
+  {
+    int64_t thisread = stream->read(stream, curr, size);
+    if (thisread <= 0) return false;
+    curr += thisread;
+    size -= (size_t)thisread;
+  }
+  return true;
+}
+
+bool largeParams_state_save(const clap_plugin_t *plugin, const clap_ostream_t *stream)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+
+  // a version, the parameter count, then one double per parameter
+  int32_t version = 1;
+  if (!largeParams_write_all(stream, &version, sizeof(version))) return false;
+  if (!largeParams_write_all(stream, &plug->paramCount, sizeof(plug->paramCount))) return false;
+  return largeParams_write_all(stream, plug->values, sizeof(double) * plug->paramCount);
+}
+
+bool largeParams_state_load(const clap_plugin_t *plugin, const clap_istream_t *stream)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+
+  int32_t version;
+  uint32_t count;
+  if (!largeParams_read_all(stream, &version, sizeof(version))) return false;
+  if (!largeParams_read_all(stream, &count, sizeof(count))) return false;
+  if (version != 1 || count != plug->paramCount) return false;
+  if (!largeParams_read_all(stream, plug->values, sizeof(double) * count)) return false;
+
+  const clap_host_t *clapHost = plug->host;
+  const clap_host_params_t *p =
+      (const clap_host_params_t *)(clapHost->get_extension(clapHost, CLAP_EXT_PARAMS));
+  if (p)
+  {
+    p->rescan(clapHost, CLAP_PARAM_RESCAN_VALUES);
+  }
+  return true;
+}
+
+static const clap_plugin_state_t s_largeParams_state = {largeParams_state_save, largeParams_state_load};
+
+/////////////////
+// clap_plugin //
+/////////////////
+
+static bool largeParams_init(const struct clap_plugin *plugin)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+
+  plug->values = (double *)calloc(plug->paramCount, sizeof(double));
+  if (!plug->values) return false;
+
+  for (uint32_t i = 0; i < plug->paramCount; ++i)
+  {
+    plug->values[i] = largeParams_isStepped(i) ? 0 : 0.5;
+  }
+  return true;
+}
+
+static void largeParams_destroy(const struct clap_plugin *plugin)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+  free(plug->values);
+  free(plug);
+}
+
+static bool largeParams_activate(const struct clap_plugin *plugin, double sample_rate,
+                                 uint32_t min_frames_count, uint32_t max_frames_count)
+{
+  return true;
+}
+
+static void largeParams_deactivate(const struct clap_plugin *plugin)
+{
+}
+
+static bool largeParams_start_processing(const struct clap_plugin *plugin)
+{
+  return true;
+}
+
+static void largeParams_stop_processing(const struct clap_plugin *plugin)
+{
+}
+
+static void largeParams_reset(const struct clap_plugin *plugin)
+{
+}
+
+static clap_process_status largeParams_process(const struct clap_plugin *plugin,
+                                               const clap_process_t *process)
+{
+  auto *plug = (large_params_plug *)plugin->plugin_data;
+
+  const uint32_t nev = process->in_events->size(process->in_events);
+  for (uint32_t i = 0; i < nev; ++i)
+  {
+    largeParams_process_event(plug, process->in_events->get(process->in_events, i));
+  }
+
+  for (uint32_t c = 0; c < process->audio_outputs[0].channel_count; ++c)
+  {
+    memset(process->audio_outputs[0].data32[c], 0, sizeof(float) * process->frames_count);
+  }
+  process->audio_outputs[0].constant_mask = 0x3;
+
+  return CLAP_PROCESS_CONTINUE;
+}
+
+static const void *largeParams_get_extension(const struct clap_plugin *plugin, const char *id)
+{
+  if (!strcmp(id, CLAP_EXT_AUDIO_PORTS)) return &s_largeParams_audio_ports;
+  if (!strcmp(id, CLAP_EXT_NOTE_PORTS)) return &s_largeParams_note_ports;
+  if (!strcmp(id, CLAP_EXT_PARAMS)) return &s_largeParams_params;
+  if (!strcmp(id, CLAP_EXT_STATE)) return &s_largeParams_state;
+  return NULL;
+}
+
+static void largeParams_on_main_thread(const struct clap_plugin *plugin)
+{
+}
+
+clap_plugin_t *largeParams_create(const clap_host_t *host, uint32_t descIndex)
+{
+  auto *p = (large_params_plug *)calloc(1, sizeof(large_params_plug));
+  p->host = host;
+  p->paramCount = s_largeParams_counts[descIndex];
+  p->plugin.desc = &s_largeParams_desc[descIndex];
+  p->plugin.plugin_data = p;
+  p->plugin.init = largeParams_init;
+  p->plugin.destroy = largeParams_destroy;
+  p->plugin.activate = largeParams_activate;
+  p->plugin.deactivate = largeParams_deactivate;
+  p->plugin.start_processing = largeParams_start_processing;
+  p->plugin.stop_processing = largeParams_stop_processing;
+  p->plugin.reset = largeParams_reset;
+  p->plugin.process = largeParams_process;
+  p->plugin.get_extension = largeParams_get_extension;
+  p->plugin.on_main_thread = largeParams_on_main_thread;
+
+  return &p->plugin;
+}
+
+/////////////////////////
+// clap_plugin_factory //
+/////////////////////////
+
+static uint32_t largeParams_factory_get_plugin_count(const struct clap_plugin_factory *factory)
+{
+  return s_largeParams_numDescs;
+}
+
+static const clap_plugin_descriptor_t *largeParams_factory_get_plugin_descriptor(
+    const struct clap_plugin_factory *factory, uint32_t index)
+{
+  if (index >= s_largeParams_numDescs) return nullptr;
+  return &s_largeParams_desc[index];
+}
+
+static const clap_plugin_t *largeParams_factory_create_plugin(const struct clap_plugin_factory *factory,
+                                                              const clap_host_t *host,
+                                                              const char *plugin_id)
+{
+  if (!clap_version_is_compatible(host->clap_version))
+  {
+    return nullptr;
+  }
+
+  for (uint32_t i = 0; i < s_largeParams_numDescs; ++i)
+  {
+    if (!strcmp(plugin_id, s_largeParams_desc[i].id)) return largeParams_create(host, i);
+  }
+
+  return nullptr;
+}
+
+static const clap_plugin_factory_t s_plugin_factory = {
+    largeParams_factory_get_plugin_count,
+    largeParams_factory_get_plugin_descriptor,
+    largeParams_factory_create_plugin,
+};
+
+bool large_params_entry_init(const char *plugin_path)
+{
+  return true;
+}
+
+void large_params_entry_deinit(void)
+{
+}
+
+const void *large_params_entry_get_factory(const char *factory_id)
+{
+  if (!strcmp(factory_id, CLAP_PLUGIN_FACTORY_ID)) return &s_plugin_factory;
+  return nullptr;
+}
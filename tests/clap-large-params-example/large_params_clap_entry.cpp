@@ -0,0 +1,26 @@
+/*
+ * large_params_clap_entry
+ *
+ * This uses extern versions of the entry methods from a static library to create
+ * a working exported C linkage clap entry point
+ */
+
+#include <clap/clap.h>
+#include <cstring>
+
+#include "large_params_clap_entry.h"
+
+extern "C"
+{
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wattributes"  // other peoples errors are outside my scope
+#endif
+
+  const CLAP_EXPORT struct clap_plugin_entry clap_entry = {
+      CLAP_VERSION, large_params_entry_init, large_params_entry_deinit, large_params_entry_get_factory};
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+}
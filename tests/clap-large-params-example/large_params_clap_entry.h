@@ -0,0 +1,11 @@
+/*
+ * large_params_clap_entry.h
+ *
+ * The static entry functions of the synthetic large-parameter CLAP
+ */
+
+#pragma once
+
+extern bool large_params_entry_init(const char *plugin_path);
+extern void large_params_entry_deinit(void);
+extern const void *large_params_entry_get_factory(const char *factory_id);
@@ -0,0 +1,220 @@
+/*
+ * vst3_instantiation_benchmark
+ *
+ * Loads a VST3 bundle through the VST3 SDK hosting classes and times the lifecycle of
+ * every audio module class in it: initialize, setupProcessing + setActive, getState,
+ * setState and terminate. Each class is measured in a forked child process so the peak
+ * RSS reported is the peak of that configuration alone.
+ *
+ * Usage: clap-first-large-params-benchmark [path/to/Plugin.vst3] [iterations]
+ *
+ * Linux only.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "public.sdk/source/vst/hosting/module.h"
+#include "public.sdk/source/vst/hosting/hostclasses.h"
+#include "public.sdk/source/common/memorystream.h"
+#include "pluginterfaces/vst/ivstcomponent.h"
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+#include "pluginterfaces/vst/ivsteditcontroller.h"
+
+using namespace Steinberg;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+
+double msSince(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+struct Timing
+{
+  double minimum = 1e300;
+  double total = 0;
+  int count = 0;
+
+  void add(double v)
+  {
+    minimum = std::min(minimum, v);
+    total += v;
+    count++;
+  }
+  double mean() const
+  {
+    return count ? total / count : 0;
+  }
+};
+
+long peakRSSInKB()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;  // kilobytes on linux
+}
+
+// the build hands us the binary inside the bundle; the hosting classes want the bundle
+std::string bundlePathFrom(const std::string& path)
+{
+  std::filesystem::path p(path);
+  for (auto q = p; q.has_parent_path() && q != q.parent_path(); q = q.parent_path())
+  {
+    if (q.extension() == ".vst3") return q.string();
+  }
+  return path;
+}
+
+int benchmarkClass(const std::string& bundle, const VST3::Hosting::ClassInfo& info, int iterations)
+{
+  std::string error;
+  auto module = VST3::Hosting::Module::create(bundle, error);
+  if (!module)
+  {
+    fprintf(stderr, "Unable to load '%s' in child: %s\n", bundle.c_str(), error.c_str());
+    return 1;
+  }
+  auto factory = module->getFactory();
+  auto hostContext = owned(new Vst::HostApplication());
+
+  Timing tInit, tActivate, tDeactivate, tGetState, tSetState, tTerminate;
+  int32 paramCount = 0;
+  int64 stateSize = 0;
+
+  for (int i = 0; i < iterations; ++i)
+  {
+    auto start = clock_type::now();
+    auto component = factory.createInstance<Vst::IComponent>(info.ID());
+    if (!component || component->initialize(hostContext) != kResultOk)
+    {
+      fprintf(stderr, "Unable to create and initialize '%s'\n", info.name().c_str());
+      return 1;
+    }
+    tInit.add(msSince(start));
+
+    FUnknownPtr<Vst::IEditController> controller(component);
+    FUnknownPtr<Vst::IAudioProcessor> processor(component);
+    if (controller) paramCount = controller->getParameterCount();
+
+    start = clock_type::now();
+    if (processor)
+    {
+      Vst::ProcessSetup setup{Vst::kRealtime, Vst::kSample32, 512, 48000.0};
+      processor->setupProcessing(setup);
+    }
+    component->setActive(true);
+    tActivate.add(msSince(start));
+
+    start = clock_type::now();
+    component->setActive(false);
+    tDeactivate.add(msSince(start));
+
+    auto stream = owned(new MemoryStream());
+    start = clock_type::now();
+    component->getState(stream);
+    tGetState.add(msSince(start));
+
+    stream->seek(0, IBStream::kIBSeekEnd, &stateSize);
+    stream->seek(0, IBStream::kIBSeekSet, nullptr);
+    start = clock_type::now();
+    component->setState(stream);
+    if (controller)
+    {
+      stream->seek(0, IBStream::kIBSeekSet, nullptr);
+      controller->setComponentState(stream);
+    }
+    tSetState.add(msSince(start));
+
+    start = clock_type::now();
+    component->terminate();
+    controller = nullptr;
+    processor = nullptr;
+    component = nullptr;
+    tTerminate.add(msSince(start));
+  }
+
+  printf("%-32s %8d %10lld %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %10ld\n", info.name().c_str(),
+         paramCount, (long long)stateSize, tInit.mean(), tActivate.mean(), tDeactivate.mean(),
+         tGetState.mean(), tSetState.mean(), tTerminate.mean(), peakRSSInKB());
+  fflush(stdout);
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+#ifdef LARGE_PARAMS_VST3_BINARY
+  std::string path = LARGE_PARAMS_VST3_BINARY;
+#else
+  std::string path;
+#endif
+  if (argc > 1) path = argv[1];
+  int iterations = (argc > 2) ? std::max(1, atoi(argv[2])) : 5;
+
+  if (path.empty())
+  {
+    fprintf(stderr, "Usage: %s path/to/Plugin.vst3 [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  auto bundle = bundlePathFrom(path);
+
+  // collect the class list in the parent, but never keep the module loaded here
+  std::vector<VST3::Hosting::ClassInfo> classes;
+  {
+    std::string error;
+    auto module = VST3::Hosting::Module::create(bundle, error);
+    if (!module)
+    {
+      fprintf(stderr, "Unable to load '%s': %s\n", bundle.c_str(), error.c_str());
+      return 1;
+    }
+    for (const auto& ci : module->getFactory().classInfos())
+    {
+      if (ci.category() == kVstAudioEffectClass) classes.push_back(ci);
+    }
+  }
+
+  printf("VST3 instantiation benchmark: %s (%d iterations, times are mean ms)\n", bundle.c_str(),
+         iterations);
+  printf("%-32s %8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "class", "params", "statesize",
+         "initialize", "activate", "deactivate", "getState", "setState", "terminate", "peakKB");
+
+  int result = 0;
+  for (const auto& ci : classes)
+  {
+    auto pid = fork();
+    if (pid < 0)
+    {
+      fprintf(stderr, "Unable to fork for '%s': %s\n", ci.name().c_str(), strerror(errno));
+      result = 1;
+      continue;
+    }
+    if (pid == 0)
+    {
+      _exit(benchmarkClass(bundle, ci, iterations));
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      fprintf(stderr, "Benchmark of '%s' failed\n", ci.name().c_str());
+      result = 1;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,136 @@
+/*
+ * interleave_benchmark
+ *
+ * First checks that the interleave and deinterleave kernels of detail/shared/interleave.h
+ * produce exactly what the scalar loops produce, for all channel counts up to 9 and block
+ * sizes which do and don't fill whole vectors. Then times both for the channel counts with
+ * SIMD versions at block sizes from 32 to 4096 frames.
+ *
+ * Usage: clap-wrapper-interleave-benchmark [iterations]
+ * Returns 1 if any kernel disagrees with the scalar version.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "detail/shared/interleave.h"
+
+using namespace ClapWrapper::detail::shared;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+
+struct Buffers
+{
+  std::vector<float> interleaved;
+  std::vector<std::vector<float>> channels;
+  std::vector<float *> ptrs;
+
+  Buffers(uint32_t channelCount, uint32_t frames)
+    : interleaved(channelCount * frames), channels(channelCount, std::vector<float>(frames))
+  {
+    for (auto &c : channels) ptrs.push_back(c.data());
+  }
+  const float *const *cptrs() const
+  {
+    return ptrs.data();
+  }
+};
+
+void fill(std::vector<float> &v, uint32_t seed)
+{
+  for (size_t i = 0; i < v.size(); ++i) v[i] = (float)(seed * 1000 + i);
+}
+
+bool check(uint32_t channels, uint32_t frames)
+{
+  Buffers a(channels, frames), b(channels, frames);
+  fill(a.interleaved, channels);
+  b.interleaved = a.interleaved;
+
+  deinterleave(a.interleaved.data(), a.ptrs.data(), channels, frames);
+  deinterleaveScalar(b.interleaved.data(), b.ptrs.data(), channels, frames);
+  if (a.channels != b.channels)
+  {
+    fprintf(stderr, "deinterleave differs for %u channels, %u frames\n", channels, frames);
+    return false;
+  }
+
+  for (auto c = 0U; c < channels; ++c) fill(a.channels[c], c + 1);
+  b.channels = a.channels;
+  interleave(a.cptrs(), a.interleaved.data(), channels, frames);
+  interleaveScalar(b.cptrs(), b.interleaved.data(), channels, frames);
+  if (a.interleaved != b.interleaved)
+  {
+    fprintf(stderr, "interleave differs for %u channels, %u frames\n", channels, frames);
+    return false;
+  }
+  return true;
+}
+
+template <typename F>
+double nsPerFrame(F &&f, uint32_t frames, int iterations)
+{
+  auto start = clock_type::now();
+  for (int i = 0; i < iterations; ++i) f();
+  auto ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+  return ns / ((double)iterations * frames);
+}
+
+void bench(uint32_t channels, uint32_t frames, int iterations)
+{
+  Buffers b(channels, frames);
+  fill(b.interleaved, 1);
+
+  auto ds = nsPerFrame([&]()
+                       { deinterleaveScalar(b.interleaved.data(), b.ptrs.data(), channels, frames); },
+                       frames, iterations);
+  auto dv = nsPerFrame([&]() { deinterleave(b.interleaved.data(), b.ptrs.data(), channels, frames); },
+                       frames, iterations);
+  auto is = nsPerFrame([&]() { interleaveScalar(b.cptrs(), b.interleaved.data(), channels, frames); },
+                       frames, iterations);
+  auto iv = nsPerFrame([&]() { interleave(b.cptrs(), b.interleaved.data(), channels, frames); }, frames,
+                       iterations);
+
+  printf("%8u %6u %10.3f %10.3f %10.3f %10.3f\n", channels, frames, ds, dv, is, iv);
+}
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  int iterations = (argc > 1) ? std::max(1, atoi(argv[1])) : 20000;
+
+  bool ok = true;
+  for (auto channels = 1U; channels <= 9; ++channels)
+  {
+    for (auto frames : {0U, 1U, 3U, 4U, 7U, 8U, 13U, 16U, 31U, 64U, 257U})
+    {
+      ok = check(channels, frames) && ok;
+    }
+  }
+  if (!ok) return 1;
+
+  const char *isa = "scalar";
+#if CLAP_WRAPPER_INTERLEAVE_AVX
+  isa = "avx";
+#elif CLAP_WRAPPER_INTERLEAVE_SSE2
+  isa = "sse2";
+#elif CLAP_WRAPPER_INTERLEAVE_NEON
+  isa = "neon";
+#endif
+  printf("Interleave kernels (%s) match the scalar versions. Times are ns per frame\n", isa);
+  printf("%8s %6s %10s %10s %10s %10s\n", "channels", "frames", "deint", "deint-simd", "int",
+         "int-simd");
+  for (auto channels : {2U, 4U, 8U})
+  {
+    for (auto frames = 32U; frames <= 4096U; frames *= 2)
+    {
+      bench(channels, frames, iterations);
+    }
+  }
+  return 0;
+}
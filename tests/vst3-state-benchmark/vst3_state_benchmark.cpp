@@ -0,0 +1,215 @@
+/*
+ * vst3_state_benchmark
+ *
+ * Saves and loads a synthetic sampler state through the VST3 state stream adapter into
+ * the VST3 SDKs MemoryStream, once with a pass-through adapter which calls the host
+ * stream for every CLAP read/write (how the wrapper used to do it) and once with
+ * CLAPVST3StreamAdapter. The state is written the way many samplers do it: a few small
+ * fields per zone followed by the sample data in blocks.
+ *
+ * Usage: clap-wrapper-vst3-state-benchmark [state size in MB]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <clap/clap.h>
+#include "public.sdk/source/common/memorystream.h"
+#include "detail/vst3/state.h"
+
+using namespace Steinberg;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+
+double msSince(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// the adapter as it was: every CLAP call goes to the host stream, sizes truncated to int32
+class PassThroughAdapter
+{
+ public:
+  PassThroughAdapter(IBStream* stream) : vst_stream(stream)
+  {
+  }
+  operator const clap_istream_t*() const
+  {
+    return &in;
+  }
+  operator const clap_ostream_t*() const
+  {
+    return &out;
+  }
+  bool finish()
+  {
+    return true;
+  }
+
+ private:
+  static int64_t read(const struct clap_istream* stream, void* buffer, uint64_t size)
+  {
+    auto self = static_cast<PassThroughAdapter*>(stream->ctx);
+    int32 bytesRead = 0;
+    if (kResultOk == self->vst_stream->read(buffer, (int32)size, &bytesRead)) return bytesRead;
+    return -1;
+  }
+  static int64_t write(const struct clap_ostream* stream, const void* buffer, uint64_t size)
+  {
+    auto self = static_cast<PassThroughAdapter*>(stream->ctx);
+    int32 bytesWritten = 0;
+    if (kResultOk == self->vst_stream->write(const_cast<void*>(buffer), (int32)size, &bytesWritten))
+      return bytesWritten;
+    return -1;
+  }
+
+  IBStream* vst_stream = nullptr;
+  clap_istream_t in = {this, read};
+  clap_ostream_t out = {this, write};
+};
+
+constexpr uint32_t zoneSampleBytes = 1024 * 1024;
+constexpr uint32_t blockBytes = 16 * 1024;
+constexpr uint32_t zoneFieldCount = 24;
+
+struct SamplerState
+{
+  std::vector<float> sampleData;  // shared by all zones, the content does not matter
+  uint32_t zoneCount = 0;
+};
+
+template <typename T>
+bool writeValue(const clap_ostream_t* out, const T& v)
+{
+  return out->write(out, &v, sizeof(T)) == sizeof(T);
+}
+
+template <typename T>
+bool readValue(const clap_istream_t* in, T& v)
+{
+  return in->read(in, &v, sizeof(T)) == sizeof(T);
+}
+
+bool readFully(const clap_istream_t* in, void* buffer, uint64_t size)
+{
+  auto p = static_cast<uint8_t*>(buffer);
+  while (size > 0)
+  {
+    auto r = in->read(in, p, size);
+    if (r <= 0) return false;
+    p += r;
+    size -= (uint64_t)r;
+  }
+  return true;
+}
+
+bool saveState(const SamplerState& state, const clap_ostream_t* out)
+{
+  if (!writeValue(out, state.zoneCount)) return false;
+  auto data = reinterpret_cast<const uint8_t*>(state.sampleData.data());
+  for (uint32_t z = 0; z < state.zoneCount; ++z)
+  {
+    auto name = "Zone " + std::to_string(z);
+    if (!writeValue(out, (uint32_t)name.size())) return false;
+    if (out->write(out, name.data(), name.size()) != (int64_t)name.size()) return false;
+    for (uint32_t f = 0; f < zoneFieldCount; ++f)
+    {
+      if (!writeValue(out, (float)(z * f))) return false;
+    }
+    if (!writeValue(out, zoneSampleBytes)) return false;
+    for (uint32_t b = 0; b < zoneSampleBytes; b += blockBytes)
+    {
+      if (out->write(out, data + b, blockBytes) != blockBytes) return false;
+    }
+  }
+  return true;
+}
+
+bool loadState(const clap_istream_t* in, uint32_t expectedZones, std::vector<uint8_t>& scratch)
+{
+  uint32_t zoneCount = 0;
+  if (!readValue(in, zoneCount) || zoneCount != expectedZones) return false;
+  for (uint32_t z = 0; z < zoneCount; ++z)
+  {
+    uint32_t nameSize = 0;
+    if (!readValue(in, nameSize) || nameSize > 256) return false;
+    char name[256];
+    if (!readFully(in, name, nameSize)) return false;
+    for (uint32_t f = 0; f < zoneFieldCount; ++f)
+    {
+      float v;
+      if (!readValue(in, v) || v != (float)(z * f)) return false;
+    }
+    uint32_t sampleBytes = 0;
+    if (!readValue(in, sampleBytes) || sampleBytes != zoneSampleBytes) return false;
+    for (uint32_t b = 0; b < sampleBytes; b += blockBytes)
+    {
+      if (!readFully(in, scratch.data(), blockBytes)) return false;
+    }
+  }
+  return true;
+}
+
+template <typename Adapter>
+bool run(const char* label, const SamplerState& state)
+{
+  std::vector<uint8_t> scratch(blockBytes);
+  auto stream = owned(new MemoryStream());
+
+  auto start = clock_type::now();
+  {
+    Adapter adapter(stream);
+    if (!saveState(state, adapter) || !adapter.finish())
+    {
+      fprintf(stderr, "%s: saving failed\n", label);
+      return false;
+    }
+  }
+  auto saveMs = msSince(start);
+
+  int64 size = 0;
+  stream->seek(0, IBStream::kIBSeekEnd, &size);
+  stream->seek(0, IBStream::kIBSeekSet, nullptr);
+
+  start = clock_type::now();
+  {
+    Adapter adapter(stream);
+    if (!loadState(adapter, state.zoneCount, scratch))
+    {
+      fprintf(stderr, "%s: loading failed\n", label);
+      return false;
+    }
+    adapter.finish();
+  }
+  auto loadMs = msSince(start);
+
+  printf("%-16s %12lld %10.1f %10.1f\n", label, (long long)size, saveMs, loadMs);
+  fflush(stdout);
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  int megabytes = (argc > 1) ? std::max(1, atoi(argv[1])) : 500;
+
+  SamplerState state;
+  state.zoneCount = (uint32_t)megabytes;
+  state.sampleData.resize(zoneSampleBytes / sizeof(float));
+  for (size_t i = 0; i < state.sampleData.size(); ++i) state.sampleData[i] = (float)i;
+
+  printf("VST3 state benchmark: %u zones of %u bytes (times are ms)\n", state.zoneCount,
+         zoneSampleBytes);
+  printf("%-16s %12s %10s %10s\n", "adapter", "bytes", "save", "load");
+
+  bool ok = run<PassThroughAdapter>("pass-through", state);
+  ok = run<CLAPVST3StreamAdapter>("buffered", state) && ok;
+  return ok ? 0 : 1;
+}